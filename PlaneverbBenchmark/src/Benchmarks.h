@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+
+namespace Planeverb
+{
+	struct FDTDKernels;
+} // namespace Planeverb
+
+namespace PlaneverbBenchmark
+{
+	// times the scalar FDTD update kernels against the SIMD ones on fixed grids
+	void RunKernelBenchmark();
+
+	// places the temporal blocking pipeline of GenerateResponseCPU on the roofline of this machine:
+	// bytes moved per cell update against the memory bandwidth and the in-cache kernel rate
+	void RunPipelineBenchmark();
+
+	// times GenerateResponseCPU on HugeRoom.pv from one thread up to one per hardware thread
+	void RunScalingBenchmark();
+
+	// seconds per cell update of full time steps over a rows x columns grid, one linear sweep per field
+	double TimeKernelSweeps(const Planeverb::FDTDKernels& kernels, unsigned rows, unsigned columns);
+
+	// seconds from start to now
+	inline double SecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+} // namespace PlaneverbBenchmark
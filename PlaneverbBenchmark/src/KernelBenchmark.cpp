@@ -0,0 +1,169 @@
+#include "Benchmarks.h"
+#include <FDTD\FDTDKernels.h>
+#include <PvTypes.h>
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+using namespace Planeverb;
+
+namespace PlaneverbBenchmark
+{
+	namespace
+	{
+		// grids the kernels sweep, one whose planes fit in L2 and one that streams from memory
+		struct KernelGrid
+		{
+			const char* name;
+			unsigned rows;
+			unsigned columns;
+		};
+		const KernelGrid KERNEL_GRIDS[] =
+		{
+			{ "cached", 128, 128 },
+			{ "memory", 1024, 1024 },
+		};
+
+		// cell updates per timed run, the fastest of PV_KERNEL_RUNS runs counts
+		const constexpr double PV_KERNEL_CELL_UPDATES = 64.0 * 1024.0 * 1024.0;
+		const constexpr unsigned PV_KERNEL_RUNS = 5;
+
+		// steps every kernel set runs from the same fields to check it matches the scalar kernels
+		const constexpr unsigned PV_KERNEL_CHECK_STEPS = 8;
+
+		// speedup of the widest kernels over the scalar ones the SIMD path is meant to reach
+		const constexpr double PV_KERNEL_TARGET_SPEEDUP = 4.0;
+
+		// same update constant as a grid at the stability limit of the 2D scheme
+		const constexpr Real PV_KERNEL_COURANT = (Real)0.5f;
+
+		const char* const ISA_NAMES[] = { "scalar", "SSE", "AVX" };
+
+		// fields of one grid, laid out like the planes of Grid: a ghost row after the last row for the x velocity
+		// and a few cells of slack for the reads past the end of a sweep
+		struct KernelFields
+		{
+			KernelFields(const KernelGrid& grid)
+			{
+				length = grid.rows * grid.columns;
+				stride = grid.columns;
+				const size_t planeLength = (size_t)length + stride + 8;
+				pr.resize(planeLength);
+				vx.resize(planeLength);
+				vy.resize(planeLength);
+				beta.resize(planeLength, (Real)1.f);
+				admittance.resize(planeLength, (Real)0.f);
+
+				// random field, a few percent of the cells are walls
+				std::mt19937 random(1);
+				std::uniform_real_distribution<float> value(-1.f, 1.f);
+				std::uniform_real_distribution<float> chance(0.f, 1.f);
+				for (size_t i = 0; i < planeLength; ++i)
+				{
+					pr[i] = (Real)value(random);
+					vx[i] = (Real)value(random);
+					vy[i] = (Real)value(random);
+					if (chance(random) < 0.05f)
+					{
+						beta[i] = (Real)0.f;
+						admittance[i] = (Real)0.2f;
+					}
+				}
+			}
+
+			// one full time step: pressure, then x and y velocity, each as one linear sweep of the grid
+			void Step(const FDTDKernels& kernels)
+			{
+				kernels.updatePressure(pr.data(), vx.data(), vy.data(), beta.data(), 0, length, stride, PV_KERNEL_COURANT);
+				kernels.updateVelocity(vx.data(), pr.data(), beta.data(), admittance.data(), stride, length, stride, PV_KERNEL_COURANT);
+				kernels.updateVelocity(vy.data(), pr.data(), beta.data(), admittance.data(), 1, length, 1, PV_KERNEL_COURANT);
+			}
+
+			bool operator==(const KernelFields& other) const
+			{
+				const size_t bytes = sizeof(Real) * pr.size();
+				return std::memcmp(pr.data(), other.pr.data(), bytes) == 0 &&
+					std::memcmp(vx.data(), other.vx.data(), bytes) == 0 &&
+					std::memcmp(vy.data(), other.vy.data(), bytes) == 0;
+			}
+
+			unsigned length;
+			unsigned stride;
+			std::vector<Real> pr, vx, vy, beta, admittance;
+		};
+
+		// seconds per cell update of fields advanced by enough steps for PV_KERNEL_CELL_UPDATES, the fastest of
+		// PV_KERNEL_RUNS runs
+		double TimeSteps(KernelFields& fields, const FDTDKernels& kernels)
+		{
+			const unsigned steps = std::max((unsigned)(PV_KERNEL_CELL_UPDATES / fields.length), 1u);
+			double seconds = 0.0;
+			for (unsigned run = 0; run < PV_KERNEL_RUNS; ++run)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				for (unsigned t = 0; t < steps; ++t)
+				{
+					fields.Step(kernels);
+				}
+				const double runSeconds = SecondsSince(start);
+				seconds = (run == 0) ? runSeconds : std::min(seconds, runSeconds);
+			}
+			return seconds / ((double)steps * fields.length);
+		}
+	} // namespace <>
+
+	double TimeKernelSweeps(const FDTDKernels& kernels, unsigned rows, unsigned columns)
+	{
+		KernelFields fields(KernelGrid{ "", rows, columns });
+		return TimeSteps(fields, kernels);
+	}
+
+	void RunKernelBenchmark()
+	{
+		const FDTDKernelISA best = GetFDTDKernels().isa;
+		std::printf("widest ISA of this CPU: %s, target speedup over scalar: %.1fx\n", ISA_NAMES[best], PV_KERNEL_TARGET_SPEEDUP);
+
+		for (const KernelGrid& grid : KERNEL_GRIDS)
+		{
+			const KernelFields initial(grid);
+			std::printf("%s grid %ux%u\n", grid.name, grid.rows, grid.columns);
+
+			// scalar results of the check steps
+			KernelFields reference = initial;
+			for (unsigned t = 0; t < PV_KERNEL_CHECK_STEPS; ++t)
+			{
+				reference.Step(GetFDTDKernels(ki_Scalar));
+			}
+
+			double scalarSeconds = 0.0;				// per cell update
+			for (unsigned isa = ki_Scalar; isa <= ki_AVX; ++isa)
+			{
+				const FDTDKernels& kernels = GetFDTDKernels((FDTDKernelISA)isa);
+				if (kernels.isa != (FDTDKernelISA)isa)
+				{
+					std::printf("  %-6s  not supported by this CPU\n", ISA_NAMES[isa]);
+					continue;
+				}
+
+				KernelFields fields = initial;
+				for (unsigned t = 0; t < PV_KERNEL_CHECK_STEPS; ++t)
+				{
+					fields.Step(kernels);
+				}
+				const bool matches = (fields == reference);
+
+				const double seconds = TimeSteps(fields, kernels);
+				if (isa == ki_Scalar)
+				{
+					scalarSeconds = seconds;
+				}
+
+				std::printf("  %-6s  %6.3f ns/cell  %7.1f Mcells/s  %5.2fx scalar  %s\n", ISA_NAMES[isa],
+					seconds * 1e9, 1e-6 / seconds, scalarSeconds / seconds, matches ? "bit-identical" : "MISMATCH");
+			}
+		}
+	}
+} // namespace PlaneverbBenchmark
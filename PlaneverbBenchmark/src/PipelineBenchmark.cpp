@@ -0,0 +1,151 @@
+#include "Benchmarks.h"
+#include <FDTD\Grid.h>
+#include <FDTD\FDTDKernels.h>
+#include <PvTypes.h>
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <xmmintrin.h>
+
+using namespace Planeverb;
+
+namespace PlaneverbBenchmark
+{
+	namespace
+	{
+		// simulations timed on one thread: rooms the size of the demo scenes, with and without stored
+		// responses, and a grid whose planes spill out of L2. the listener is in the middle and only the cells the
+		// wavefront has reached are updated, so the large grid runs long enough for most cells to be active
+		struct PipelineCase
+		{
+			const char* name;
+			Real sizeInMeters;
+			int resolution;
+			PlaneverbAnalysisMode analysisMode;
+			Real responseLengthInSeconds;		// 0 for the default length
+		};
+		const PipelineCase PIPELINE_CASES[] =
+		{
+			{ "room, stored responses", 25.f, pv_MidResolution, pv_StoredResponseAnalysis, 0.f },
+			{ "room, fields only", 25.f, pv_MidResolution, pv_StreamingAnalysis, 0.f },
+			{ "large, fields only", 100.f, pv_HighResolution, pv_StreamingAnalysis, 0.5f },
+		};
+
+		// simulations per case, the fastest counts. one more runs first to warm up
+		const constexpr unsigned PV_PIPELINE_RUNS = 3;
+
+		// bytes the bandwidth measurements move per run, the fastest of PV_BANDWIDTH_RUNS runs counts
+		const constexpr double PV_BANDWIDTH_BYTES = 512.0 * 1024.0 * 1024.0;
+		const constexpr unsigned PV_BANDWIDTH_RUNS = 5;
+
+		// bytes per array of the main memory bandwidth measurement, far beyond the caches
+		const constexpr size_t PV_MEMORY_ARRAY_BYTES = 256 * 1024 * 1024;
+
+		// grid whose planes fit in L2, its sweeps give the compute roof
+		const constexpr unsigned PV_CACHED_GRID_CELLS = 128;
+
+		// a time step reads and writes the pressure and both velocities and reads the B field and admittance,
+		// 8 floats per cell. with temporal blocking a row does that once per step group while it stays in cache
+		const constexpr unsigned PV_FIELD_ACCESSES_PER_CELL = 8;
+
+		// bytes per second of a scaled copy between two arrays of arrayBytes each, read plus written bytes like
+		// STREAM counts them. arrays the size of a grid's planes give the bandwidth of the cache level they live in
+		double MeasureBandwidth(size_t arrayBytes)
+		{
+			const size_t length = arrayBytes / sizeof(float);
+			std::vector<float> source(length, 1.f);
+			std::vector<float> destination(length, 0.f);
+			const unsigned passes = std::max((unsigned)(PV_BANDWIDTH_BYTES / (2.0 * arrayBytes)), 1u);
+
+			double seconds = 0.0;
+			for (unsigned run = 0; run < PV_BANDWIDTH_RUNS; ++run)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				for (unsigned pass = 0; pass < passes; ++pass)
+				{
+					// 4 wide like the kernels, so the loop keeps up with the caches whatever the compiler vectorizes
+					const __m128 scale = _mm_set1_ps((pass % 2 == 0) ? 0.5f : 2.f);
+					for (size_t i = 0; i + 4 <= length; i += 4)
+					{
+						_mm_storeu_ps(destination.data() + i, _mm_mul_ps(_mm_loadu_ps(source.data() + i), scale));
+					}
+				}
+				const double runSeconds = SecondsSince(start);
+				seconds = (run == 0) ? runSeconds : std::min(seconds, runSeconds);
+			}
+
+			// keeps the copy from being optimized out
+			volatile float sink = destination[length / 2];
+			(void)sink;
+			return 2.0 * passes * arrayBytes / seconds;
+		}
+	} // namespace <>
+
+	void RunPipelineBenchmark()
+	{
+		// roofs of this machine: the rate of the widest kernels out of L2 and the bandwidth of each grid's
+		// cache level, main memory for reference
+		const FDTDKernels& kernels = GetFDTDKernels();
+		const double computeSeconds = TimeKernelSweeps(kernels, PV_CACHED_GRID_CELLS, PV_CACHED_GRID_CELLS);
+		const double memoryBandwidth = MeasureBandwidth(PV_MEMORY_ARRAY_BYTES);
+		std::printf("compute roof %.3f ns/cell (%ux%u grid in cache), main memory %.2f GB/s\n",
+			computeSeconds * 1e9, PV_CACHED_GRID_CELLS, PV_CACHED_GRID_CELLS, memoryBandwidth * 1e-9);
+
+		const unsigned groupSteps = PV_TEMPORAL_BLOCK_STEPS;		// one thread runs every step of a group
+		for (const PipelineCase& test : PIPELINE_CASES)
+		{
+			PlaneverbConfig config;
+			config.gridSizeInMeters = vec2(test.sizeInMeters, test.sizeInMeters);
+			config.gridResolution = test.resolution;
+			config.analysisMode = test.analysisMode;
+			config.responseLengthInSeconds = test.responseLengthInSeconds;
+			config.tempFileDirectory = ".";
+			config.maxThreadUsage = 1;
+
+			std::unique_ptr<char[]> mem(new char[Grid::GetMemoryRequirement(&config)]);
+			Grid grid(&config, mem.get());
+			const vec3 listener(test.sizeInMeters * 0.5f, 0.f, test.sizeInMeters * 0.5f);
+
+			double seconds = 0.0;
+			for (unsigned run = 0; run <= PV_PIPELINE_RUNS; ++run)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				grid.GenerateResponseCPU(&listener);
+				const double runSeconds = SecondsSince(start);
+				seconds = (run <= 1) ? runSeconds : std::min(seconds, runSeconds);
+			}
+
+			// the response cube takes every channel of every active cell and step, it can't be blocked and its
+			// non-temporal stores go straight to main memory
+			const unsigned channels = (test.analysisMode != pv_StoredResponseAnalysis) ? 0 :
+				(config.responseChannels == pv_ResponsePressureOnly) ? 1 : 3;
+			const double responseBytes = (double)(channels * sizeof(Real));
+			const double blockedFieldBytes = (double)(PV_FIELD_ACCESSES_PER_CELL * sizeof(Real)) / groupSteps;
+			const double unblockedFieldBytes = (double)(PV_FIELD_ACCESSES_PER_CELL * sizeof(Real));
+			const double blockedBytes = blockedFieldBytes + responseBytes;
+			const double unblockedBytes = unblockedFieldBytes + responseBytes;
+
+			// pressure, velocities, B field and admittance
+			const vec2i& size = grid.GetGridSize();
+			const size_t planeBytes = 5 * sizeof(Real) * (size_t)size.x * size.y;
+			const double bandwidth = MeasureBandwidth(planeBytes);
+			const size_t cellUpdates = grid.GetCellUpdates();
+			const double cellSeconds = seconds / (double)cellUpdates;
+			const double sweepSeconds = TimeKernelSweeps(kernels, size.x, size.y);
+			const double responseSeconds = responseBytes / memoryBandwidth;
+			const double blockedRoof = std::max(computeSeconds, blockedFieldBytes / bandwidth + responseSeconds);
+			const double unblockedRoof = std::max(computeSeconds, unblockedFieldBytes / bandwidth + responseSeconds);
+
+			std::printf("%s: %dx%d cells, %u steps, %.0f%% of cells active, %.1f MB of planes at %.2f GB/s\n",
+				test.name, size.x, size.y, grid.GetSimulatedResponseSize(),
+				100.0 * cellUpdates / ((double)size.x * size.y * grid.GetSimulatedResponseSize()), planeBytes * 1e-6, bandwidth * 1e-9);
+			std::printf("  pipeline     %6.3f ns/cell  %5.1f B/cell  %6.2f GB/s  roof %6.3f ns/cell\n",
+				cellSeconds * 1e9, blockedBytes, blockedBytes / cellSeconds * 1e-9, blockedRoof * 1e9);
+			std::printf("  unblocked                    %5.1f B/cell               roof %6.3f ns/cell\n",
+				unblockedBytes, unblockedRoof * 1e9);
+			std::printf("  full sweeps  %6.3f ns/cell  (kernels only, a plane per sweep)\n", sweepSeconds * 1e9);
+		}
+	}
+} // namespace PlaneverbBenchmark
@@ -0,0 +1,140 @@
+#include "Benchmarks.h"
+#include <FDTD\Grid.h>
+#include <PvTypes.h>
+
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+using namespace Planeverb;
+
+namespace PlaneverbBenchmark
+{
+	namespace
+	{
+		// scene simulated, saved by the sandbox editor. looked up from the repository root and from the
+		// project directory, which Visual Studio runs the benchmark in
+		const char* const SCALING_SCENE_PATHS[] = { "HugeRoom.pv", "..\\HugeRoom.pv", "../HugeRoom.pv" };
+
+		// the sandbox's 25 m grid, from the low resolution the sandbox runs the scene at up to the finest
+		const constexpr Real PV_SCALING_GRID_METERS = 25.f;
+		const int SCALING_RESOLUTIONS[] = { pv_LowResolution, pv_DefaultResolution, pv_HighResolution, pv_ExtremeResolution };
+
+		// simulations per thread count, the fastest counts. one more runs first to warm up
+		const constexpr unsigned PV_SCALING_RUNS = 3;
+
+		// reads the geometry of a scene saved by the sandbox editor: a count, then one
+		// "id x y width height absorption" line per AABB. returns false if the file can't be opened
+		bool LoadScene(const char* path, std::vector<AABB>& geometry)
+		{
+			std::ifstream stream(path);
+			if (!stream.is_open())
+			{
+				return false;
+			}
+
+			size_t size = 0;
+			stream >> size;
+			for (size_t i = 0; i < size && stream; ++i)
+			{
+				AABB next;
+				PlaneObjectID id;
+				stream >> id >> next.position.x >> next.position.y >> next.width >> next.height >> next.absorption;
+				geometry.push_back(next);
+			}
+			return true;
+		}
+
+		// FNV-1a over every response of the grid, equal hashes mean bit-identical simulations
+		uint64_t HashResponses(const Grid& grid)
+		{
+			const vec2i& size = grid.GetGridSize();
+			std::vector<Cell> response(grid.GetResponseSize());
+			uint64_t hash = 14695981039346656037ull;
+			for (int x = 0; x < size.x; ++x)
+			{
+				for (int y = 0; y < size.y; ++y)
+				{
+					grid.GetResponse(vec2i(x, y), 0, response.data());
+					const unsigned char* bytes = reinterpret_cast<const unsigned char*>(response.data());
+					for (size_t i = 0; i < response.size() * sizeof(Cell); ++i)
+					{
+						hash = (hash ^ bytes[i]) * 1099511628211ull;
+					}
+				}
+			}
+			return hash;
+		}
+	} // namespace <>
+
+	void RunScalingBenchmark()
+	{
+		std::vector<AABB> geometry;
+		const char* scene = nullptr;
+		for (const char* path : SCALING_SCENE_PATHS)
+		{
+			if (LoadScene(path, geometry))
+			{
+				scene = path;
+				break;
+			}
+		}
+		if (!scene)
+		{
+			std::printf("HugeRoom.pv not found, run from the repository root\n");
+			return;
+		}
+
+		// up to one thread per hardware thread, more would only share the cores
+		const unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		std::printf("%s, %zu AABBs, %u hardware threads\n", scene, geometry.size(), maxThreads);
+
+		for (const int resolution : SCALING_RESOLUTIONS)
+		{
+			double singleSeconds = 0.0;
+			uint64_t singleHash = 0;
+			for (unsigned threads = 1; threads <= maxThreads; ++threads)
+			{
+				PlaneverbConfig config;
+				config.gridSizeInMeters = vec2(PV_SCALING_GRID_METERS, PV_SCALING_GRID_METERS);
+				config.gridResolution = resolution;
+				config.tempFileDirectory = ".";
+				config.maxThreadUsage = threads;
+
+				std::unique_ptr<char[]> mem(new char[Grid::GetMemoryRequirement(&config)]);
+				Grid grid(&config, mem.get());
+				for (const AABB& box : geometry)
+				{
+					grid.AddAABB(&box);
+				}
+				const vec3 listener(PV_SCALING_GRID_METERS * 0.5f, 0.f, PV_SCALING_GRID_METERS * 0.5f);
+
+				double seconds = 0.0;
+				for (unsigned run = 0; run <= PV_SCALING_RUNS; ++run)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					grid.GenerateResponseCPU(&listener);
+					const double runSeconds = SecondsSince(start);
+					seconds = (run <= 1) ? runSeconds : std::min(seconds, runSeconds);
+				}
+
+				const uint64_t hash = HashResponses(grid);
+				if (threads == 1)
+				{
+					singleSeconds = seconds;
+					singleHash = hash;
+					const vec2i& size = grid.GetGridSize();
+					std::printf("resolution %d: %dx%d cells, %u steps\n", resolution, size.x, size.y, grid.GetSimulatedResponseSize());
+				}
+
+				const double speedup = singleSeconds / seconds;
+				std::printf("  %3u threads  %8.2f ms  %5.2fx  %5.1f%% efficiency  %s\n", threads, seconds * 1e3,
+					speedup, 100.0 * speedup / threads, (hash == singleHash) ? "bit-identical" : "MISMATCH");
+			}
+		}
+	}
+} // namespace PlaneverbBenchmark
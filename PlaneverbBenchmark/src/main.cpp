@@ -0,0 +1,40 @@
+#include "Benchmarks.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	struct BenchmarkEntry
+	{
+		const char* name;
+		void(*run)();
+	};
+
+	const BenchmarkEntry BENCHMARKS[] =
+	{
+		{ "kernels", PlaneverbBenchmark::RunKernelBenchmark },
+		{ "pipeline", PlaneverbBenchmark::RunPipelineBenchmark },
+		{ "scaling", PlaneverbBenchmark::RunScalingBenchmark },
+	};
+} // namespace <>
+
+// PlaneverbBenchmark [name...], runs the named benchmarks or all of them
+int main(int argc, char** argv)
+{
+	for (const BenchmarkEntry& benchmark : BENCHMARKS)
+	{
+		bool selected = (argc < 2);
+		for (int i = 1; i < argc; ++i)
+		{
+			selected = selected || std::strcmp(argv[i], benchmark.name) == 0;
+		}
+
+		if (selected)
+		{
+			std::printf("== %s ==\n", benchmark.name);
+			benchmark.run();
+			std::printf("\n");
+		}
+	}
+	return 0;
+}
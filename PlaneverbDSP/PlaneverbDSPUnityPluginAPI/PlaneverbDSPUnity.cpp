@@ -66,6 +66,18 @@ extern "C"
 			forwardX, forwardY, forwardZ);
 	}
 
+	PVU_EXPORT int PVU_CC
+	PlaneverbDSPAddEmitter()
+	{
+		return (int)PlaneverbDSP::AddEmitter();
+	}
+
+	PVU_EXPORT void PVU_CC
+	PlaneverbDSPRemoveEmitter(int emissionID)
+	{
+		PlaneverbDSP::RemoveEmitter((PlaneverbDSP::EmissionID)emissionID);
+	}
+
 	PVU_EXPORT void PVU_CC
 	PlaneverbDSPUpdateEmitter(int emissionID, float posX, float posY, float posZ,
 		float forwardX, float forwardY, float forwardZ)
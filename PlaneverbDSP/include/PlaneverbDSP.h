@@ -12,6 +12,12 @@ namespace PlaneverbDSP
 	// Shuts down the Planeverb DSP module
 	PV_DSP_API void Exit();
 
+	// Registers an emitter, returns its handle or PV_INVALID_EMISSION_ID if PlaneverbDSPConfig::maxEmitters are in use
+	PV_DSP_API EmissionID AddEmitter();
+
+	// Releases an emitter, its handle is ignored from then on
+	PV_DSP_API void RemoveEmitter(EmissionID id);
+
 	PV_DSP_API void UpdateEmitter(EmissionID id, float posX, float posY, float posZ,
 		float forwardX, float forwardY, float forwardZ);
 
@@ -25,7 +31,12 @@ namespace PlaneverbDSP
 	PV_DSP_API void SendSource(EmissionID id, const PlaneverbDSPInput* dspParams, 
 		const float* in, unsigned numFrames);
 
-	// Retrieve pre-processed output buffers
+	// Submit the audio source buffers of several emitters for processing, cheaper than a SendSource per emitter.
+	// in[i] is the buffer of ids[i] with the parameters dspParams[i]
+	PV_DSP_API void SendSources(const EmissionID* ids, const PlaneverbDSPInput* dspParams,
+		const float* const* in, unsigned numSources, unsigned numFrames);
+
+	// Retrieve pre-processed output buffers, already reverberated if PlaneverbDSPConfig::useBuiltInReverb is set
 	// @param dryOut gives the dry output buffer
 	// @param outA gives an output buffer that feeds in to a reverb with 0.5s decay time
 	// @param outB gives an output buffer that feeds in to a reverb with 1.0s decay time
@@ -50,6 +50,24 @@ namespace PlaneverbDSP
 		bool useSpatialization = true;
 
 		float wetGainRatio = 0.9f;
+
+		// number of emitters that can be added at once, at most 65535
+		// memory for all of them is allocated in Init
+		unsigned short maxEmitters = 256;
+
+		// true -  GetOutput runs output buffers A, B and C through PlaneverbDSP's own late reverbs
+		//         (PV_DSP_T_ER_1, 2 and 3 second decays), they hold finished wet signals
+		// false - user feeds the output buffers into their own reverbs
+		bool useBuiltInReverb = false;
+
+		// with useBuiltInReverb,
+		// true -  the built in reverbs convolve with enveloped noise responses, decorrelated per channel
+		// false - the built in reverbs are comb filter reverbs, cheaper but less dense
+		bool useConvolutionReverb = false;
+
+		// threads that help mix batches from SendSources, each taking a share of the emitters.
+		// 0 mixes on the calling thread only. the threads spin while idle, so keep this below the free cores
+		unsigned char mixingThreads = 0;
 	};
 
 	struct vec2
@@ -1,6 +1,378 @@
 #include "DSP\Convolver.h"
+#include <new>
+#include <cstring>
+#include <cmath>
+#include <xmmintrin.h>
 
 namespace PlaneverbDSP
 {
+	namespace
+	{
+		// partitions multiplied into the sums per pass over the bins
+		const constexpr unsigned PARTITIONS_PER_PASS = 4;
 
-}
+		// samples of the direct form head, also the samples handed to the segments at a time
+		const constexpr unsigned HEAD_LENGTH = PV_DSP_MIN_CONVOLUTION_BLOCK;
+
+		// bins of a transform of two blocks, rounded up to whole SIMD vectors
+		PV_DSP_INLINE unsigned BinStride(unsigned blockSize)
+		{
+			return (blockSize + 1 + 3) & ~3u;
+		}
+
+		// bytes of the transform tables of a segment, rounded up so the buffers after them start on whole SIMD vectors
+		PV_DSP_INLINE size_t FFTSize(unsigned blockSize)
+		{
+			return (FFT::GetMemoryRequirement(2 * blockSize) + 15) & ~(size_t)15;
+		}
+
+		// samples into the responses the segment of blockSize starts. the shortest blocks are due as soon as they are
+		// complete, longer ones a block later so their work can be spread over that block
+		PV_DSP_INLINE unsigned SegmentBegin(unsigned blockSize)
+		{
+			return (blockSize == HEAD_LENGTH) ? blockSize : 2 * blockSize;
+		}
+
+		// head blocks the work on a block of the segment of blockSize is spread over
+		PV_DSP_INLINE unsigned SegmentSteps(unsigned blockSize)
+		{
+			return (blockSize == HEAD_LENGTH) ? 1 : blockSize / HEAD_LENGTH;
+		}
+
+		// block size of every segment for responses up to responseLength samples, returns the segment count
+		PV_DSP_INLINE unsigned SegmentBlockSizes(unsigned responseLength, unsigned* blockSizes)
+		{
+			unsigned count = 0;
+			for (unsigned blockSize = PV_DSP_MIN_CONVOLUTION_BLOCK;
+				SegmentBegin(blockSize) < responseLength && count < PV_DSP_MAX_CONVOLUTION_SEGMENTS; blockSize *= PV_DSP_CONVOLUTION_GROWTH)
+			{
+				blockSizes[count++] = blockSize;
+			}
+			return count;
+		}
+
+		// partitions of a response in the segment of blockSize, which runs to the start of the next one. the segment
+		// of the longest blocks takes the rest
+		PV_DSP_INLINE unsigned PartitionCount(unsigned responseLength, unsigned blockSize)
+		{
+			const unsigned begin = SegmentBegin(blockSize);
+			const unsigned next = SegmentBegin(blockSize * PV_DSP_CONVOLUTION_GROWTH);
+			const unsigned end = (blockSize == PV_DSP_MAX_CONVOLUTION_BLOCK || responseLength < next) ? responseLength : next;
+			return (end > begin) ? (end - begin + blockSize - 1) / blockSize : 0;
+		}
+
+		// the transform, then per response its passes over the partitions and the inverse transform
+		PV_DSP_INLINE unsigned WorkCount(const unsigned* partitionCounts, unsigned responseCount)
+		{
+			unsigned count = 1;
+			for (unsigned r = 0; r < responseCount; ++r)
+				count += (partitionCounts[r] + PARTITIONS_PER_PASS - 1) / PARTITIONS_PER_PASS + 1;
+			return count;
+		}
+
+		PV_DSP_INLINE float HorizontalSum(__m128 v)
+		{
+			v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+			v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+			return _mm_cvtss_f32(v);
+		}
+
+		PV_DSP_INLINE unsigned LongestResponse(const ImpulseResponse* const* responses, unsigned responseCount)
+		{
+			unsigned longest = 0;
+			for (unsigned r = 0; r < responseCount; ++r)
+				longest = (responses[r]->GetArraySize() > longest) ? responses[r]->GetArraySize() : longest;
+			return longest;
+		}
+	} // namespace <>
+
+	Convolver::Segment::Segment(unsigned blockSize, char* mem) :
+		blockSize(blockSize),
+		fft(2 * blockSize, mem),
+		binStride(BinStride(blockSize)),
+		fill(0),
+		newest(0),
+		steps(SegmentSteps(blockSize)),
+		step(steps),
+		workCount(0),
+		workDone(0),
+		response(0),
+		partition(0)
+	{
+	}
+
+	Convolver::Convolver(const ImpulseResponse* const* responses, unsigned responseCount, unsigned phase, char* mem) :
+		m_responseCount(responseCount),
+		m_fill(0)
+	{
+		PV_DSP_ASSERT(responseCount > 0 && responseCount <= PV_DSP_MAX_CONVOLVER_RESPONSES);
+		const unsigned longest = LongestResponse(responses, responseCount);
+		unsigned blockSizes[PV_DSP_MAX_CONVOLUTION_SEGMENTS];
+		m_segmentCount = SegmentBlockSizes(longest, blockSizes);
+		const unsigned longestBlock = (m_segmentCount > 0) ? blockSizes[m_segmentCount - 1] : HEAD_LENGTH;
+
+		// place the segments first for their 8 byte members, then the buffers shared by them
+		m_segments = reinterpret_cast<Segment*>(mem);
+		mem += ((sizeof(Segment) * m_segmentCount + 15) & ~(size_t)15);
+		const size_t scratchSize = sizeof(float) * BinStride(longestBlock);
+		m_input = reinterpret_cast<float*>(mem); mem += sizeof(float) * HEAD_LENGTH * 2;
+		m_zeros = reinterpret_cast<float*>(mem); mem += scratchSize;
+		m_time = reinterpret_cast<float*>(mem); mem += sizeof(float) * longestBlock * 2;
+		for (unsigned r = 0; r < responseCount; ++r)
+		{
+			m_heads[r] = reinterpret_cast<float*>(mem); mem += sizeof(float) * HEAD_LENGTH;
+			m_tails[r] = reinterpret_cast<float*>(mem); mem += sizeof(float) * HEAD_LENGTH;
+		}
+
+		for (unsigned k = 0; k < m_segmentCount; ++k)
+		{
+			const unsigned blockSize = blockSizes[k];
+			Segment& segment = *new (m_segments + k) Segment(blockSize, mem);
+			mem += FFTSize(blockSize);
+
+			// the first block is shorter by the phase, as if silence had come before it
+			segment.fill = (phase % blockSize) / HEAD_LENGTH * HEAD_LENGTH;
+
+			const size_t spectrumSize = sizeof(float) * segment.binStride;
+			segment.delayLineLength = PartitionCount(longest, blockSize);
+			segment.input = reinterpret_cast<float*>(mem); mem += sizeof(float) * blockSize * 2;
+			segment.sumRe = reinterpret_cast<float*>(mem); mem += spectrumSize;
+			segment.sumIm = reinterpret_cast<float*>(mem); mem += spectrumSize;
+			segment.delayLineRe = reinterpret_cast<float*>(mem); mem += spectrumSize * segment.delayLineLength;
+			segment.delayLineIm = reinterpret_cast<float*>(mem); mem += spectrumSize * segment.delayLineLength;
+			for (unsigned r = 0; r < responseCount; ++r)
+			{
+				const unsigned count = PartitionCount(responses[r]->GetArraySize(), blockSize);
+				segment.partitionCount[r] = count;
+				segment.partitionsRe[r] = reinterpret_cast<float*>(mem); mem += spectrumSize * count;
+				segment.partitionsIm[r] = reinterpret_cast<float*>(mem); mem += spectrumSize * count;
+				segment.tails[r] = reinterpret_cast<float*>(mem); mem += sizeof(float) * blockSize;
+				segment.nextTails[r] = segment.tails[r];
+				if (segment.steps > 1)
+				{
+					segment.nextTails[r] = reinterpret_cast<float*>(mem); mem += sizeof(float) * blockSize;
+				}
+			}
+			segment.workCount = WorkCount(segment.partitionCount, responseCount);
+			segment.workDone = segment.workCount;
+		}
+
+		for (unsigned r = 0; r < responseCount; ++r)
+		{
+			const float* response = responses[r]->GetTimeDomain();
+			const unsigned length = responses[r]->GetArraySize();
+
+			// unit energy, so responses of any decay time are equally loud
+			double energy = 0.0;
+			for (unsigned i = 0; i < length; ++i)
+				energy += (double)response[i] * response[i];
+			const float scale = (energy > 0.0) ? (float)(1.0 / std::sqrt(energy)) : 0.f;
+
+			// head reversed, so a sample's output is a dot product with the last block of input
+			for (unsigned j = 0; j < HEAD_LENGTH && j < length; ++j)
+				m_heads[r][HEAD_LENGTH - 1 - j] = response[j] * scale;
+
+			// spectra of the partitions, zero padded to two blocks. partition k of a segment starts k blocks after
+			// the segment
+			for (unsigned s = 0; s < m_segmentCount; ++s)
+			{
+				Segment& segment = m_segments[s];
+				const unsigned blockSize = segment.blockSize;
+				for (unsigned k = 0; k < segment.partitionCount[r]; ++k)
+				{
+					const unsigned begin = SegmentBegin(blockSize) + k * blockSize;
+					std::memset(m_time, 0, sizeof(float) * blockSize * 2);
+					for (unsigned j = 0; j < blockSize && begin + j < length; ++j)
+						m_time[j] = response[begin + j] * scale;
+					segment.fft.Forward(m_time, segment.partitionsRe[r] + (size_t)k * segment.binStride,
+						segment.partitionsIm[r] + (size_t)k * segment.binStride);
+				}
+			}
+		}
+	}
+
+	size_t Convolver::GetMemoryRequirement(unsigned responseLength, unsigned responseCount)
+	{
+		unsigned blockSizes[PV_DSP_MAX_CONVOLUTION_SEGMENTS];
+		const unsigned segmentCount = SegmentBlockSizes(responseLength, blockSizes);
+		const unsigned longestBlock = (segmentCount > 0) ? blockSizes[segmentCount - 1] : HEAD_LENGTH;
+		size_t size = ((sizeof(Segment) * segmentCount + 15) & ~(size_t)15) +
+			sizeof(float) * HEAD_LENGTH * 2 +					// head input
+			sizeof(float) * BinStride(longestBlock) +			// zeros
+			sizeof(float) * longestBlock * 2 +					// time scratch
+			sizeof(float) * HEAD_LENGTH * 2 * responseCount;	// heads, tails
+		for (unsigned k = 0; k < segmentCount; ++k)
+		{
+			const unsigned blockSize = blockSizes[k];
+			const size_t spectrumSize = sizeof(float) * BinStride(blockSize);
+			const unsigned count = PartitionCount(responseLength, blockSize);
+			const unsigned tailCount = (SegmentSteps(blockSize) > 1) ? 2 : 1;
+			size += FFTSize(blockSize) +
+				sizeof(float) * blockSize * 2 +					// input
+				spectrumSize * 2 +								// sums
+				spectrumSize * count * 2 +						// delay line
+				(spectrumSize * count * 2 + sizeof(float) * blockSize * tailCount) * responseCount;	// partitions, tails
+		}
+		return size;
+	}
+
+	void Convolver::Process(const float* in, float* const* out, unsigned outStride, unsigned numFrames)
+	{
+		for (unsigned frame = 0; frame < numFrames; ++frame)
+		{
+			m_input[HEAD_LENGTH + m_fill] = in[frame];
+
+			// head, the input block ending at this sample against every reversed head.
+			// four sums so the adds don't wait on each other
+			const float* window = m_input + m_fill + 1;
+			for (unsigned r = 0; r < m_responseCount; ++r)
+			{
+				const float* head = m_heads[r];
+				__m128 sum0 = _mm_setzero_ps();
+				__m128 sum1 = _mm_setzero_ps();
+				__m128 sum2 = _mm_setzero_ps();
+				__m128 sum3 = _mm_setzero_ps();
+				for (unsigned j = 0; j < HEAD_LENGTH; j += 16)
+				{
+					sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(window + j), _mm_loadu_ps(head + j)));
+					sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(window + j + 4), _mm_loadu_ps(head + j + 4)));
+					sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(window + j + 8), _mm_loadu_ps(head + j + 8)));
+					sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(window + j + 12), _mm_loadu_ps(head + j + 12)));
+				}
+
+				// the rest of the response was worked out when the previous head block finished
+				const __m128 sum = _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3));
+				out[r][(size_t)frame * outStride] = HorizontalSum(sum) + m_tails[r][m_fill];
+			}
+
+			if (++m_fill == HEAD_LENGTH)
+				FinishBlock();
+		}
+	}
+
+	void Convolver::FinishBlock()
+	{
+		// every block size is a multiple of the head's, so segment blocks finish on head block boundaries
+		const float* block = m_input + HEAD_LENGTH;
+		for (unsigned r = 0; r < m_responseCount; ++r)
+			std::memset(m_tails[r], 0, sizeof(float) * HEAD_LENGTH);
+		for (unsigned s = 0; s < m_segmentCount; ++s)
+		{
+			Segment& segment = m_segments[s];
+			std::memcpy(segment.input + segment.blockSize + segment.fill, block, sizeof(float) * HEAD_LENGTH);
+			segment.fill += HEAD_LENGTH;
+			if (segment.fill == segment.blockSize)
+				StartSegment(segment);
+			AdvanceSegment(segment);
+
+			// the segment's share of the next head block
+			for (unsigned r = 0; r < m_responseCount; ++r)
+			{
+				float* tail = m_tails[r];
+				const float* segmentTail = segment.tails[r] + segment.fill;
+				for (unsigned i = 0; i < HEAD_LENGTH; i += 4)
+					_mm_storeu_ps(tail + i, _mm_add_ps(_mm_loadu_ps(tail + i), _mm_loadu_ps(segmentTail + i)));
+			}
+		}
+
+		// the current block becomes the previous one
+		std::memcpy(m_input, block, sizeof(float) * HEAD_LENGTH);
+		m_fill = 0;
+	}
+
+	void Convolver::StartSegment(Segment& segment)
+	{
+		PV_DSP_ASSERT(segment.workDone == segment.workCount);
+		for (unsigned r = 0; r < m_responseCount; ++r)
+		{
+			float* tails = segment.tails[r];
+			segment.tails[r] = segment.nextTails[r];
+			segment.nextTails[r] = tails;
+		}
+
+		// newest spectrum goes in front of the others
+		const unsigned binStride = segment.binStride;
+		segment.newest = (segment.newest == 0) ? segment.delayLineLength - 1 : segment.newest - 1;
+		segment.fft.Forward(segment.input, segment.delayLineRe + (size_t)segment.newest * binStride,
+			segment.delayLineIm + (size_t)segment.newest * binStride);
+
+		// the current block becomes the previous one
+		std::memcpy(segment.input, segment.input + segment.blockSize, sizeof(float) * segment.blockSize);
+		segment.fill = 0;
+
+		std::memset(segment.sumRe, 0, sizeof(float) * binStride);
+		std::memset(segment.sumIm, 0, sizeof(float) * binStride);
+		segment.step = 0;
+		segment.workDone = 1;
+		segment.response = 0;
+		segment.partition = 0;
+	}
+
+	void Convolver::AdvanceSegment(Segment& segment)
+	{
+		if (segment.step == segment.steps)
+			return;
+
+		// the work done by the end of each head block grows evenly, all of it by the last one
+		++segment.step;
+		const unsigned workDue = (segment.workCount * segment.step + segment.steps - 1) / segment.steps;
+		const unsigned binStride = segment.binStride;
+		const unsigned delayLineLength = segment.delayLineLength;
+		for (; segment.workDone < workDue; ++segment.workDone)
+		{
+			const unsigned r = segment.response;
+			const unsigned count = segment.partitionCount[r];
+			const unsigned k = segment.partition;
+			if (k >= count)
+			{
+				// overlap-save keeps the second half
+				segment.fft.Inverse(segment.sumRe, segment.sumIm, m_time);
+				std::memcpy(segment.nextTails[r], m_time + segment.blockSize, sizeof(float) * segment.blockSize);
+				std::memset(segment.sumRe, 0, sizeof(float) * binStride);
+				std::memset(segment.sumIm, 0, sizeof(float) * binStride);
+				++segment.response;
+				segment.partition = 0;
+				continue;
+			}
+
+			// partition k meets the spectrum k blocks older than the newest. partitions are walked in order,
+			// four at a time so the sums are loaded and stored once for four complex multiplies
+			const unsigned passCount = (count - k < PARTITIONS_PER_PASS) ? count - k : PARTITIONS_PER_PASS;
+			unsigned slot = segment.newest + k;
+			slot = (slot >= delayLineLength) ? slot - delayLineLength : slot;
+			const float* xr[PARTITIONS_PER_PASS];
+			const float* xi[PARTITIONS_PER_PASS];
+			const float* hr[PARTITIONS_PER_PASS];
+			const float* hi[PARTITIONS_PER_PASS];
+			for (unsigned p = 0; p < PARTITIONS_PER_PASS; ++p)
+			{
+				// a short pass repeats its last partition against zeros
+				const bool used = p < passCount;
+				xr[p] = segment.delayLineRe + (size_t)slot * binStride;
+				xi[p] = segment.delayLineIm + (size_t)slot * binStride;
+				hr[p] = used ? segment.partitionsRe[r] + (size_t)(k + p) * binStride : m_zeros;
+				hi[p] = used ? segment.partitionsIm[r] + (size_t)(k + p) * binStride : m_zeros;
+				if (used)
+					slot = (slot + 1 == delayLineLength) ? 0 : slot + 1;
+			}
+
+			for (unsigned bin = 0; bin < binStride; bin += 4)
+			{
+				__m128 sumRe = _mm_loadu_ps(segment.sumRe + bin);
+				__m128 sumIm = _mm_loadu_ps(segment.sumIm + bin);
+				for (unsigned p = 0; p < PARTITIONS_PER_PASS; ++p)
+				{
+					const __m128 ar = _mm_loadu_ps(xr[p] + bin);
+					const __m128 ai = _mm_loadu_ps(xi[p] + bin);
+					const __m128 br = _mm_loadu_ps(hr[p] + bin);
+					const __m128 bi = _mm_loadu_ps(hi[p] + bin);
+					sumRe = _mm_add_ps(sumRe, _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi)));
+					sumIm = _mm_add_ps(sumIm, _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br)));
+				}
+				_mm_storeu_ps(segment.sumRe + bin, sumRe);
+				_mm_storeu_ps(segment.sumIm + bin, sumIm);
+			}
+			segment.partition += PARTITIONS_PER_PASS;
+		}
+	}
+} // namespace PlaneverbDSP
@@ -1,41 +1,115 @@
 #pragma once
 #include "ImpulseResponse.h"
+#include "FFT.h"
 #include "PvDSPTypes.h"
 #include "PvDSPDefinitions.h"
-#include <cstring> // memset
-#include <cmath>
+#include <cstddef>
 
 namespace PlaneverbDSP
 {
-	// unused convolver
+	// bounds of the samples per partition. the direct form head is one shortest partition long and every segment
+	// of partitions after it has blocks PV_DSP_CONVOLUTION_GROWTH times longer than the one before
+	const constexpr unsigned PV_DSP_MIN_CONVOLUTION_BLOCK = 128;
+	const constexpr unsigned PV_DSP_MAX_CONVOLUTION_BLOCK = 8192;
+	const constexpr unsigned PV_DSP_CONVOLUTION_GROWTH = 8;
+
+	// most segments, one per block size from the shortest to the longest
+	const constexpr unsigned PV_DSP_MAX_CONVOLUTION_SEGMENTS = 3;
+	static_assert(PV_DSP_MIN_CONVOLUTION_BLOCK * PV_DSP_CONVOLUTION_GROWTH * PV_DSP_CONVOLUTION_GROWTH == PV_DSP_MAX_CONVOLUTION_BLOCK,
+		"PV_DSP_MAX_CONVOLUTION_SEGMENTS block sizes from the shortest to the longest");
+
+	// most impulse responses sharing one convolver input
+	const constexpr unsigned PV_DSP_MAX_CONVOLVER_RESPONSES = 4;
+
+	// Zero latency convolution of one input with several impulse responses.
+	// the first PV_DSP_MIN_CONVOLUTION_BLOCK samples of each response are convolved directly, sample by sample. the
+	// rest is non-uniformly partitioned overlap-save, split into segments. every finished block is transformed once
+	// into the segment's frequency domain delay line, whose spectra are multiplied with the segment's partitions of
+	// every response. the segment of the shortest blocks starts one block into the responses, so its tails of the next
+	// block are worked out when a block finishes. longer segments start two blocks in, which leaves a block's time to
+	// work out their tails: the products and inverse transforms are spread over the head blocks of the next block, so
+	// no callback carries the whole work of a long block. short blocks keep the head short, long blocks cover the
+	// late part of the responses with few partitions and transforms per sample
 	class Convolver
 	{
 	public:
-		Convolver(const ImpulseResponse* response) :
-			m_response(response)
-		{
-			std::memset(m_outputBuffer1, 0, sizeof(float) * PV_DSP_MAX_CALLBACK_LENGTH);
-			std::memset(m_outputBuffer2, 0, sizeof(float) * PV_DSP_MAX_CALLBACK_LENGTH);
-			m_outputBuffer = m_outputBuffer1;
-			m_target = std::pow(10.0f, -1.5f / 20.0f);
+		// responses are scaled to unit energy. mem holds GetMemoryRequirement bytes for the longest response, zeroed.
+		// the segments' blocks end phase samples, rounded down to head blocks, earlier than they would, so convolvers
+		// run side by side with different phases don't start the work on their long blocks in the same callback
+		Convolver(const ImpulseResponse* const* responses, unsigned responseCount, unsigned phase, char* mem);
+		~Convolver() = default;
 
-		}
+		// convolves numFrames samples of in with every response, out[r][frame * outStride] receives response r
+		void Process(const float* in, float* const* out, unsigned outStride, unsigned numFrames);
 
-		~Convolver()
-		{
-			std::memset(m_outputBuffer1, 0, sizeof(float) * PV_DSP_MAX_CALLBACK_LENGTH);
-			std::memset(m_outputBuffer2, 0, sizeof(float) * PV_DSP_MAX_CALLBACK_LENGTH);
-		}
+		PV_DSP_INLINE unsigned GetResponseCount() const { return m_responseCount; }
+		PV_DSP_INLINE unsigned GetSegmentCount() const { return m_segmentCount; }
+
+		static size_t GetMemoryRequirement(unsigned responseLength, unsigned responseCount);
 
-		PV_DSP_INLINE float* operator()(float* input, int numFrames)
-		{
-			return nullptr;
-		}
 	private:
-		const ImpulseResponse* m_response;
-		float m_outputBuffer1[PV_DSP_MAX_CALLBACK_LENGTH];
-		float m_outputBuffer2[PV_DSP_MAX_CALLBACK_LENGTH];
-		float* m_outputBuffer;
-		float m_target;
+		// partitions of one block size, uniformly partitioned overlap-save
+		struct Segment
+		{
+			// mem holds the tables of fft
+			Segment(unsigned blockSize, char* mem);
+
+			unsigned blockSize;						// samples per partition
+			FFT fft;								// transforms of two blocks
+			unsigned binStride;						// bins per spectrum, padded to whole SIMD vectors
+
+			float* input;							// previous block followed by the current one
+			unsigned fill;							// samples in the current block
+
+			// spectra of the last blocks of input, newest first from newest
+			float* delayLineRe;
+			float* delayLineIm;
+			unsigned delayLineLength;				// spectra in the delay line, the most partitions of any response
+			unsigned newest;						// slot of the newest spectrum
+
+			// work on the tails of the next block: the transform, then per response its passes over the partitions and
+			// the inverse transform. spread evenly over steps head blocks
+			unsigned steps;							// 1 for the shortest blocks, whose tails are due at once
+			unsigned step;							// head blocks of the work done
+			unsigned workCount;						// transforms and passes per block
+			unsigned workDone;
+			unsigned response;						// response and first partition of the next pass
+			unsigned partition;
+			float* sumRe;							// products summed so far for the response
+			float* sumIm;
+
+			// per response
+			float* partitionsRe[PV_DSP_MAX_CONVOLVER_RESPONSES];	// spectra of the partitions
+			float* partitionsIm[PV_DSP_MAX_CONVOLVER_RESPONSES];
+			unsigned partitionCount[PV_DSP_MAX_CONVOLVER_RESPONSES];
+			float* tails[PV_DSP_MAX_CONVOLVER_RESPONSES];			// output of the partitions for the current block
+			float* nextTails[PV_DSP_MAX_CONVOLVER_RESPONSES];		// for the next block, the same buffers if steps is 1
+		};
+
+		// hands the last head block to the segments and sums their tails for the next one
+		void FinishBlock();
+
+		// makes the tails worked out during a segment's block current, transforms the last two blocks of input into
+		// its delay line and starts the work on the tails of the next block
+		void StartSegment(Segment& segment);
+
+		// does the share of the work on a segment's next tails due by the end of this head block
+		void AdvanceSegment(Segment& segment);
+
+		unsigned m_responseCount;
+
+		float* m_input;							// previous head block followed by the current one
+		unsigned m_fill;						// samples in the current head block
+
+		Segment* m_segments;					// from the shortest blocks to the longest
+		unsigned m_segmentCount;
+
+		// scratch, sized for the longest blocks
+		float* m_time;
+		float* m_zeros;							// a silent spectrum, pads the last pass over the partitions
+
+		// per response
+		float* m_heads[PV_DSP_MAX_CONVOLVER_RESPONSES];			// first PV_DSP_MIN_CONVOLUTION_BLOCK samples, reversed
+		float* m_tails[PV_DSP_MAX_CONVOLVER_RESPONSES];			// output of all segments for the current head block
 	};
 } // namespace PlaneverbDSP
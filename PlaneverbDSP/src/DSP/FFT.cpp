@@ -0,0 +1,204 @@
+#include "DSP\FFT.h"
+#include <cmath>
+#include <utility>
+#include <xmmintrin.h>
+
+namespace PlaneverbDSP
+{
+	FFT::FFT(unsigned size, char* mem) :
+		m_size(size), m_half(size / 2)
+	{
+		PV_DSP_ASSERT(size >= 4 && (size & (size - 1)) == 0);
+
+		// place tables
+		m_bitReverse = reinterpret_cast<unsigned*>(mem); mem += sizeof(unsigned) * m_half;
+		m_twiddleRe = reinterpret_cast<float*>(mem); mem += sizeof(float) * m_half;
+		m_twiddleIm = reinterpret_cast<float*>(mem); mem += sizeof(float) * m_half;
+		m_splitRe = reinterpret_cast<float*>(mem); mem += sizeof(float) * (m_half + 1);
+		m_splitIm = reinterpret_cast<float*>(mem); mem += sizeof(float) * (m_half + 1);
+
+		unsigned bits = 0;
+		while ((1u << bits) < m_half)
+			++bits;
+		for (unsigned i = 0; i < m_half; ++i)
+		{
+			unsigned reversed = 0;
+			for (unsigned b = 0; b < bits; ++b)
+				reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+			m_bitReverse[i] = reversed;
+		}
+
+		// twiddles in double so the large transforms keep their precision
+		const double pi = 3.14159265358979323846;
+		for (unsigned half = 1; half < m_half; half <<= 1)
+		{
+			for (unsigned k = 0; k < half; ++k)
+			{
+				m_twiddleRe[half - 1 + k] = (float)std::cos(-pi * k / half);
+				m_twiddleIm[half - 1 + k] = (float)std::sin(-pi * k / half);
+			}
+		}
+		for (unsigned k = 0; k <= m_half; ++k)
+		{
+			m_splitRe[k] = (float)std::cos(-2.0 * pi * k / m_size);
+			m_splitIm[k] = (float)std::sin(-2.0 * pi * k / m_size);
+		}
+	}
+
+	size_t FFT::GetMemoryRequirement(unsigned size)
+	{
+		const unsigned half = size / 2;
+		return sizeof(unsigned) * half + sizeof(float) * half * 2 + sizeof(float) * (half + 1) * 2;
+	}
+
+	void FFT::Transform(float* re, float* im, bool inverse) const
+	{
+		// iterative decimation in time, the input is in bit reversed order
+		const float sign = inverse ? -1.f : 1.f;
+		for (unsigned length = 2; length <= m_half; length <<= 1)
+		{
+			const unsigned half = length / 2;
+			const float* twiddleRe = m_twiddleRe + half - 1;
+			const float* twiddleIm = m_twiddleIm + half - 1;
+			if (half < 4)
+			{
+				for (unsigned i = 0; i < m_half; i += length)
+				{
+					for (unsigned j = 0; j < half; ++j)
+					{
+						const float wr = twiddleRe[j];
+						const float wi = twiddleIm[j] * sign;
+						const unsigned a = i + j;
+						const unsigned b = a + half;
+						const float tr = wr * re[b] - wi * im[b];
+						const float ti = wr * im[b] + wi * re[b];
+						re[b] = re[a] - tr;
+						im[b] = im[a] - ti;
+						re[a] += tr;
+						im[a] += ti;
+					}
+				}
+				continue;
+			}
+
+			// four butterflies at a time, a stage's twiddles are contiguous
+			const __m128 signs = _mm_set1_ps(sign);
+			for (unsigned i = 0; i < m_half; i += length)
+			{
+				float* aRe = re + i;
+				float* aIm = im + i;
+				float* bRe = aRe + half;
+				float* bIm = aIm + half;
+				for (unsigned j = 0; j < half; j += 4)
+				{
+					const __m128 wr = _mm_loadu_ps(twiddleRe + j);
+					const __m128 wi = _mm_mul_ps(_mm_loadu_ps(twiddleIm + j), signs);
+					const __m128 br = _mm_loadu_ps(bRe + j);
+					const __m128 bi = _mm_loadu_ps(bIm + j);
+					const __m128 ar = _mm_loadu_ps(aRe + j);
+					const __m128 ai = _mm_loadu_ps(aIm + j);
+					const __m128 tr = _mm_sub_ps(_mm_mul_ps(wr, br), _mm_mul_ps(wi, bi));
+					const __m128 ti = _mm_add_ps(_mm_mul_ps(wr, bi), _mm_mul_ps(wi, br));
+					_mm_storeu_ps(bRe + j, _mm_sub_ps(ar, tr));
+					_mm_storeu_ps(bIm + j, _mm_sub_ps(ai, ti));
+					_mm_storeu_ps(aRe + j, _mm_add_ps(ar, tr));
+					_mm_storeu_ps(aIm + j, _mm_add_ps(ai, ti));
+				}
+			}
+		}
+	}
+
+	void FFT::Forward(const float* in, float* re, float* im) const
+	{
+		// pack even samples as real and odd samples as imaginary parts of a half size signal
+		for (unsigned k = 0; k < m_half; ++k)
+		{
+			const unsigned index = m_bitReverse[k];
+			re[index] = in[2 * k];
+			im[index] = in[2 * k + 1];
+		}
+		Transform(re, im, false);
+
+		// split into the spectra of the even and odd samples, X[k] = E[k] + W^k O[k].
+		// bins k and half - k are made from the same pair of points
+		const float dc = re[0];
+		re[0] = dc + im[0];
+		re[m_half] = dc - im[0];
+		im[0] = 0.f;
+		im[m_half] = 0.f;
+		for (unsigned k = 1; k <= m_half / 2; ++k)
+		{
+			const unsigned mirror = m_half - k;
+			const float ar = re[k], ai = im[k];
+			const float br = re[mirror], bi = im[mirror];
+
+			// E = (a + conj b) / 2, O = -i (a - conj b) / 2
+			const float er = 0.5f * (ar + br);
+			const float ei = 0.5f * (ai - bi);
+			const float or_ = 0.5f * (ai + bi);
+			const float oi = -0.5f * (ar - br);
+
+			// X[k] = E + W^k O, X[half - k] = conj(E) + W^(half - k) conj(O)
+			const float wr = m_splitRe[k], wi = m_splitIm[k];
+			re[k] = er + wr * or_ - wi * oi;
+			im[k] = ei + wr * oi + wi * or_;
+			const float vr = m_splitRe[mirror], vi = m_splitIm[mirror];
+			re[mirror] = er + vr * or_ + vi * oi;
+			im[mirror] = -ei - vr * oi + vi * or_;
+		}
+	}
+
+	void FFT::Inverse(float* re, float* im, float* out) const
+	{
+		// merge the real spectrum back into the half size spectrum, Z[k] = E[k] + i O[k]
+		const float first = re[0];
+		const float last = re[m_half];
+		re[0] = 0.5f * (first + last);
+		im[0] = 0.5f * (first - last);
+		for (unsigned k = 1; k <= m_half / 2; ++k)
+		{
+			const unsigned mirror = m_half - k;
+			const float ar = re[k], ai = im[k];
+			const float br = re[mirror], bi = im[mirror];
+
+			// E = (a + conj b) / 2, O = (a - conj b) conj(W^k) / 2
+			const float er = 0.5f * (ar + br);
+			const float ei = 0.5f * (ai - bi);
+			const float dr = 0.5f * (ar - br);
+			const float di = 0.5f * (ai + bi);
+			const float wr = m_splitRe[k], wi = -m_splitIm[k];
+			const float or_ = dr * wr - di * wi;
+			const float oi = dr * wi + di * wr;
+
+			// the mirror bin has E' = conj(E) and O' = (b - conj a) conj(W^(half - k)) / 2
+			const float mr = -dr, mi = di;
+			const float vr = m_splitRe[mirror], vi = -m_splitIm[mirror];
+			const float pr = mr * vr - mi * vi;
+			const float pi = mr * vi + mi * vr;
+
+			re[k] = er - oi;
+			im[k] = ei + or_;
+			re[mirror] = er - pi;
+			im[mirror] = -ei + pr;
+		}
+
+		// bit reverse in place, then transform back
+		for (unsigned k = 0; k < m_half; ++k)
+		{
+			const unsigned index = m_bitReverse[k];
+			if (k < index)
+			{
+				std::swap(re[k], re[index]);
+				std::swap(im[k], im[index]);
+			}
+		}
+		Transform(re, im, true);
+
+		const float scale = 1.f / (float)m_half;
+		for (unsigned k = 0; k < m_half; ++k)
+		{
+			out[2 * k] = re[k] * scale;
+			out[2 * k + 1] = im[k] * scale;
+		}
+	}
+} // namespace PlaneverbDSP
@@ -0,0 +1,41 @@
+#pragma once
+#include "PvDSPDefinitions.h"
+#include <cstddef>
+
+namespace PlaneverbDSP
+{
+	// Real FFT of a fixed power of two size. the spectrum of size reals is size / 2 + 1 bins, kept as separate
+	// real and imaginary arrays. runs as a radix 2 complex FFT of half the size, tables are placed in memory
+	// given by the owner
+	class FFT
+	{
+	public:
+		// mem holds GetMemoryRequirement(size) bytes
+		FFT(unsigned size, char* mem);
+		~FFT() = default;
+
+		// spectrum of size reals, unscaled
+		void Forward(const float* in, float* re, float* im) const;
+
+		// size reals from size / 2 + 1 bins, scaled so Inverse(Forward(x)) is x.
+		// re and im are used as scratch and are overwritten
+		void Inverse(float* re, float* im, float* out) const;
+
+		PV_DSP_INLINE unsigned GetSize() const { return m_size; }
+		PV_DSP_INLINE unsigned GetBinCount() const { return m_size / 2 + 1; }
+
+		static size_t GetMemoryRequirement(unsigned size);
+
+	private:
+		// in place complex FFT of m_size / 2 points, inverse with conjugate twiddles, unscaled
+		void Transform(float* re, float* im, bool inverse) const;
+
+		unsigned m_size;			// reals per transform
+		unsigned m_half;			// points of the complex FFT
+		unsigned* m_bitReverse;		// bit reversed index of each complex point
+		float* m_twiddleRe;			// twiddles of each stage, e^(-pi i k / half) from half - 1 for k < half
+		float* m_twiddleIm;
+		float* m_splitRe;			// e^(-2 pi i k / m_size), k <= m_half, splits the half size FFT into the real spectrum
+		float* m_splitIm;
+	};
+} // namespace PlaneverbDSP
@@ -5,15 +5,16 @@
 
 namespace PlaneverbDSP
 {
-	ImpulseResponse::ImpulseResponse(float rt60, float samplingRate) : 
+	ImpulseResponse::ImpulseResponse(float rt60, float samplingRate, unsigned variant) : 
 		m_inTimeDomain(nullptr),
 		m_rt60(rt60),
 		m_samplingRate(samplingRate)
 	{
-		m_arraySize = (unsigned)(m_samplingRate * m_rt60);
+		m_arraySize = GetArraySize(m_rt60, m_samplingRate);
 
 		m_inTimeDomain = new float[m_arraySize];
 		std::default_random_engine generator;
+		generator.seed(std::default_random_engine::default_seed + variant);
 		std::uniform_real_distribution<float> distribution(-1.f, 1.f);
 		const constexpr float T60_CONSTANT = 6.91f;
 		float tau = m_rt60 / T60_CONSTANT * m_samplingRate * -1.f;
@@ -6,9 +6,13 @@ namespace PlaneverbDSP
 	class ImpulseResponse
 	{
 	public:
-		ImpulseResponse(float rt60, float samplingRate);
+		// responses of different variants are made of uncorrelated noise
+		ImpulseResponse(float rt60, float samplingRate, unsigned variant = 0);
 		~ImpulseResponse();
 
+		// number of samples in a response of the given decay time
+		static PV_DSP_INLINE unsigned GetArraySize(float rt60, float samplingRate) { return (unsigned)(samplingRate * rt60); }
+
 		PV_DSP_INLINE const float* GetTimeDomain() const { return m_inTimeDomain; }
 		PV_DSP_INLINE unsigned GetArraySize() const { return m_arraySize; }
 		PV_DSP_INLINE float GetRT60() const { return m_rt60; }
@@ -0,0 +1,167 @@
+#include "DSP\Reverb.h"
+#include <cmath>
+#include <xmmintrin.h>
+
+namespace PlaneverbDSP
+{
+	namespace
+	{
+		// comb and allpass delays (ms) of the left channel
+		const constexpr float COMB_DELAYS[PV_DSP_REVERB_COMBS] = { 29.7f, 37.1f, 41.1f, 43.7f };
+		const constexpr float ALLPASS_DELAYS[PV_DSP_REVERB_ALLPASSES] = { 5.0f, 1.7f };
+
+		// time (ms) each allpass takes to decay by 60 dB, sets its gain
+		const constexpr float ALLPASS_RVT[PV_DSP_REVERB_ALLPASSES] = { 96.83f, 32.92f };
+
+		// right channel delays are this much longer (ms)
+		const constexpr float STEREO_SPREAD = 0.52f;
+
+		const constexpr float COMB_GAIN_BASE = 0.001f;			// -60 dB
+		const constexpr float COMB_ATTEN = 0.5f;				// 1 / sqrt(combs)
+		const constexpr float COMB_DAMPING = 0.2f;				// pole of the feedback lowpass, its DC gain is 1
+		const constexpr unsigned MOVING_AVERAGE_WINDOW_SIZE = 10;
+
+		PV_DSP_INLINE unsigned CalculateNumDelays(float samplingRate, float msDelay)
+		{
+			return static_cast<unsigned>(msDelay / 1000.f * samplingRate);
+		}
+
+		// power of two longer than the delay, so the oldest sample read is never the one being written
+		PV_DSP_INLINE unsigned RingLength(unsigned delay)
+		{
+			unsigned length = 1;
+			while (length <= delay)
+				length <<= 1;
+			return length;
+		}
+
+		PV_DSP_INLINE float ChannelDelay(float msDelay, int channel)
+		{
+			return msDelay + STEREO_SPREAD * (float)channel;
+		}
+	} // namespace <>
+
+	Reverb::Reverb(float decayTime, float samplingRate, char* mem) :
+		m_decayTime(decayTime), m_position(0)
+	{
+		// combs, every channel and comb shares the ring, sized for the longest delay
+		const unsigned combFrames = RingLength(CalculateNumDelays(samplingRate, ChannelDelay(COMB_DELAYS[PV_DSP_REVERB_COMBS - 1], PV_DSP_CHANNEL_COUNT - 1)));
+		m_combRing = reinterpret_cast<float*>(mem);
+		m_combMask = combFrames - 1;
+		mem += sizeof(float) * combFrames * PV_DSP_CHANNEL_COUNT * PV_DSP_REVERB_COMBS;
+		for (int channel = 0; channel < PV_DSP_CHANNEL_COUNT; ++channel)
+		{
+			for (int j = 0; j < PV_DSP_REVERB_COMBS; ++j)
+			{
+				const float msDelay = ChannelDelay(COMB_DELAYS[j], channel);
+				m_combDelays[channel][j] = CalculateNumDelays(samplingRate, msDelay);
+				m_combGains[channel][j] = std::pow(COMB_GAIN_BASE, msDelay / (decayTime * 1000.f));
+				m_combLowpass[channel][j] = 0.f;
+			}
+		}
+
+		// allpasses
+		for (int channel = 0; channel < PV_DSP_CHANNEL_COUNT; ++channel)
+		{
+			for (int j = 0; j < PV_DSP_REVERB_ALLPASSES; ++j)
+			{
+				AllpassFilter& filter = m_allpassFilters[channel][j];
+				filter.delay = CalculateNumDelays(samplingRate, ChannelDelay(ALLPASS_DELAYS[j], channel));
+				filter.gain = std::pow(COMB_GAIN_BASE, ALLPASS_DELAYS[j] / ALLPASS_RVT[j]);
+				filter.ring = reinterpret_cast<float*>(mem);
+				filter.mask = RingLength(filter.delay) - 1;
+				mem += sizeof(float) * (filter.mask + 1);
+			}
+		}
+
+		// noise filters
+		for (int channel = 0; channel < PV_DSP_CHANNEL_COUNT; ++channel)
+		{
+			MovingAverageFilter& filter = m_noiseFilters[channel];
+			filter.windowSize = MOVING_AVERAGE_WINDOW_SIZE;
+			filter.sum = 0.f;
+			filter.ring = reinterpret_cast<float*>(mem);
+			filter.mask = RingLength(MOVING_AVERAGE_WINDOW_SIZE) - 1;
+			mem += sizeof(float) * (filter.mask + 1);
+		}
+	}
+
+	size_t Reverb::GetMemoryRequirement(float samplingRate)
+	{
+		size_t size = sizeof(float) * PV_DSP_CHANNEL_COUNT * PV_DSP_REVERB_COMBS *
+			RingLength(CalculateNumDelays(samplingRate, ChannelDelay(COMB_DELAYS[PV_DSP_REVERB_COMBS - 1], PV_DSP_CHANNEL_COUNT - 1)));
+		for (int channel = 0; channel < PV_DSP_CHANNEL_COUNT; ++channel)
+		{
+			for (int j = 0; j < PV_DSP_REVERB_ALLPASSES; ++j)
+				size += sizeof(float) * RingLength(CalculateNumDelays(samplingRate, ChannelDelay(ALLPASS_DELAYS[j], channel)));
+			size += sizeof(float) * RingLength(MOVING_AVERAGE_WINDOW_SIZE);
+		}
+		return size;
+	}
+
+	void Reverb::Process(const float* in, float* out, int numFrames)
+	{
+		// the feedback loops fade into denormals once the input goes quiet, flush them to 0
+		const unsigned csr = _mm_getcsr();
+		_mm_setcsr(csr | 0x8040);
+
+		const __m128 damping = _mm_set1_ps(COMB_DAMPING);
+		const __m128 undamped = _mm_set1_ps(1.f - COMB_DAMPING);
+		const int lanes = PV_DSP_CHANNEL_COUNT * PV_DSP_REVERB_COMBS;
+		__m128 gains[PV_DSP_CHANNEL_COUNT];
+		__m128 lowpass[PV_DSP_CHANNEL_COUNT];
+		for (int channel = 0; channel < PV_DSP_CHANNEL_COUNT; ++channel)
+		{
+			gains[channel] = _mm_loadu_ps(m_combGains[channel]);
+			lowpass[channel] = _mm_loadu_ps(m_combLowpass[channel]);
+		}
+
+		for (int frame = 0; frame < numFrames; ++frame, ++m_position, in += PV_DSP_CHANNEL_COUNT, out += PV_DSP_CHANNEL_COUNT)
+		{
+			float* const combWrite = m_combRing + (size_t)(m_position & m_combMask) * lanes;
+			float input[PV_DSP_CHANNEL_COUNT];
+			for (int channel = 0; channel < PV_DSP_CHANNEL_COUNT; ++channel)
+				input[channel] = in[channel];
+
+			for (int channel = 0; channel < PV_DSP_CHANNEL_COUNT; ++channel)
+			{
+				// all combs of the channel at once, y[n] = x[n] + g * lowpass(y[n - D])
+				const unsigned* delays = m_combDelays[channel];
+				const float* combRing = m_combRing + channel * PV_DSP_REVERB_COMBS;
+				const __m128 taps = _mm_setr_ps(
+					combRing[(size_t)((m_position - delays[0]) & m_combMask) * lanes + 0],
+					combRing[(size_t)((m_position - delays[1]) & m_combMask) * lanes + 1],
+					combRing[(size_t)((m_position - delays[2]) & m_combMask) * lanes + 2],
+					combRing[(size_t)((m_position - delays[3]) & m_combMask) * lanes + 3]);
+				lowpass[channel] = _mm_add_ps(_mm_mul_ps(taps, undamped), _mm_mul_ps(lowpass[channel], damping));
+				const __m128 combs = _mm_add_ps(_mm_set1_ps(input[channel]), _mm_mul_ps(lowpass[channel], gains[channel]));
+				_mm_storeu_ps(combWrite + channel * PV_DSP_REVERB_COMBS, combs);
+
+				// sum the combs
+				__m128 sum = _mm_add_ps(combs, _mm_movehl_ps(combs, combs));
+				sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+				float sample = _mm_cvtss_f32(sum) * COMB_ATTEN;
+
+				// allpasses in series
+				for (int j = 0; j < PV_DSP_REVERB_ALLPASSES; ++j)
+				{
+					AllpassFilter& filter = m_allpassFilters[channel][j];
+					const float delayed = filter.ring[(m_position - filter.delay) & filter.mask];
+					const float w = sample - filter.gain * delayed;
+					filter.ring[m_position & filter.mask] = w;
+					sample = filter.gain * w + delayed;
+				}
+
+				// smooth the output
+				MovingAverageFilter& noise = m_noiseFilters[channel];
+				noise.sum += sample - noise.ring[(m_position - noise.windowSize) & noise.mask];
+				noise.ring[m_position & noise.mask] = sample;
+				out[channel] = noise.sum / (float)noise.windowSize;
+			}
+		}
+
+		for (int channel = 0; channel < PV_DSP_CHANNEL_COUNT; ++channel)
+			_mm_storeu_ps(m_combLowpass[channel], lowpass[channel]);
+		_mm_setcsr(csr);
+	}
+} // namespace PlaneverbDSP
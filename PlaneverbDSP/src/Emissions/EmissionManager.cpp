@@ -0,0 +1,143 @@
+#include "Emissions\EmissionManager.h"
+#include <new>
+
+namespace PlaneverbDSP
+{
+	namespace
+	{
+		// float arrays in one EmissionParameters
+		const constexpr unsigned PARAMETER_COUNT = 11;
+
+		// places each parameter's array of capacity floats
+		PV_DSP_INLINE char* PlaceParameters(EmissionParameters& parameters, unsigned capacity, char* mem)
+		{
+			float** arrays[PARAMETER_COUNT] =
+			{
+				&parameters.occlusion, &parameters.wetGain, &parameters.rt60,
+				&parameters.directionX, &parameters.directionY,
+				&parameters.positionX, &parameters.positionY,
+				&parameters.forwardX, &parameters.forwardY,
+				&parameters.directivityX, &parameters.directivityY
+			};
+			for (float** array : arrays)
+			{
+				*array = reinterpret_cast<float*>(mem); mem += sizeof(float) * capacity;
+			}
+			return mem;
+		}
+	} // namespace <>
+
+	EmissionsManager::EmissionsManager(float samplingRate, unsigned capacity, char* mem) :
+		m_samplingRate(samplingRate),
+		m_capacity(capacity),
+		m_freeFirst(0),
+		m_freeCount(0),
+		m_slotCount(0),
+		m_callbackCount(0)
+	{
+		PV_DSP_ASSERT(capacity > 0 && capacity <= PV_DSP_EMITTER_SLOT_MASK);
+
+		// place arrays, widest elements first
+		m_handles = reinterpret_cast<std::atomic<EmissionID>*>(mem); mem += sizeof(std::atomic<EmissionID>) * capacity;
+		m_filters = reinterpret_cast<LowpassFilter*>(mem); mem += sizeof(LowpassFilter) * capacity;
+		mem = PlaceParameters(m_current, capacity, mem);
+		mem = PlaceParameters(m_target, capacity, mem);
+		m_patterns = reinterpret_cast<PlaneverbDSPSourceDirectivityPattern*>(mem); mem += sizeof(PlaneverbDSPSourceDirectivityPattern) * capacity;
+		m_freeSlots = reinterpret_cast<unsigned*>(mem); mem += sizeof(unsigned) * capacity;
+		m_freedAt = reinterpret_cast<unsigned*>(mem); mem += sizeof(unsigned) * capacity;
+		m_generations = reinterpret_cast<unsigned*>(mem); mem += sizeof(unsigned) * capacity;
+
+		for (unsigned i = 0; i < capacity; ++i)
+		{
+			new (m_handles + i) std::atomic<EmissionID>(PV_INVALID_EMISSION_ID);
+			new (m_filters + i) LowpassFilter(m_samplingRate);
+			m_generations[i] = 0;
+		}
+	}
+
+	EmissionsManager::~EmissionsManager()
+	{
+		for (unsigned i = 0; i < m_capacity; ++i)
+		{
+			m_filters[i].~LowpassFilter();
+		}
+	}
+
+	size_t EmissionsManager::GetMemoryRequirement(unsigned capacity)
+	{
+		return (sizeof(std::atomic<EmissionID>) +
+			sizeof(LowpassFilter) +
+			sizeof(float) * PARAMETER_COUNT * 2 +
+			sizeof(PlaneverbDSPSourceDirectivityPattern) +
+			sizeof(unsigned) * 3) * capacity;
+	}
+
+	EmissionID EmissionsManager::Add()
+	{
+		// reuse a freed slot before touching a new one, unless the audio thread may still be using it
+		unsigned slot;
+		const unsigned slotCount = m_slotCount.load(std::memory_order_relaxed);
+		if (m_freeCount > 0 &&
+			m_freedAt[m_freeSlots[m_freeFirst]] != m_callbackCount.load(std::memory_order_acquire))
+		{
+			slot = m_freeSlots[m_freeFirst];
+			m_freeFirst = (m_freeFirst + 1 == m_capacity) ? 0 : m_freeFirst + 1;
+			--m_freeCount;
+		}
+		else if (slotCount < m_capacity)
+		{
+			slot = slotCount;
+		}
+		else
+		{
+			return PV_INVALID_EMISSION_ID;
+		}
+
+		ResetSlot(slot);
+		m_generations[slot] = (m_generations[slot] % PV_DSP_EMITTER_GENERATION_MASK) + 1;
+		const EmissionID id = ((EmissionID)m_generations[slot] << PV_DSP_EMITTER_SLOT_BITS) | slot;
+
+		// parameters are in place before the audio thread can find the emitter
+		m_handles[slot].store(id, std::memory_order_release);
+		if (slot == slotCount)
+		{
+			m_slotCount.store(slotCount + 1, std::memory_order_release);
+		}
+		return id;
+	}
+
+	void EmissionsManager::Remove(EmissionID id)
+	{
+		const int slot = Find(id);
+		if (slot < 0)
+		{
+			return;
+		}
+		m_handles[slot].store(PV_INVALID_EMISSION_ID, std::memory_order_release);
+		m_freedAt[slot] = m_callbackCount.load(std::memory_order_acquire);
+		const unsigned last = m_freeFirst + m_freeCount;
+		m_freeSlots[(last >= m_capacity) ? last - m_capacity : last] = (unsigned)slot;
+		++m_freeCount;
+	}
+
+	void EmissionsManager::ResetSlot(unsigned slot)
+	{
+		EmissionParameters* parameters[2] = { &m_current, &m_target };
+		for (EmissionParameters* p : parameters)
+		{
+			p->occlusion[slot] = 1.f;
+			p->wetGain[slot] = 1.f;
+			p->rt60[slot] = 0.f;
+			p->directionX[slot] = 0.f;
+			p->directionY[slot] = 0.f;
+			p->positionX[slot] = 0.f;
+			p->positionY[slot] = 0.f;
+			p->forwardX[slot] = 0.f;
+			p->forwardY[slot] = 0.f;
+			p->directivityX[slot] = 0.f;
+			p->directivityY[slot] = 0.f;
+		}
+		m_filters[slot] = LowpassFilter(m_samplingRate);
+		m_patterns[slot] = pvd_Cardioid;
+	}
+} // namespace PlaneverbDSP
@@ -2,78 +2,105 @@
 #include "PvDSPTypes.h"
 #include "PvDSPDefinitions.h"
 #include "DSP\Lowpass.h"
-#include <unordered_map>
+#include <atomic>
+#include <cstddef>
 
 namespace PlaneverbDSP
 {
-	// data stored per emission
-	struct EmissionData
+	// an EmissionID keeps the emitter's slot in its low bits and the slot's generation above them.
+	// generations start at 1 so no handle is 0, and stay below bit 31 so handles pass through an int
+	const constexpr unsigned PV_DSP_EMITTER_SLOT_BITS = 16;
+	const constexpr EmissionID PV_DSP_EMITTER_SLOT_MASK = ((EmissionID)1 << PV_DSP_EMITTER_SLOT_BITS) - 1;
+	const constexpr unsigned PV_DSP_EMITTER_GENERATION_MASK = 0x7FFF;
+
+	// per emission parameters, an array per parameter indexed by slot
+	struct EmissionParameters
 	{
-		LowpassFilter lpf;			 // lowpass filter for mono mixdown channel
-		float occlusion = 1.f;		 // occlusion parameter
-		float wetGain = 1.f;		 // wet gain for reverb
-		float rt60 = 0.f;			 // decay time parameter
-		vec2 direction = { 0, 0 };	 // direction parameter
-		vec2 position = { 0, 0 };	 // position for distance attenuation
-		vec2 forward = { 0, 0 };	 // forward vector for spatialization
-		vec2 directivity = { 0, 0 }; // source directivity parameter
-		PlaneverbDSPSourceDirectivityPattern directivityPattern;
-		EmissionData(float samplingRate) :
-			lpf{ samplingRate },
-			occlusion(1.f),
-			wetGain(1.f),
-			rt60(0.f),
-			direction{ 0, 0 },
-			forward{ 0, 0 },
-			directivity{ 0, 0 },
-			directivityPattern(pvd_Cardioid)
-		{}
+		float* occlusion;		// occlusion parameter
+		float* wetGain;			// wet gain for reverb
+		float* rt60;			// decay time parameter
+		float* directionX;		// direction parameter
+		float* directionY;
+		float* positionX;		// position for distance attenuation
+		float* positionY;
+		float* forwardX;		// forward vector for spatialization
+		float* forwardY;
+		float* directivityX;	// source directivity parameter
+		float* directivityY;
 	};
 
-	// Manages audio playback data at runtime
+	// Manages audio playback data at runtime.
+	// a fixed number of slots lives in memory given by the owner, so adding emitters never allocates.
+	// parameters are kept in parallel arrays walked from slot 0 to GetSlotCount(), freed slots stay in place
+	// until reused so the audio thread never sees an emitter move. a slot's generation changes when it is
+	// freed, handles of removed emitters then find nothing. a freed slot is only reused after the callback that
+	// may still be processing it has ended
 	class EmissionsManager
 	{
-		using EmissionMap = std::unordered_map<EmissionID, EmissionData>;
-
 	public:
-		EmissionsManager(float samplingRate) :
-			m_emissionsCurrent(),
-			m_emissionsTarget(),
-			m_samplingRate(samplingRate)
-		{}
-		PV_DSP_INLINE EmissionData& GetDataCurrent(const EmissionID& id)
+		// mem holds GetMemoryRequirement(capacity) bytes
+		EmissionsManager(float samplingRate, unsigned capacity, char* mem);
+		~EmissionsManager();
+
+		// takes a free slot, PV_INVALID_EMISSION_ID if all are in use or freed during the current callback.
+		// Add and Remove are called from one thread, the audio thread only looks emitters up
+		EmissionID Add();
+
+		// frees the emitter's slot, stale handles are ignored
+		void Remove(EmissionID id);
+
+		// called by the audio thread once all sources of a callback are processed
+		PV_DSP_INLINE void EndCallback()
 		{
-			// finds id in the map, if doesn't exist makes a new one
-			auto it = m_emissionsCurrent.find(id);
-			if (it == m_emissionsCurrent.end())
-			{
-				auto r = m_emissionsCurrent.insert_or_assign(id, EmissionData(m_samplingRate));
-				return r.first->second;
-			}
-			else
-			{
-				return it->second;
-			}
+			m_callbackCount.store(m_callbackCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
 		}
 
-		PV_DSP_INLINE EmissionData& GetDataTarget(const EmissionID& id)
+		// slot of a live emitter, -1 for removed or invalid handles
+		PV_DSP_INLINE int Find(EmissionID id) const
 		{
-			// finds in the target map, if doesn't exist, makes a new one
-			auto it = m_emissionsTarget.find(id);
-			if (it == m_emissionsTarget.end())
-			{
-				auto r = m_emissionsTarget.insert_or_assign(id, EmissionData(m_samplingRate));
-				return r.first->second;
-			}
-			else
+			const EmissionID slot = id & PV_DSP_EMITTER_SLOT_MASK;
+			if (slot >= m_capacity || m_handles[slot].load(std::memory_order_acquire) != id)
 			{
-				return it->second;
+				return -1;
 			}
+			return (int)slot;
 		}
 
+		PV_DSP_INLINE bool IsLive(unsigned slot) const
+		{
+			return m_handles[slot].load(std::memory_order_acquire) != PV_INVALID_EMISSION_ID;
+		}
+
+		PV_DSP_INLINE EmissionParameters& GetCurrent() { return m_current; }
+		PV_DSP_INLINE EmissionParameters& GetTarget() { return m_target; }
+		PV_DSP_INLINE LowpassFilter& GetFilter(int slot) { return m_filters[slot]; }
+		PV_DSP_INLINE PlaneverbDSPSourceDirectivityPattern& GetPattern(int slot) { return m_patterns[slot]; }
+
+		// one past the highest slot in use so far
+		PV_DSP_INLINE unsigned GetSlotCount() const { return m_slotCount.load(std::memory_order_acquire); }
+		PV_DSP_INLINE unsigned GetCapacity() const { return m_capacity; }
+
+		static size_t GetMemoryRequirement(unsigned capacity);
+
 	private:
-		EmissionMap m_emissionsCurrent;	// data for current emissions
-		EmissionMap m_emissionsTarget;	// data for what emissions should target
-		float m_samplingRate;			// audio engine sampling rate for LPF
+		// puts a slot's parameters back to their defaults
+		void ResetSlot(unsigned slot);
+
+		float m_samplingRate;					// audio engine sampling rate for LPF
+		unsigned m_capacity;					// number of slots
+
+		std::atomic<EmissionID>* m_handles;		// handle of the emitter in each slot, PV_INVALID_EMISSION_ID if free
+		unsigned* m_generations;				// generation of the last handle given out per slot
+		unsigned* m_freeSlots;					// ring of freed slots below m_slotCount, oldest first
+		unsigned* m_freedAt;					// callback count when each slot was freed
+		unsigned m_freeFirst;					// ring position of the oldest freed slot
+		unsigned m_freeCount;					// slots in the ring
+		std::atomic<unsigned> m_slotCount;		// slots handed out at least once
+		std::atomic<unsigned> m_callbackCount;	// callbacks ended by the audio thread
+
+		EmissionParameters m_current;			// parameters being lerped each callback
+		EmissionParameters m_target;			// parameters the current ones lerp toward
+		LowpassFilter* m_filters;				// lowpass filter for mono mixdown channel
+		PlaneverbDSPSourceDirectivityPattern* m_patterns;	// source directivity pattern
 	};
 } // namespace PlaneverbDSP
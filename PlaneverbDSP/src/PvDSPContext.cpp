@@ -1,13 +1,18 @@
 #include "PvDSPContext.h"
 #include "DSP\Lowpass.h"
 #include "Emissions\EmissionManager.h"
+#include "Threading\WorkerPool.h"
 
 #include "DSP\ImpulseResponse.h"
 #include "DSP\Convolver.h"
+#include "DSP\Reverb.h"
 
 #include <cstring>
+#include <cstddef>
+#include <cstdint>
 #include <cmath>
 #include <algorithm>
+#include <emmintrin.h>
 
 namespace PlaneverbDSP
 {
@@ -48,6 +53,14 @@ namespace PlaneverbDSP
 			g_context->SubmitSource(id, dspParams, in, numFrames);
 	}
 
+	// sends a batch of sources to the context
+	void SendSources(const EmissionID* ids, const PlaneverbDSPInput* dspParams,
+		const float* const* in, unsigned numSources, unsigned numFrames)
+	{
+		if (g_context)
+			g_context->SubmitSources(ids, dspParams, in, numSources, numFrames);
+	}
+
 	// retrieves output from the context
 	void GetOutput(float** dryOut, float** outA, float** outB, float** outC)
 	{
@@ -70,31 +83,70 @@ namespace PlaneverbDSP
 			g_context->SetListenerTransform({ posX, posY, posZ }, { forwardX, forwardY, forwardZ });
 	}
 
+	EmissionID AddEmitter()
+	{
+		if (g_context)
+			return g_context->GetEmissionManager()->Add();
+		return PV_INVALID_EMISSION_ID;
+	}
+
+	void RemoveEmitter(EmissionID id)
+	{
+		if (g_context)
+			g_context->GetEmissionManager()->Remove(id);
+	}
+
 	void UpdateEmitter(EmissionID id, float posX, float posY, float posZ,
 		float forwardX, float forwardY, float forwardZ)
 	{
 		if (g_context)
 		{
-			auto& data = g_context->GetEmissionManager()->GetDataTarget(id);
-			data.forward = { forwardX, forwardZ };
-			data.position = { posX, posZ };
+			EmissionsManager* emissions = g_context->GetEmissionManager();
+			int slot = emissions->Find(id);
+			if (slot >= 0)
+			{
+				EmissionParameters& target = emissions->GetTarget();
+				target.forwardX[slot] = forwardX;
+				target.forwardY[slot] = forwardZ;
+				target.positionX[slot] = posX;
+				target.positionY[slot] = posZ;
+			}
 		}
 	}
 
 	void SetEmitterDirectivityPattern(EmissionID id, PlaneverbDSPSourceDirectivityPattern pattern)
 	{
 		if (g_context)
-			g_context->GetEmissionManager()->GetDataTarget(id).directivityPattern = pattern;
+		{
+			EmissionsManager* emissions = g_context->GetEmissionManager();
+			int slot = emissions->Find(id);
+			if (slot >= 0)
+				emissions->GetPattern(slot) = pattern;
+		}
 	}
 	#pragma endregion
 
+	namespace
+	{
+		// every block of the context's memory starts on this boundary, so the objects placed in it and the SIMD
+		// loads of its buffers are aligned whatever sizes the config gives the blocks before them
+		const constexpr size_t POOL_ALIGNMENT = (alignof(std::max_align_t) > 16) ? alignof(std::max_align_t) : 16;
+
+		// size rounded up to the next block boundary
+		PV_DSP_INLINE size_t AlignBlock(size_t size)
+		{
+			return (size + POOL_ALIGNMENT - 1) & ~(POOL_ALIGNMENT - 1);
+		}
+	} // namespace <>
+
 	Context::Context(const PlaneverbDSPConfig* config)
 	{
 		// copy the config
 		std::memcpy(&m_config, config, sizeof(PlaneverbDSPConfig));
 
 		// throw if input is invalid
-		if (config->maxCallbackLength > PV_DSP_MAX_CALLBACK_LENGTH || config->dspSmoothingFactor <= 0)
+		if (config->maxCallbackLength > PV_DSP_MAX_CALLBACK_LENGTH || config->dspSmoothingFactor <= 0 ||
+			config->maxEmitters == 0 || config->mixingThreads > PV_DSP_MAX_WORKER_THREADS)
 		{
 			throw pvd_InvalidConfig;
 		}
@@ -103,12 +155,41 @@ namespace PlaneverbDSP
 		m_bufferSize = PV_DSP_CHANNEL_COUNT * config->maxCallbackLength * sizeof(float);
 
 		// allocate memory all at once
-		unsigned size =
-			m_bufferSize / PV_DSP_CHANNEL_COUNT + // 1 input temp storage buffer, mono
-			m_bufferSize * 4 * 2 +			// 4 ouput buffers, double buffered
-			sizeof(EmissionsManager) +		// emissions manager
-			sizeof(ImpulseResponse) +		// impulse response	- not currently supported
-			sizeof(Convolver);				// convolver		- not currently supported
+		const float decayTimes[PV_DSP_WET_BUS_COUNT] = { PV_DSP_T_ER_1, PV_DSP_T_ER_2, PV_DSP_T_ER_3 };
+		const bool useCombs = m_config.useBuiltInReverb && !m_config.useConvolutionReverb;
+		const bool useConvolution = m_config.useBuiltInReverb && m_config.useConvolutionReverb;
+		size_t reverbSize = 0;
+		for (int i = 0; i < PV_DSP_WET_BUS_COUNT; ++i)
+		{
+			if (useCombs)
+			{
+				reverbSize += AlignBlock(sizeof(Reverb)) + AlignBlock(Reverb::GetMemoryRequirement((float)m_config.samplingRate));
+			}
+			else if (useConvolution)
+			{
+				const unsigned responseLength = ImpulseResponse::GetArraySize(decayTimes[i], (float)m_config.samplingRate);
+				reverbSize += AlignBlock(sizeof(ImpulseResponse)) * PV_DSP_CHANNEL_COUNT + AlignBlock(sizeof(Convolver)) +
+					AlignBlock(Convolver::GetMemoryRequirement(responseLength, PV_DSP_CHANNEL_COUNT));
+			}
+		}
+		const unsigned batchSize = (m_config.maxEmitters + 3u) & ~3u;
+		const unsigned threadCount = m_config.mixingThreads;
+		m_workerStride = m_bufferSize * 4 / sizeof(float) + PV_DSP_MIX_BLOCK;
+		const size_t workerSize = (threadCount > 0) ?
+			AlignBlock(sizeof(WorkerPool)) + AlignBlock(WorkerPool::GetMemoryRequirement(threadCount)) +
+			AlignBlock(sizeof(float) * m_workerStride * threadCount) : 0;
+		size_t size =
+			POOL_ALIGNMENT - 1 +			// room to align the first block
+			AlignBlock(m_bufferSize / PV_DSP_CHANNEL_COUNT) + // 1 input temp storage buffer, mono
+			AlignBlock(m_bufferSize * 4) * 2 + // 4 ouput buffers, double buffered
+			AlignBlock(sizeof(EmissionsManager)) + // emissions manager
+			AlignBlock(EmissionsManager::GetMemoryRequirement(m_config.maxEmitters)) + // emitter slots
+			AlignBlock(sizeof(float*) * batchSize) + // batch of sources
+			AlignBlock((sizeof(int) + sizeof(float) * (1 + 2 * sg_Count)) * batchSize) +
+			AlignBlock(sizeof(unsigned) * m_config.maxEmitters) + // batch number per emitter slot
+			AlignBlock(sizeof(float) * (m_config.maxCallbackLength + 1)) + // lerp ramp
+			workerSize +					// mixing threads and their output buffers
+			reverbSize;						// built in reverbs, delay lines or partitions after each reverb
 		m_mem = new char[size];
 		if (!m_mem)
 		{
@@ -116,29 +197,79 @@ namespace PlaneverbDSP
 		}
 		std::memset(m_mem, 0, size);
 
-		// place memory locations
-		char* temp = m_mem;
-		m_inputStorage = reinterpret_cast<float*>(temp); temp += m_bufferSize / PV_DSP_CHANNEL_COUNT;
+		// place memory locations, each block rounded up with AlignBlock so the next one starts aligned
+		char* const pool = m_mem + AlignBlock(reinterpret_cast<uintptr_t>(m_mem)) - reinterpret_cast<uintptr_t>(m_mem);
+		char* temp = pool;
+		m_batch.inputs = reinterpret_cast<const float**>(temp); temp += AlignBlock(sizeof(float*) * batchSize);
+		if (threadCount > 0)
+		{
+			char* threadsMem = temp + AlignBlock(sizeof(WorkerPool));
+			m_workers = new (temp) WorkerPool(threadCount, threadsMem);
+			temp = threadsMem + AlignBlock(WorkerPool::GetMemoryRequirement(threadCount));
+		}
+		char* emissionsMem = temp + AlignBlock(sizeof(EmissionsManager));
+		m_emissions = new (temp) EmissionsManager((float)m_config.samplingRate, m_config.maxEmitters, emissionsMem);
+		temp = emissionsMem + AlignBlock(EmissionsManager::GetMemoryRequirement(m_config.maxEmitters));
+
+		m_batch.slots = reinterpret_cast<int*>(temp); temp += sizeof(int) * batchSize;
+		m_batch.cutoffs = reinterpret_cast<float*>(temp); temp += sizeof(float) * batchSize;
+		for (int i = 0; i < sg_Count; ++i)
+		{
+			m_batch.targets[i] = reinterpret_cast<float*>(temp); temp += sizeof(float) * batchSize;
+			m_batch.offsets[i] = reinterpret_cast<float*>(temp); temp += sizeof(float) * batchSize;
+		}
+		temp = pool + AlignBlock(temp - pool);
+		m_slotBatches = reinterpret_cast<unsigned*>(temp); temp += AlignBlock(sizeof(unsigned) * m_config.maxEmitters);
+		m_ramp = reinterpret_cast<float*>(temp); temp += AlignBlock(sizeof(float) * (m_config.maxCallbackLength + 1));
+
+		// the 4 buffers of each set stay back to back, they are cleared and mixed as one block
+		m_inputStorage = reinterpret_cast<float*>(temp); temp += AlignBlock(m_bufferSize / PV_DSP_CHANNEL_COUNT);
 		m_dryOutputBuffer_1 = reinterpret_cast<float*>(temp); temp += m_bufferSize;
 		m_outputBufferA_1 = reinterpret_cast<float*>(temp); temp += m_bufferSize;
 		m_outputBufferB_1 = reinterpret_cast<float*>(temp); temp += m_bufferSize;
 		m_outputBufferC_1 = reinterpret_cast<float*>(temp); temp += m_bufferSize;
+		temp = pool + AlignBlock(temp - pool);
 		m_dryOutputBuffer_2 = reinterpret_cast<float*>(temp); temp += m_bufferSize;
 		m_outputBufferA_2 = reinterpret_cast<float*>(temp); temp += m_bufferSize;
 		m_outputBufferB_2 = reinterpret_cast<float*>(temp); temp += m_bufferSize;
 		m_outputBufferC_2 = reinterpret_cast<float*>(temp); temp += m_bufferSize;
+		temp = pool + AlignBlock(temp - pool);
 		m_wetOutputA = m_outputBufferA_1;
 		m_wetOutputB = m_outputBufferB_1;
 		m_wetOutputC = m_outputBufferC_1;
 		m_dryOutput = m_dryOutputBuffer_1;
+		if (threadCount > 0)
+		{
+			m_workerOutputs = reinterpret_cast<float*>(temp); temp += AlignBlock(sizeof(float) * m_workerStride * threadCount);
+		}
 
-		m_emissions = reinterpret_cast<EmissionsManager*>(temp); temp += sizeof(EmissionsManager);
-		m_responseA = reinterpret_cast<ImpulseResponse*>(temp); temp += sizeof(ImpulseResponse);
-		m_convolverA = reinterpret_cast<Convolver*>(temp); temp += sizeof(Convolver);
+		// a reverb per wet output buffer, each with its own decay time
+		for (int i = 0; i < PV_DSP_WET_BUS_COUNT; ++i)
+		{
+			if (useCombs)
+			{
+				char* reverbMem = temp + AlignBlock(sizeof(Reverb));
+				m_reverbs[i] = new (temp) Reverb(decayTimes[i], (float)m_config.samplingRate, reverbMem);
+				temp = reverbMem + AlignBlock(Reverb::GetMemoryRequirement((float)m_config.samplingRate));
+			}
+			else if (useConvolution)
+			{
+				// every channel gets its own noise, so the reverb is wide
+				for (int c = 0; c < PV_DSP_CHANNEL_COUNT; ++c)
+				{
+					m_responses[i][c] = new (temp) ImpulseResponse(decayTimes[i], (float)m_config.samplingRate,
+						(unsigned)(i * PV_DSP_CHANNEL_COUNT + c));
+					temp += AlignBlock(sizeof(ImpulseResponse));
+				}
+				const unsigned responseLength = m_responses[i][0]->GetArraySize();
+				char* convolverMem = temp + AlignBlock(sizeof(Convolver));
 
-		m_emissions = new (m_emissions) EmissionsManager((float)m_config.samplingRate);
-		m_responseA = new (m_responseA) ImpulseResponse(PV_DSP_T_ER_1, (float)m_config.samplingRate);
-		m_convolverA = new (m_convolverA) Convolver(m_responseA);
+				// the buses' long blocks are spread evenly apart, so their work lands in different callbacks
+				const unsigned phase = (unsigned)i * PV_DSP_MAX_CONVOLUTION_BLOCK / PV_DSP_WET_BUS_COUNT;
+				m_convolvers[i] = new (temp) Convolver(m_responses[i], PV_DSP_CHANNEL_COUNT, phase, convolverMem);
+				temp = convolverMem + AlignBlock(Convolver::GetMemoryRequirement(responseLength, PV_DSP_CHANNEL_COUNT));
+			}
+		}
 
 		m_listenerTransform.position = { 0, 0, 0 };
 		m_listenerTransform.forward  = { 1, 0, 0 };
@@ -146,15 +277,28 @@ namespace PlaneverbDSP
 
 	Context::~Context()
 	{
-		m_convolverA->~Convolver();
-		m_responseA->~ImpulseResponse();
+		if (m_workers)
+			m_workers->~WorkerPool();
+
+		for (int i = 0; i < PV_DSP_WET_BUS_COUNT; ++i)
+		{
+			if (m_reverbs[i])
+				m_reverbs[i]->~Reverb();
+			if (m_convolvers[i])
+				m_convolvers[i]->~Convolver();
+			for (int c = 0; c < PV_DSP_CHANNEL_COUNT; ++c)
+			{
+				if (m_responses[i][c])
+					m_responses[i][c]->~ImpulseResponse();
+			}
+		}
 		m_emissions->~EmissionsManager();
 
 		// deallocate buffers
 		PV_DSP_SAFE_ARRAY_DELETE(m_mem);
 	}
 
-	// private functions to determine reverb lerp factors and source directivity
+	// private functions to determine reverb lerp factors and source directivity, 4 sources at a time
 	namespace
 	{
 		const constexpr float TSTAR = 0.1f;
@@ -162,270 +306,514 @@ namespace PlaneverbDSP
 		// gain = std::pow(10.f, -dryGain / 20.f);
 		// because gain is stored as a linear gain factor instead of in dB
 
-		PV_DSP_INLINE float FindGainA(float rt60, float dryGain)
+		// fewest sources worth handing a mixing thread
+		const constexpr unsigned MIN_SOURCES_PER_WORKER = 16;
+
+		// a batch being mixed by several workers
+		struct MixJob
 		{
-			if (rt60 > PV_DSP_T_ER_2)
+			Context* context;
+			unsigned count;			// sources in the batch
+			unsigned numFrames;
+			float lerpFactor;
+		};
+
+		// dst += src, count floats
+		PV_DSP_INLINE void AddBuffer(float* dst, const float* src, unsigned count)
+		{
+			unsigned i = 0;
+			for (; i + 4 <= count; i += 4)
 			{
-				return 0.f;
+				_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
 			}
-			else if (rt60 < PV_DSP_T_ER_1)
+			for (; i < count; ++i)
 			{
-				return 1.f;
+				dst[i] += src[i];
 			}
+		}
 
-			float gain = dryGain;
-			float term1 = std::pow(10.f, -3.f * TSTAR / PV_DSP_T_ER_2);
-			float term2 = std::pow(10.f, -3.f * TSTAR / rt60);
-			float term3 = std::pow(10.f, -3.f * TSTAR / PV_DSP_T_ER_1);
-			float a = gain * (term1 - term2) / (term1 - term3);
-			return a;
+		PV_DSP_INLINE __m128 Select(__m128 mask, __m128 a, __m128 b)
+		{
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
 		}
 
-		PV_DSP_INLINE float FindGainB(float rt60, float dryGain)
+		// values[slots[0]] to values[slots[3]]
+		PV_DSP_INLINE __m128 Gather(const float* values, const int* slots)
 		{
-			if (rt60 < PV_DSP_T_ER_1)
-			{
-				return 0.f;
-			}
+			return _mm_setr_ps(values[slots[0]], values[slots[1]], values[slots[2]], values[slots[3]]);
+		}
 
-			float gain = dryGain;
-			float term2 = std::pow(10.f, -3.f * TSTAR / rt60);
+		// 10^x as 2^i 2^f, i the nearest integer to x log2(10) and 2^f from its Taylor series.
+		// relative error is about 2e-7
+		PV_DSP_INLINE __m128 Exp10(__m128 x)
+		{
+			__m128 y = _mm_mul_ps(x, _mm_set1_ps(3.32192809f));
+			y = _mm_max_ps(_mm_min_ps(y, _mm_set1_ps(126.f)), _mm_set1_ps(-126.f));
+			const __m128i i = _mm_cvtps_epi32(y);
+			const __m128 f = _mm_sub_ps(y, _mm_cvtepi32_ps(i));
+
+			__m128 p = _mm_set1_ps(1.54035304e-4f);
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.33335581e-3f));
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(9.61812911e-3f));
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(5.55041087e-2f));
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(2.40226507e-1f));
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(6.93147181e-1f));
+			p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.f));
+			const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23));
+			return _mm_mul_ps(p, scale);
+		}
 
-			// case we want j + 1 instead of j
-			if (rt60 > PV_DSP_T_ER_2)
-			{
-				float term1 = std::pow(10.f, -3.f * TSTAR / PV_DSP_T_ER_3);
-				float term3 = std::pow(10.f, -3.f * TSTAR / PV_DSP_T_ER_2);
-				float a = gain * (term1 - term2) / (term1 - term3);
-				return a;
-			}
-			else
-			{
-				float term1 = std::pow(10.f, -3.f * TSTAR / PV_DSP_T_ER_2);
-				float term3 = std::pow(10.f, -3.f * TSTAR / PV_DSP_T_ER_1);
-				float a = gain * (term1 - term2) / (term1 - term3);
-				return gain - a;
-			}
+		// level a decay of rt60 seconds reaches after TSTAR
+		PV_DSP_INLINE __m128 DecayAfterTStar(__m128 rt60)
+		{
+			return Exp10(_mm_div_ps(_mm_set1_ps(-3.f * TSTAR), rt60));
 		}
 
-		PV_DSP_INLINE float FindGainC(float rt60, float dryGain)
+		// the wet gain is shared by the two reverbs whose decay times surround rt60.
+		// busDecays holds DecayAfterTStar of PV_DSP_T_ER_1, 2 and 3
+		PV_DSP_INLINE void FindWetGains(__m128 rt60, __m128 wetGain, const __m128* busDecays, __m128* gains)
 		{
-			if (rt60 > PV_DSP_T_ER_3)
-			{
-				return 1.f;
-			}
-			else if (rt60 < PV_DSP_T_ER_2)
-			{
-				return 0.f;
-			}
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 term2 = DecayAfterTStar(rt60);
+
+			// share of reverb A between decay times 1 and 2, share of reverb B between decay times 2 and 3
+			const __m128 lower = _mm_div_ps(_mm_mul_ps(wetGain, _mm_sub_ps(busDecays[1], term2)),
+				_mm_sub_ps(busDecays[1], busDecays[0]));
+			const __m128 upper = _mm_div_ps(_mm_mul_ps(wetGain, _mm_sub_ps(busDecays[2], term2)),
+				_mm_sub_ps(busDecays[2], busDecays[1]));
+
+			const __m128 belowER1 = _mm_cmplt_ps(rt60, _mm_set1_ps(PV_DSP_T_ER_1));
+			const __m128 belowER2 = _mm_cmplt_ps(rt60, _mm_set1_ps(PV_DSP_T_ER_2));
+			const __m128 aboveER2 = _mm_cmpgt_ps(rt60, _mm_set1_ps(PV_DSP_T_ER_2));
+			const __m128 aboveER3 = _mm_cmpgt_ps(rt60, _mm_set1_ps(PV_DSP_T_ER_3));
+			gains[0] = Select(aboveER2, zero, Select(belowER1, one, lower));
+			gains[1] = Select(belowER1, zero, Select(aboveER2, upper, _mm_sub_ps(wetGain, lower)));
+			gains[2] = Select(aboveER3, one, Select(belowER2, zero, _mm_sub_ps(wetGain, upper)));
+		}
 
-			float gain = dryGain;
-			float term1 = std::pow(10.f, -3.f * TSTAR / PV_DSP_T_ER_3);
-			float term2 = std::pow(10.f, -3.f * TSTAR / rt60);
-			float term3 = std::pow(10.f, -3.f * TSTAR / PV_DSP_T_ER_2);
-			float a = gain * (term1 - term2) / (term1 - term3);
-			return gain - a;
+		// constant power panning of theta = (listener angle - source angle) / 2 with the listener's half angle given
+		// as its cosine and sine. the half source angle comes from the half angle formulas, cosine and sine are each
+		// taken from the side that does not cancel, so no angle is ever computed
+		PV_DSP_INLINE void FindPanning(__m128 x, __m128 y, __m128 listenerCos, __m128 listenerSin,
+			__m128& left, __m128& right)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 signBit = _mm_set1_ps(-0.f);
+
+			// no direction has an angle of 0, like (1, 0)
+			const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+			const __m128 none = _mm_cmpeq_ps(length, zero);
+			const __m128 safeLength = Select(none, one, length);
+			x = Select(none, one, x);
+
+			// the source angle is within (-pi, pi], its half has a positive cosine and a sine signed like y
+			const __m128 cosine = _mm_div_ps(x, safeLength);
+			const __m128 front = _mm_cmpge_ps(x, zero);
+			const __m128 root = _mm_sqrt_ps(_mm_mul_ps(half, Select(front, _mm_add_ps(one, cosine), _mm_sub_ps(one, cosine))));
+			const __m128 other = _mm_div_ps(_mm_andnot_ps(signBit, y), _mm_mul_ps(_mm_add_ps(safeLength, safeLength), root));
+			const __m128 halfCos = Select(front, root, other);
+			const __m128 halfSin = _mm_or_ps(Select(front, other, root), _mm_and_ps(signBit, y));
+
+			const __m128 ct = _mm_add_ps(_mm_mul_ps(listenerCos, halfCos), _mm_mul_ps(listenerSin, halfSin));
+			const __m128 st = _mm_sub_ps(_mm_mul_ps(listenerSin, halfCos), _mm_mul_ps(listenerCos, halfSin));
+			left = _mm_mul_ps(_mm_set1_ps(PV_DSP_INV_SQRT_2), _mm_sub_ps(ct, st));
+			right = _mm_mul_ps(_mm_set1_ps(PV_DSP_INV_SQRT_2), _mm_add_ps(ct, st));
 		}
 
-		PV_DSP_INLINE float OmniPattern(const vec2& directivity, const vec2& forward)
+		// cardioid directivity, 1 where omni is set
+		PV_DSP_INLINE __m128 FindDirectivity(__m128 omni, __m128 directivityX, __m128 directivityY,
+			__m128 forwardX, __m128 forwardY)
 		{
-			return 1.f;
+			const __m128 dotValue = _mm_add_ps(_mm_mul_ps(directivityX, forwardX), _mm_mul_ps(directivityY, forwardY));
+			const __m128 cardioid = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(1.f), dotValue), _mm_set1_ps(0.5f));
+			return Select(omni, _mm_set1_ps(1.f), _mm_max_ps(cardioid, _mm_set1_ps(PV_DSP_MIN_DRY_GAIN)));
 		}
 
-		PV_DSP_INLINE float CardioidPattern(const vec2& directivity, const vec2& forward)
+		//TODO: These should be 3D attenuation value
+		PV_DSP_INLINE __m128 FindDistanceAttenuation(__m128 listenerX, __m128 listenerY, __m128 x, __m128 y)
 		{
-			float dotValue = directivity.Dot(forward);
-			float cardioid = (1.f + dotValue) / 2.f;
-			return (cardioid > PV_DSP_MIN_DRY_GAIN) ? cardioid : PV_DSP_MIN_DRY_GAIN;
+			const __m128 dx = _mm_sub_ps(listenerX, x);
+			const __m128 dy = _mm_sub_ps(listenerY, y);
+			const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+			return _mm_div_ps(_mm_set1_ps(1.f), _mm_max_ps(distance, _mm_set1_ps(1.f)));
 		}
 
-		using SourceDirectivityPatternFunc = float(*)(const vec2& directivity, const vec2& forward);
-		SourceDirectivityPatternFunc directivityPatternFuncs[pvd_SourceDirectivityPatternCount] = 
+		// gain ramps from target + offset to target, ramp is (1 - lerp factor)^frame
+		PV_DSP_INLINE __m128 RampGain(__m128 target, __m128 offset, __m128 ramp)
 		{
-			OmniPattern,
-			CardioidPattern
-		};
+			return _mm_add_ps(target, _mm_mul_ps(offset, ramp));
+		}
+
+		// adds 4 frames to an interleaved stereo buffer
+		PV_DSP_INLINE void AccumulateStereo(float* out, __m128 left, __m128 right)
+		{
+			_mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), _mm_unpacklo_ps(left, right)));
+			_mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_unpackhi_ps(left, right)));
+		}
 	} // namespace <>
 
 	void Context::SubmitSource(EmissionID id, const PlaneverbDSPInput* dspParams,
 		const float* in, unsigned numFrames)
+	{
+		SubmitSources(&id, dspParams, &in, 1, numFrames);
+	}
+
+	void Context::SubmitSources(const EmissionID* ids, const PlaneverbDSPInput* dspParams,
+		const float* const* in, unsigned numSources, unsigned numFrames)
 	{
 		m_numFrames = (int)numFrames > m_numFrames ? (int)numFrames : m_numFrames;
-		int numChannels = (int)PV_DSP_CHANNEL_COUNT;
-		int numSamples = numFrames * numChannels;
+		EmissionParameters& target = m_emissions->GetTarget();
+
+		// gather sources and set their targets
+		for (unsigned i = 0; i < numSources; ++i)
+		{
+			const PlaneverbDSPInput& params = dspParams[i];
+
+			// don't do anything if input is invalid
+			if (params.lowpass < PV_DSP_MIN_AUDIBLE_FREQ || params.lowpass > PV_DSP_MAX_AUDIBLE_FREQ ||
+				params.obstructionGain <= 0.f ||
+				(params.direction.x == 0.f && params.direction.y == 0.f))
+			{
+				continue;
+			}
 
-		// don't do anything if input is invalid
-		if(dspParams->lowpass < PV_DSP_MIN_AUDIBLE_FREQ || dspParams->lowpass > PV_DSP_MAX_AUDIBLE_FREQ ||
-			dspParams->obstructionGain <= 0.f ||
-			(dspParams->direction.x == 0.f && dspParams->direction.y == 0.f))
+			// find the emitter, handles of removed emitters are dropped
+			int slot = m_emissions->Find(ids[i]);
+			if (slot < 0)
+			{
+				continue;
+			}
+
+			// an emitter sent twice is mixed once per time, in order
+			if (m_slotBatches[slot] == m_batchNumber)
+			{
+				MixBatch(numFrames);
+			}
+			m_slotBatches[slot] = m_batchNumber;
+
+			m_emissions->GetFilter(slot).SetCutoff(params.lowpass);
+			target.occlusion[slot] = params.obstructionGain;
+			target.wetGain[slot] = params.wetGain;
+			target.rt60[slot] = params.rt60;
+			target.directionX[slot] = params.direction.x;
+			target.directionY[slot] = params.direction.y;
+			target.directivityX[slot] = params.sourceDirectivity.x;
+			target.directivityY[slot] = params.sourceDirectivity.y;
+
+			m_batch.slots[m_batch.count] = slot;
+			m_batch.inputs[m_batch.count] = in[i];
+			m_batch.cutoffs[m_batch.count] = params.lowpass;
+			++m_batch.count;
+		}
+
+		MixBatch(numFrames);
+	}
+
+	void Context::MixBatch(unsigned numFrames)
+	{
+		const unsigned count = m_batch.count;
+		if (count == 0)
 		{
 			return;
 		}
+		m_batch.count = 0;
+		m_batchNumber = (m_batchNumber == ~0u) ? 1 : m_batchNumber + 1;
+
+		EmissionParameters& target = m_emissions->GetTarget();
+		EmissionParameters& current = m_emissions->GetCurrent();
+
+		// determine lerp factor, each lerped value closes in on its target by the same ratio every frame
+		float lerpFactor = 1.f / ((float)m_numFrames * (float)m_config.dspSmoothingFactor);
+		if (lerpFactor != m_rampFactor)
+		{
+			double remaining = 1.0;
+			for (unsigned i = 0; i <= m_config.maxCallbackLength; ++i)
+			{
+				m_ramp[i] = (float)remaining;
+				remaining *= 1.0 - (double)lerpFactor;
+			}
+			m_rampFactor = lerpFactor;
+		}
 
 		/////////////////////////////
 		// Calculate all gains first
 
-		// determine lerp factor
-		float lerpFactor = 1.f / ((float)m_numFrames * (float)m_config.dspSmoothingFactor);
+		// fill the last SIMD vector with copies of the first source
+		for (unsigned i = count; (i & 3u) != 0; ++i)
+		{
+			m_batch.slots[i] = m_batch.slots[0];
+		}
 
-		// determine each reverb gain target
-		float revGainA = FindGainA(dspParams->rt60, dspParams->wetGain);
-		float revGainB = FindGainB(dspParams->rt60, dspParams->wetGain);
-		float revGainC = FindGainC(dspParams->rt60, dspParams->wetGain);
-
-		// get target and current emission data
-		auto& emissionData = m_emissions->GetDataTarget(id);
-		emissionData.lpf.SetCutoff(dspParams->lowpass);
-		emissionData.occlusion = dspParams->obstructionGain;
-		emissionData.wetGain = dspParams->wetGain;
-		emissionData.rt60 = dspParams->rt60;
-		emissionData.direction.x = dspParams->direction.x;
-		emissionData.direction.y = dspParams->direction.y;
-		emissionData.directivity.x = dspParams->sourceDirectivity.x;
-		emissionData.directivity.y = dspParams->sourceDirectivity.y;
-
-		auto& currentData = m_emissions->GetDataCurrent(id);
-		float currRevGainA = FindGainA(currentData.rt60, currentData.wetGain);
-		float currRevGainB = FindGainB(currentData.rt60, currentData.wetGain);
-		float currRevGainC = FindGainC(currentData.rt60, currentData.wetGain);
-		float currDryGain = currentData.occlusion;
-
-		// determine panning current and target values
-		float targetleft = 1.f, targetright = 1.f;
-		float currentleft = 1.f, currentright = 1.f;
-		if (m_config.useSpatialization)
-		{
-			vec2 dir = dspParams->direction;
-			float angle = std::atan2f(m_listenerTransform.forward.z, m_listenerTransform.forward.x);
-			float phi = std::atan2f(dir.y, dir.x);
-			float aphi = std::abs(phi);
-			float premapped = angle - phi;
-			float theta = premapped / 2.f;
-			float ct = std::cos(theta);
-			float st = std::sin(theta);
-			targetleft = PV_DSP_INV_SQRT_2 * (ct - st);
-			targetright = PV_DSP_INV_SQRT_2 * (ct + st);
-
-			dir = currentData.direction;
-			phi = std::atan2f(dir.y, dir.x);
-			aphi = std::abs(phi);
-			premapped = angle - phi;
-			theta = premapped / 2.f;
-			ct = std::cos(theta);
-			st = std::sin(theta);
-			currentleft = PV_DSP_INV_SQRT_2 * (ct - st);
-			currentright = PV_DSP_INV_SQRT_2 * (ct + st);
-		}
-
-		// figure out source directivity current and target values
-		PlaneverbDSPSourceDirectivityPattern pattern = currentData.directivityPattern;
-		float targetDirectivityGain = directivityPatternFuncs[pattern](emissionData.directivity, emissionData.forward);
-		float currentDirectivityGain = directivityPatternFuncs[pattern](currentData.directivity, emissionData.forward);
-
-		// figure out distance attenuation values
-		//TODO: These should be 3D attenuation value
-		vec2 dist = { m_listenerTransform.position.x - emissionData.position.x, m_listenerTransform.position.z - emissionData.position.y };
-		float euclideanDistance = std::sqrt(dist.x * dist.x + dist.y * dist.y);
-		euclideanDistance = (euclideanDistance < 1.f) ? 1.f : euclideanDistance;
-		float targetDistanceAttenuation = 1.f / euclideanDistance;
-
-		dist = { m_listenerTransform.position.x - currentData.position.x, m_listenerTransform.position.z - currentData.position.y };
-		euclideanDistance = std::sqrt(dist.x * dist.x + dist.y * dist.y);
-		euclideanDistance = (euclideanDistance < 1.f) ? 1.f : euclideanDistance;
-		float currentDistanceAttenuation = 1.f / euclideanDistance;
-		
-		float targetDryGain = std::max(emissionData.occlusion, PV_DSP_MIN_DRY_GAIN);
+		const __m128 busDecays[PV_DSP_WET_BUS_COUNT] =
+		{
+			DecayAfterTStar(_mm_set1_ps(PV_DSP_T_ER_1)),
+			DecayAfterTStar(_mm_set1_ps(PV_DSP_T_ER_2)),
+			DecayAfterTStar(_mm_set1_ps(PV_DSP_T_ER_3))
+		};
+		const float listenerAngle = std::atan2f(m_listenerTransform.forward.z, m_listenerTransform.forward.x);
+		const __m128 listenerCos = _mm_set1_ps(std::cos(listenerAngle / 2.f));
+		const __m128 listenerSin = _mm_set1_ps(std::sin(listenerAngle / 2.f));
+		const __m128 listenerX = _mm_set1_ps(m_listenerTransform.position.x);
+		const __m128 listenerY = _mm_set1_ps(m_listenerTransform.position.z);
+		const __m128 wetGainRatio = _mm_set1_ps(m_config.wetGainRatio);
+		const PlaneverbDSPSourceDirectivityPattern* patterns = &m_emissions->GetPattern(0);
+
+		for (unsigned i = 0; i < count; i += 4)
+		{
+			const int* slots = m_batch.slots + i;
+			__m128 targets[sg_Count];
+			__m128 currents[sg_Count];
+
+			// determine each reverb gain
+			FindWetGains(Gather(target.rt60, slots), Gather(target.wetGain, slots), busDecays, targets + sg_WetA);
+			FindWetGains(Gather(current.rt60, slots), Gather(current.wetGain, slots), busDecays, currents + sg_WetA);
+			for (int bus = sg_WetA; bus <= sg_WetC; ++bus)
+			{
+				targets[bus] = _mm_mul_ps(targets[bus], wetGainRatio);
+				currents[bus] = _mm_mul_ps(currents[bus], wetGainRatio);
+			}
+
+			// dry gain lerps to the occlusion, kept above PV_DSP_MIN_DRY_GAIN
+			targets[sg_Occlusion] = _mm_max_ps(Gather(target.occlusion, slots), _mm_set1_ps(PV_DSP_MIN_DRY_GAIN));
+			currents[sg_Occlusion] = Gather(current.occlusion, slots);
+
+			// source directivity toward the listener, both against the target forward vector
+			const __m128 omni = _mm_castsi128_ps(_mm_setr_epi32(
+				-(int)(patterns[slots[0]] == pvd_Omni), -(int)(patterns[slots[1]] == pvd_Omni),
+				-(int)(patterns[slots[2]] == pvd_Omni), -(int)(patterns[slots[3]] == pvd_Omni)));
+			const __m128 forwardX = Gather(target.forwardX, slots);
+			const __m128 forwardY = Gather(target.forwardY, slots);
+			targets[sg_Directivity] = FindDirectivity(omni,
+				Gather(target.directivityX, slots), Gather(target.directivityY, slots), forwardX, forwardY);
+			currents[sg_Directivity] = FindDirectivity(omni,
+				Gather(current.directivityX, slots), Gather(current.directivityY, slots), forwardX, forwardY);
+
+			// figure out distance attenuation values
+			targets[sg_Distance] = FindDistanceAttenuation(listenerX, listenerY,
+				Gather(target.positionX, slots), Gather(target.positionY, slots));
+			currents[sg_Distance] = FindDistanceAttenuation(listenerX, listenerY,
+				Gather(current.positionX, slots), Gather(current.positionY, slots));
+
+			// determine panning
+			if (m_config.useSpatialization)
+			{
+				FindPanning(Gather(target.directionX, slots), Gather(target.directionY, slots),
+					listenerCos, listenerSin, targets[sg_Left], targets[sg_Right]);
+				FindPanning(Gather(current.directionX, slots), Gather(current.directionY, slots),
+					listenerCos, listenerSin, currents[sg_Left], currents[sg_Right]);
+			}
+			else
+			{
+				targets[sg_Left] = targets[sg_Right] = currents[sg_Left] = currents[sg_Right] = _mm_set1_ps(1.f);
+			}
+
+			for (int gain = 0; gain < sg_Count; ++gain)
+			{
+				_mm_storeu_ps(m_batch.targets[gain] + i, targets[gain]);
+				_mm_storeu_ps(m_batch.offsets[gain] + i, _mm_sub_ps(currents[gain], targets[gain]));
+			}
+		}
 
 		////////////////////////////////////////
 		// Run all processing after calculation
 
-		// copy input into internal storage -> Sum to mono
-		float* inputStoragePtr = m_inputStorage;
-		const float* inputPtr = in;
-		for (int i = 0; i < numFrames; ++i)
+		// share the sources among the mixing threads when there are enough of them, every thread mixes into its
+		// own output buffers and GetOutput sums them up
+		unsigned workerCount = 1;
+		if (m_workers)
+		{
+			workerCount = std::min(m_workers->GetWorkerCount(), std::max(count / MIN_SOURCES_PER_WORKER, 1u));
+		}
+		if (workerCount > 1)
 		{
-			float left = *inputPtr++;
-			float right = *inputPtr++;
-			*inputStoragePtr++ = (left + right) * 0.5f;
+			MixJob job = { this, count, numFrames, lerpFactor };
+			m_workers->Run(MixShard, &job, workerCount);
+			m_workersUsed = std::max(m_workersUsed, workerCount);
+		}
+		else
+		{
+			MixSources(0, count, m_dryOutput, m_inputStorage, numFrames, lerpFactor);
 		}
-		inputStoragePtr = m_inputStorage;
 
-		// process lowpass on copy of input signal
-		emissionData.lpf.Process(m_inputStorage, 0, 1, numFrames, dspParams->lowpass, lerpFactor);
+		// lerp the real current data parameters to where m_numFrames lerps leave them
+		const float remaining = m_ramp[m_numFrames];
+		float* currentParameters[] =
+		{
+			current.directionX, current.directionY, current.wetGain, current.rt60, current.forwardX, current.forwardY,
+			current.directivityX, current.directivityY, current.positionX, current.positionY
+		};
+		const float* targetParameters[] =
+		{
+			target.directionX, target.directionY, target.wetGain, target.rt60, target.forwardX, target.forwardY,
+			target.directivityX, target.directivityY, target.positionX, target.positionY
+		};
+		for (unsigned i = 0; i < count; ++i)
+		{
+			const int slot = m_batch.slots[i];
+			const float targetOcclusion = m_batch.targets[sg_Occlusion][i];
+			current.occlusion[slot] = targetOcclusion + (current.occlusion[slot] - targetOcclusion) * remaining;
+			for (int j = 0; j < (int)(sizeof(currentParameters) / sizeof(float*)); ++j)
+			{
+				const float targetValue = targetParameters[j][slot];
+				currentParameters[j][slot] = targetValue + (currentParameters[j][slot] - targetValue) * remaining;
+			}
+		}
+	}
 
-		// apply wet gain
+	void Context::MixSources(unsigned first, unsigned last, float* output, float* mono, unsigned numFrames,
+		float lerpFactor)
+	{
+		// every source is mixed into a block of the output buffers before the next block
+		const unsigned busSize = m_bufferSize / sizeof(float);
+		for (unsigned start = 0; start < numFrames; start += PV_DSP_MIX_BLOCK)
 		{
-			const int NUM_TASKS = 3;
-			float* bufArray[NUM_TASKS] = {
-				m_wetOutputA,
-				m_wetOutputB,
-				m_wetOutputC
-			};
-			float targetGainArray[NUM_TASKS] = { revGainA, revGainB, revGainC };
-			float currentGainArray[NUM_TASKS] = { currRevGainA, currRevGainB, currRevGainC };
-			auto processFunc = [&](float* buf, const float* in, float targetRevGain, float currRevGain, int frames)
+			const unsigned frames = std::min(PV_DSP_MIX_BLOCK, numFrames - start);
+			const float* ramp = m_ramp + start;
+			float* dryOut = output + start * PV_DSP_CHANNEL_COUNT;
+			float* wetOut[PV_DSP_WET_BUS_COUNT];
+			for (int bus = 0; bus < PV_DSP_WET_BUS_COUNT; ++bus)
+			{
+				wetOut[bus] = dryOut + (bus + 1) * busSize;
+			}
+
+			for (unsigned i = first; i < last; ++i)
 			{
-				for (int j = 0; j < frames; ++j)
+				// copy input into internal storage -> Sum to mono, then lowpass it
+				const float* inputPtr = m_batch.inputs[i] + start * PV_DSP_CHANNEL_COUNT;
+				for (unsigned j = 0; j < frames; ++j)
 				{
-					*buf++ = *in * currRevGain * m_config.wetGainRatio;
-					*buf++ = *in * currRevGain * m_config.wetGainRatio;
-					++in;
-					currRevGain = LERP_FLOAT(currRevGain, targetRevGain, lerpFactor);
+					mono[j] = (inputPtr[2 * j] + inputPtr[2 * j + 1]) * 0.5f;
 				}
-			};
+				m_emissions->GetFilter(m_batch.slots[i]).Process(mono, 0, 1, (int)frames, m_batch.cutoffs[i], lerpFactor);
 
-			for (int i = 0; i < NUM_TASKS; ++i)
-			{
-				processFunc(bufArray[i], inputStoragePtr, targetGainArray[i], currentGainArray[i], numFrames);
+				__m128 targets[sg_Count];
+				__m128 offsets[sg_Count];
+				for (int gain = 0; gain < sg_Count; ++gain)
+				{
+					targets[gain] = _mm_set1_ps(m_batch.targets[gain][i]);
+					offsets[gain] = _mm_set1_ps(m_batch.offsets[gain][i]);
+				}
+
+				unsigned j = 0;
+				for (; j + 4 <= frames; j += 4)
+				{
+					const __m128 r = _mm_loadu_ps(ramp + j);
+					const __m128 x = _mm_loadu_ps(mono + j);
+
+					// wet gains, the same on both channels
+					for (int bus = 0; bus < PV_DSP_WET_BUS_COUNT; ++bus)
+					{
+						const __m128 wet = _mm_mul_ps(x, RampGain(targets[sg_WetA + bus], offsets[sg_WetA + bus], r));
+						AccumulateStereo(wetOut[bus] + 2 * j, wet, wet);
+					}
+
+					// dry gains and spatialization
+					__m128 dry = _mm_mul_ps(RampGain(targets[sg_Occlusion], offsets[sg_Occlusion], r),
+						RampGain(targets[sg_Directivity], offsets[sg_Directivity], r));
+					dry = _mm_mul_ps(x, _mm_mul_ps(dry, RampGain(targets[sg_Distance], offsets[sg_Distance], r)));
+					AccumulateStereo(dryOut + 2 * j,
+						_mm_mul_ps(dry, RampGain(targets[sg_Left], offsets[sg_Left], r)),
+						_mm_mul_ps(dry, RampGain(targets[sg_Right], offsets[sg_Right], r)));
+				}
+				for (; j < frames; ++j)
+				{
+					float gains[sg_Count];
+					for (int gain = 0; gain < sg_Count; ++gain)
+					{
+						gains[gain] = m_batch.targets[gain][i] + m_batch.offsets[gain][i] * ramp[j];
+					}
+					for (int bus = 0; bus < PV_DSP_WET_BUS_COUNT; ++bus)
+					{
+						const float wet = mono[j] * gains[sg_WetA + bus];
+						wetOut[bus][2 * j] += wet;
+						wetOut[bus][2 * j + 1] += wet;
+					}
+					const float dry = mono[j] * (gains[sg_Occlusion] * gains[sg_Directivity] * gains[sg_Distance]);
+					dryOut[2 * j] += dry * gains[sg_Left];
+					dryOut[2 * j + 1] += dry * gains[sg_Right];
+				}
 			}
 		}
+	}
 
-		// apply dry gains
-		for (int i = 0; i < m_numFrames; ++i)
+	void Context::MixShard(void* data, unsigned worker, unsigned workerCount)
+	{
+		const MixJob& job = *reinterpret_cast<const MixJob*>(data);
+		Context* context = job.context;
+		const unsigned first = job.count * worker / workerCount;
+		const unsigned last = job.count * (worker + 1) / workerCount;
+
+		// worker 0 is the calling thread, it mixes into the context's own buffers
+		float* output = context->m_dryOutput;
+		float* mono = context->m_inputStorage;
+		if (worker > 0)
 		{
-			float nextGain = currDryGain * currentDirectivityGain * currentDistanceAttenuation;
-			*inputStoragePtr++ *= nextGain;
-			
-			currDryGain = LERP_FLOAT(currDryGain, targetDryGain, lerpFactor);
-			currentDirectivityGain = LERP_FLOAT(currentDirectivityGain, targetDirectivityGain, lerpFactor);
-			currentDistanceAttenuation = LERP_FLOAT(currentDistanceAttenuation, targetDistanceAttenuation, lerpFactor);
+			output = context->m_workerOutputs + (size_t)(worker - 1) * context->m_workerStride;
+			mono = output + context->m_bufferSize * 4 / sizeof(float);
 		}
-		inputStoragePtr = m_inputStorage;
+		context->MixSources(first, last, output, mono, job.numFrames, job.lerpFactor);
+	}
 
-		// apply spatialization
-		float* dryPtr = m_dryOutput;
-		inputStoragePtr = m_inputStorage;
-		for (int i = 0; i < numFrames; ++i)
+	void Context::GetOutput(float** dryOut, float** outA, float** outB, float** outC)
+	{
+		// sum the mixing threads' output buffers into the context's in pairs, each level halving them,
+		// then clear them for the next callback
+		if (m_workersUsed > 1)
 		{
-			*dryPtr++ += *inputStoragePtr * currentleft;
-			*dryPtr++ += *inputStoragePtr * currentright;
-			currentright = LERP_FLOAT(currentright, targetright, lerpFactor);
-			currentleft = LERP_FLOAT(currentleft, targetleft, lerpFactor);
-			++inputStoragePtr;
+			float* outputs[PV_DSP_MAX_WORKER_THREADS + 1] = { m_dryOutput };
+			for (unsigned i = 1; i < m_workersUsed; ++i)
+			{
+				outputs[i] = m_workerOutputs + (size_t)(i - 1) * m_workerStride;
+			}
+
+			const unsigned busSize = m_bufferSize / sizeof(float);
+			const unsigned samples = (unsigned)m_numFrames * PV_DSP_CHANNEL_COUNT;
+			for (unsigned stride = 1; stride < m_workersUsed; stride *= 2)
+			{
+				for (unsigned i = 0; i + stride < m_workersUsed; i += 2 * stride)
+				{
+					for (int bus = 0; bus < 1 + PV_DSP_WET_BUS_COUNT; ++bus)
+					{
+						AddBuffer(outputs[i] + bus * busSize, outputs[i + stride] + bus * busSize, samples);
+					}
+				}
+			}
+
+			for (unsigned i = 1; i < m_workersUsed; ++i)
+			{
+				std::memset(outputs[i], 0, m_bufferSize * 4);
+			}
+			m_workersUsed = 1;
 		}
 
-		// lerp the real current data parameters
-		// this can probably be vectorized at some point
-		currentData.occlusion = currDryGain;
-		for (int j = 0; j < m_numFrames; ++j)
+		// finish the wet signals
+		if (m_config.useBuiltInReverb)
 		{
-			currentData.direction.x = LERP_FLOAT(currentData.direction.x, emissionData.direction.x, lerpFactor);
-			currentData.direction.y = LERP_FLOAT(currentData.direction.y, emissionData.direction.y, lerpFactor);
-			currentData.wetGain = LERP_FLOAT(currentData.wetGain, emissionData.wetGain, lerpFactor);
-			currentData.rt60 = LERP_FLOAT(currentData.rt60, emissionData.rt60, lerpFactor);
-			currentData.forward.x = LERP_FLOAT(currentData.forward.x, emissionData.forward.x, lerpFactor);
-			currentData.forward.y = LERP_FLOAT(currentData.forward.y, emissionData.forward.y, lerpFactor);
-			currentData.directivity.x = LERP_FLOAT(currentData.directivity.x, emissionData.directivity.x, lerpFactor);
-			currentData.directivity.y = LERP_FLOAT(currentData.directivity.y, emissionData.directivity.y, lerpFactor);
-			currentData.position.x = LERP_FLOAT(currentData.position.x, emissionData.position.x, lerpFactor);
-			currentData.position.y = LERP_FLOAT(currentData.position.y, emissionData.position.y, lerpFactor);
+			float* wetOutputs[PV_DSP_WET_BUS_COUNT] = { m_wetOutputA, m_wetOutputB, m_wetOutputC };
+			for (int i = 0; i < PV_DSP_WET_BUS_COUNT; ++i)
+			{
+				if (m_reverbs[i])
+				{
+					m_reverbs[i]->Process(wetOutputs[i], wetOutputs[i], m_numFrames);
+				}
+				else
+				{
+					// convolve the mono sum, the responses write back into the channels
+					float* wet = wetOutputs[i];
+					for (int j = 0; j < m_numFrames; ++j)
+						m_inputStorage[j] = (wet[2 * j] + wet[2 * j + 1]) * 0.5f;
+					float* channels[PV_DSP_CHANNEL_COUNT] = { wet, wet + 1 };
+					m_convolvers[i]->Process(m_inputStorage, channels, PV_DSP_CHANNEL_COUNT, (unsigned)m_numFrames);
+				}
+			}
 		}
 
-		currentData.lpf.SetCutoff(emissionData.lpf.GetCutoff());
-	}
+		// sources of this callback are done, slots freed before now can be reused
+		m_emissions->EndCallback();
 
-	void Context::GetOutput(float** dryOut, float** outA, float** outB, float** outC)
-	{
 		*dryOut = m_dryOutput;
 		*outA = m_wetOutputA;
 		*outB = m_wetOutputB;
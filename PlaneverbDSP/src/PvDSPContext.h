@@ -6,6 +6,31 @@ namespace PlaneverbDSP
 {
 	// Forward declares
 	class EmissionsManager;
+	class Reverb;
+	class ImpulseResponse;
+	class Convolver;
+	class WorkerPool;
+
+	// output buffers that feed a reverb, A, B and C
+	const constexpr int PV_DSP_WET_BUS_COUNT = 3;
+
+	// frames mixed per pass over a batch of sources, the output buffers of a pass stay in L1
+	const constexpr unsigned PV_DSP_MIX_BLOCK = 64;
+
+	// gains of a source that ramp from their current to their target values across a callback
+	enum SourceGain
+	{
+		sg_WetA,			// reverb sends
+		sg_WetB,
+		sg_WetC,
+		sg_Occlusion,		// dry gain, the product of occlusion, directivity and distance attenuation
+		sg_Directivity,
+		sg_Distance,
+		sg_Left,			// panning
+		sg_Right,
+
+		sg_Count
+	};
 	
 	// DSP context singleton 
 	class Context
@@ -19,6 +44,10 @@ namespace PlaneverbDSP
 		void SubmitSource(EmissionID id, const PlaneverbDSPInput* dspParams,
 			const float* in, unsigned numFrames);
 
+		// internal submit source buffers function, sources are gathered and mixed together
+		void SubmitSources(const EmissionID* ids, const PlaneverbDSPInput* dspParams,
+			const float* const* in, unsigned numSources, unsigned numFrames);
+
 		// retrieve output
 		void GetOutput(float** dryOut, float** outA, float** outB, float** outC);
 
@@ -28,6 +57,16 @@ namespace PlaneverbDSP
 		EmissionsManager* GetEmissionManager() { return m_emissions; }
 
 	private:
+		// computes the gains of the gathered sources and mixes them into the output buffers
+		void MixBatch(unsigned numFrames);
+
+		// mixes batch sources [first, last) into output, the dry buffer followed by wet buffers A, B and C.
+		// mono is scratch of a block of frames
+		void MixSources(unsigned first, unsigned last, float* output, float* mono, unsigned numFrames, float lerpFactor);
+
+		// WorkerPool job, each worker mixes a share of the batch into its own output buffers
+		static void MixShard(void* data, unsigned worker, unsigned workerCount);
+
 		PlaneverbDSPConfig m_config;			// copy of the user configuration
 		unsigned m_bufferSize;					// size in bytes of each buffer
 
@@ -64,9 +103,37 @@ namespace PlaneverbDSP
 		// emissions handle
 		EmissionsManager* m_emissions = nullptr;
 
-		// test convolution ptrs, non-functional
-		class ImpulseResponse* m_responseA;
-		class Convolver* m_convolverA;
+		// sources gathered by SubmitSources, at most one per emitter.
+		// arrays hold maxEmitters entries rounded up to whole SIMD vectors
+		struct
+		{
+			unsigned count;
+			int* slots;								// emitter slot of each source
+			const float** inputs;					// interleaved stereo input of each source
+			float* cutoffs;							// lowpass cutoff of each source
+			float* targets[sg_Count];				// gain at the end of the callback
+			float* offsets[sg_Count];				// gain at the start of the callback minus the target
+		} m_batch = {};
+		unsigned* m_slotBatches = nullptr;			// number of the batch each emitter slot was last gathered in
+		unsigned m_batchNumber = 1;
+
+		// (1 - lerp factor)^frame for frames 0 to maxCallbackLength, how far a lerped value still is from its target
+		float* m_ramp = nullptr;
+		float m_rampFactor = 0.f;					// lerp factor m_ramp was made for
+
+		// threads helping to mix, nullptr unless PlaneverbDSPConfig::mixingThreads is set
+		WorkerPool* m_workers = nullptr;
+		float* m_workerOutputs = nullptr;			// per thread output buffers like m_dryOutput's, then mono scratch
+		unsigned m_workerStride = 0;				// floats per thread in m_workerOutputs
+		unsigned m_workersUsed = 1;					// workers that mixed into their buffers this callback, the context's own included
+
+		// late reverb per wet output buffer, nullptr unless PlaneverbDSPConfig::useBuiltInReverb is set
+		Reverb* m_reverbs[PV_DSP_WET_BUS_COUNT] = {};
+
+		// convolution reverb per wet output buffer, a response per channel convolved with the buffer's mono sum.
+		// used instead of m_reverbs if PlaneverbDSPConfig::useConvolutionReverb is set
+		ImpulseResponse* m_responses[PV_DSP_WET_BUS_COUNT][PV_DSP_CHANNEL_COUNT] = {};
+		Convolver* m_convolvers[PV_DSP_WET_BUS_COUNT] = {};
 	};
 
 	// Context singleton getter
@@ -0,0 +1,142 @@
+#include "Threading\WorkerPool.h"
+#include <new>
+#include <chrono>
+#include <emmintrin.h>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>		// WaitOnAddress, WakeByAddressAll
+
+namespace PlaneverbDSP
+{
+	namespace
+	{
+		// spins before a waiting thread starts yielding its time slice
+		const constexpr unsigned SPINS_BEFORE_YIELD = 4096;
+
+		// time an idle worker keeps spinning before it parks, longer than the callback period of a 1024 frame stream
+		// at 48kHz so workers stay awake while a stream runs and sleep once it stops
+		const constexpr std::chrono::milliseconds SPIN_TIME_BEFORE_PARK(25);
+
+		// bits of the job word holding the worker count
+		const constexpr unsigned WORKER_BITS = 8;
+		const constexpr unsigned WORKER_MASK = (1u << WORKER_BITS) - 1;
+
+		// one step of a spin wait, pauses while the wait is short and yields once it gets long
+		PV_DSP_INLINE void SpinWait(unsigned& spins)
+		{
+			if (spins < SPINS_BEFORE_YIELD)
+			{
+				++spins;
+				_mm_pause();
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	} // namespace <>
+
+	WorkerPool::WorkerPool(unsigned threadCount, char* mem) :
+		m_threadCount(threadCount),
+		m_threads(reinterpret_cast<std::thread*>(mem)),
+		m_jobWord(0),
+		m_pending(0),
+		m_sleepers(0),
+		m_isRunning(true)
+	{
+		PV_DSP_ASSERT(threadCount <= PV_DSP_MAX_WORKER_THREADS);
+		for (unsigned i = 0; i < m_threadCount; ++i)
+		{
+			new (m_threads + i) std::thread(WorkerProcessor, this, i + 1);
+		}
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		// a new job word with no workers wakes the parked threads, they see the flag once they are up
+		m_isRunning.store(false, std::memory_order_release);
+		m_jobWord.store(((m_jobWord.load(std::memory_order_relaxed) >> WORKER_BITS) + 1) << WORKER_BITS);
+		WakeByAddressAll(&m_jobWord);
+		for (unsigned i = 0; i < m_threadCount; ++i)
+		{
+			if (m_threads[i].joinable())
+			{
+				m_threads[i].join();
+			}
+			m_threads[i].~thread();
+		}
+	}
+
+	size_t WorkerPool::GetMemoryRequirement(unsigned threadCount)
+	{
+		return sizeof(std::thread) * threadCount;
+	}
+
+	void WorkerPool::Run(Job job, void* data, unsigned workerCount)
+	{
+		PV_DSP_ASSERT(workerCount > 0 && workerCount <= GetWorkerCount());
+
+		// the job is in place before its word is. the last job's workers are all done, the ones sitting it out
+		// only ever read the word
+		m_job = job;
+		m_data = data;
+		m_pending.store(workerCount - 1, std::memory_order_relaxed);
+		const unsigned jobNumber = (m_jobWord.load(std::memory_order_relaxed) >> WORKER_BITS) + 1;
+		m_jobWord.store((jobNumber << WORKER_BITS) | workerCount);
+
+		// the word is stored before the sleepers are read and a worker counts itself before it parks, so either
+		// it sees the new word or it is counted here. WakeByAddressAll doesn't block
+		if (m_sleepers.load() > 0)
+		{
+			WakeByAddressAll(&m_jobWord);
+		}
+
+		job(data, 0, workerCount);
+
+		// barrier, the other workers' writes are visible once they have all arrived
+		unsigned spins = 0;
+		while (m_pending.load(std::memory_order_acquire) != 0)
+		{
+			SpinWait(spins);
+		}
+	}
+
+	void WorkerPool::WorkerProcessor(WorkerPool* pool, unsigned worker)
+	{
+		unsigned lastJob = 0;
+		while (true)
+		{
+			// wait for the next job, spinning at first and parked on the job word once the wait gets long
+			unsigned spins = 0;
+			unsigned jobWord;
+			const auto parkTime = std::chrono::steady_clock::now() + SPIN_TIME_BEFORE_PARK;
+			while ((jobWord = pool->m_jobWord.load(std::memory_order_acquire)) == lastJob)
+			{
+				if (!pool->m_isRunning.load(std::memory_order_acquire))
+				{
+					return;
+				}
+				if (spins < SPINS_BEFORE_YIELD || std::chrono::steady_clock::now() < parkTime)
+				{
+					SpinWait(spins);
+					continue;
+				}
+
+				// WaitOnAddress returns at once if the word has moved on since it was counted
+				pool->m_sleepers.fetch_add(1);
+				WaitOnAddress(&pool->m_jobWord, &lastJob, sizeof(lastJob), INFINITE);
+				pool->m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+			}
+			lastJob = jobWord;
+
+			// workers past the job's worker count sit it out
+			const unsigned workerCount = jobWord & WORKER_MASK;
+			if (worker < workerCount)
+			{
+				pool->m_job(pool->m_data, worker, workerCount);
+				pool->m_pending.fetch_sub(1, std::memory_order_release);
+			}
+		}
+	}
+} // namespace PlaneverbDSP
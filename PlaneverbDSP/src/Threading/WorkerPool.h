@@ -0,0 +1,50 @@
+#pragma once
+#include "PvDSPDefinitions.h"
+#include <thread>		// std::thread
+#include <atomic>		// std::atomic
+#include <cstddef>
+
+namespace PlaneverbDSP
+{
+	// most threads a pool runs
+	const constexpr unsigned PV_DSP_MAX_WORKER_THREADS = 254;
+
+	// Threads that run a job alongside the thread calling Run, for work that has to finish within an audio callback.
+	// the calling thread never blocks: Run spins until every worker has arrived and only wakes parked workers, so no
+	// mutex or kernel wait sits between the audio thread and its deadline. idle threads spin on the job word for a
+	// while and then park on it with WaitOnAddress
+	class WorkerPool
+	{
+	public:
+		// job of one worker, worker 0 is the thread calling Run
+		using Job = void(*)(void* data, unsigned worker, unsigned workerCount);
+
+		// starts threadCount threads, at most PV_DSP_MAX_WORKER_THREADS, mem holds GetMemoryRequirement(threadCount) bytes
+		WorkerPool(unsigned threadCount, char* mem);
+		~WorkerPool();
+
+		// runs job on workerCount workers and returns once all of them are done, workerCount is at most GetWorkerCount()
+		void Run(Job job, void* data, unsigned workerCount);
+
+		// threads plus the calling thread
+		PV_DSP_INLINE unsigned GetWorkerCount() const { return m_threadCount + 1; }
+
+		static size_t GetMemoryRequirement(unsigned threadCount);
+
+	private:
+		// waits for jobs until the pool is destroyed
+		static void WorkerProcessor(WorkerPool* pool, unsigned worker);
+
+		unsigned m_threadCount;
+		std::thread* m_threads;					// thread handles
+
+		// current job, published by m_jobWord
+		Job m_job = nullptr;
+		void* m_data = nullptr;
+
+		std::atomic<unsigned> m_jobWord;		// job number above the job's worker count in the low 8 bits, a new value starts a job
+		std::atomic<unsigned> m_pending;		// workers still running the job, the barrier Run spins on
+		std::atomic<unsigned> m_sleepers;		// workers parked on m_jobWord or about to, Run wakes them when nonzero
+		std::atomic<bool> m_isRunning;			// running flag used by threads
+	};
+} // namespace PlaneverbDSP
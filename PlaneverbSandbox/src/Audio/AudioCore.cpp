@@ -62,6 +62,8 @@ void AudioCore::StopAudio()
 	m_data.currentlyPlaying = false;
 	Planeverb::EndEmission(m_data.id);
 	m_data.id = Planeverb::PV_INVALID_EMISSION_ID;
+	PlaneverbDSP::RemoveEmitter(m_data.dspID);
+	m_data.dspID = PlaneverbDSP::PV_INVALID_EMISSION_ID;
 }
 
 Planeverb::EmissionID AudioCore::PlayAudio(const Planeverb::vec3& emitter)
@@ -69,6 +71,12 @@ Planeverb::EmissionID AudioCore::PlayAudio(const Planeverb::vec3& emitter)
 	m_data.currentlyPlaying = true;
 	m_data.readIndex = 0;
 	m_data.id = Planeverb::Emit(emitter);
+
+	// a DSP emitter per sound played, the last one is released first
+	PlaneverbDSP::RemoveEmitter(m_data.dspID);
+	m_data.dspID = PlaneverbDSP::AddEmitter();
+	PlaneverbDSP::UpdateEmitter(m_data.dspID, emitter.x, emitter.y, emitter.z, 1, 0, 0);
+	PlaneverbDSP::SetEmitterDirectivityPattern(m_data.dspID, PlaneverbDSP::pvd_Cardioid);
 	return m_data.id;
 }
 
@@ -165,7 +173,7 @@ void AudioCore::ProcessBlock(float * out, int frames)
 		}
 		
 		//std::memcpy(out, dataArray, samplesToCopy * sizeof(float));
-		PlaneverbDSP::SendSource(m_data.id, &dspInput, dataArray, samplesToCopy / CHANNELS);
+		PlaneverbDSP::SendSource(m_data.dspID, &dspInput, dataArray, samplesToCopy / CHANNELS);
 		//std::memset(out, 0, sizeof(float) * samples);
 		float* dry = nullptr;
 		float* obA = nullptr;
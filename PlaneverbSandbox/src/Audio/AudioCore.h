@@ -4,6 +4,7 @@
 #include "Util.h"
 #include <portaudio.h>
 #include <Planeverb.h>
+#include <PlaneverbDSP.h>
 
 struct AudioData;
 
@@ -15,6 +16,7 @@ struct PlayingData
 	int readIndex = 0;
 	AudioData* dataPlaying = nullptr;
 	Planeverb::EmissionID id = Planeverb::PV_INVALID_EMISSION_ID;
+	PlaneverbDSP::EmissionID dspID = PlaneverbDSP::PV_INVALID_EMISSION_ID;
 };
 
 float gainToDB(float gain);
@@ -30,6 +32,9 @@ public:
 	void StopAudio();
 	Planeverb::EmissionID PlayAudio(const Planeverb::vec3& emitter);
 
+	// DSP emitter of the playing sound, PlaneverbDSP::PV_INVALID_EMISSION_ID when stopped
+	PlaneverbDSP::EmissionID GetDSPEmitter() const { return m_data.dspID; }
+
 	float& GetVolume();
 	void SetVolume(float gain);
 
@@ -38,14 +38,11 @@ void Editor::Init(GLFWwindow * window)
 	Planeverb::SetListenerPosition(m_listener);
 	PlaneverbDSP::SetListenerTransform(m_listener.x, m_listener.y, m_listener.z,
 		0, 0, 1);
-	PlaneverbDSP::UpdateEmitter(m_emitterID, m_emitter.x, m_emitter.y, m_emitter.z, 1, 0, 0);
-	PlaneverbDSP::SetEmitterDirectivityPattern(m_emitterID, PlaneverbDSP::pvd_Cardioid);
 	using namespace std::chrono_literals;
 	std::this_thread::sleep_for(100ms);
-	auto pair = Planeverb::GetImpulseResponse(m_listener);
-	m_impulseResponseLength = pair.second;
+	m_impulseResponseLength = Planeverb::GetImpulseResponse(m_listener, nullptr, 0);
 	m_impulseResponseCopy.resize(m_impulseResponseLength);
-	std::memcpy(&m_impulseResponseCopy.front(), pair.first, sizeof(Planeverb::Cell) * m_impulseResponseLength);
+	Planeverb::GetImpulseResponse(m_listener, m_impulseResponseCopy.data(), m_impulseResponseLength);
 }
 
 void Editor::Update()
@@ -454,10 +451,9 @@ void Editor::ShowIRWindow()
 	if (ImGui::Begin("Impulse Response", &m_windowFlags.IRWindow))
 	{
         ImGui::SetWindowFontScale(2.0f);
-		std::pair<const Planeverb::Cell*, unsigned> IR = Planeverb::GetImpulseResponse(m_emitter);
-		std::memcpy(&m_impulseResponseCopy.front(), IR.first, sizeof(Planeverb::Cell) * m_impulseResponseLength);
+		const unsigned length = Planeverb::GetImpulseResponse(m_emitter, m_impulseResponseCopy.data(), m_impulseResponseLength);
 
-		if (IR.second != m_impulseResponseLength)
+		if (length != m_impulseResponseLength)
 		{
 			ImGui::Text("Something went wrong with the IR length");
 			ImGui::End();
@@ -637,8 +633,9 @@ void Editor::DisplayEmitterAndListener(ImDrawList * drawList, const ImVec2 & off
 		m_emitter.x += delta.x / GRID_TO_WORLD_SCALE;
 		m_emitter.z += delta.y / GRID_TO_WORLD_SCALE;
 		Planeverb::UpdateEmission(m_emitterID, m_emitter);
-		PlaneverbDSP::UpdateEmitter(m_emitterID, m_emitter.x, m_emitter.y, m_emitter.z, 1, 0, 0);
-		PlaneverbDSP::SetEmitterDirectivityPattern(m_emitterID, PlaneverbDSP::pvd_Cardioid);
+		PlaneverbDSP::EmissionID dspEmitter = AudioCore::Instance().GetDSPEmitter();
+		PlaneverbDSP::UpdateEmitter(dspEmitter, m_emitter.x, m_emitter.y, m_emitter.z, 1, 0, 0);
+		PlaneverbDSP::SetEmitterDirectivityPattern(dspEmitter, PlaneverbDSP::pvd_Cardioid);
 	}
 
 	if (m_emitterID != Planeverb::PV_INVALID_EMISSION_ID)
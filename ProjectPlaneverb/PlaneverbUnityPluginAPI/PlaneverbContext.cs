@@ -42,6 +42,12 @@ namespace Planeverb
 		[DllImport(DLLNAME)]
 		private static extern PlaneverbOutput PlaneverbGetOutput(int emissionID);
 
+		[DllImport(DLLNAME)]
+		private static extern void PlaneverbGetOutputs(int[] emissionIDs, [Out] PlaneverbOutput[] outputs, int count);
+
+		[DllImport(DLLNAME)]
+		private static extern void PlaneverbQueryPositions(Vector3[] positions, [Out] PlaneverbOutput[] outputs, int count);
+
 		[DllImport(DLLNAME)]
 		private static extern int PlaneverbAddGeometry(float posX, float posY,
 		float width, float height,
@@ -129,6 +135,18 @@ namespace Planeverb
 		{
 			return PlaneverbGetOutput(emissionID);
 		}
+
+		// outputs must be at least as long as emissionIDs
+		public static void GetOutputs(int[] emissionIDs, PlaneverbOutput[] outputs)
+		{
+			PlaneverbGetOutputs(emissionIDs, outputs, emissionIDs.Length);
+		}
+
+		// outputs must be at least as long as positions
+		public static void QueryPositions(Vector3[] positions, PlaneverbOutput[] outputs)
+		{
+			PlaneverbQueryPositions(positions, outputs, positions.Length);
+		}
 		#endregion
 	}
 }
\ No newline at end of file
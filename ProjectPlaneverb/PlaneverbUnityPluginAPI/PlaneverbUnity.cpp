@@ -102,6 +102,60 @@ extern "C"
 		return output;
 	}
 
+	// batch exports convert through per-thread buffers that only grow, so one call is still one snapshot.
+	// Unity ids are ints and its output struct is float only
+	extern "C++" {
+		static thread_local std::vector<Planeverb::EmissionID> s_batchIDs;
+		static thread_local std::vector<Planeverb::PlaneverbOutput> s_batchOutputs;
+
+		static void ConvertOutputs(const Planeverb::PlaneverbOutput* in, PlaneverbOutput* out, int count)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				out[i].occlusion = in[i].occlusion;
+				out[i].wetGain = in[i].wetGain;
+				out[i].rt60 = in[i].rt60;
+				out[i].lowpass = in[i].lowpass;
+				out[i].directionX = in[i].direction.x;
+				out[i].directionY = in[i].direction.y;
+				out[i].sourceDirectionX = in[i].sourceDirectivity.x;
+				out[i].sourceDirectionY = in[i].sourceDirectivity.y;
+			}
+		}
+	}
+
+	PVU_EXPORT void PVU_CC
+	PlaneverbGetOutputs(const int* emissionIDs, PlaneverbOutput* out, int count)
+	{
+		if (count <= 0)
+			return;
+
+		if (s_batchIDs.size() < (size_t)count)
+			s_batchIDs.resize(count);
+		if (s_batchOutputs.size() < (size_t)count)
+			s_batchOutputs.resize(count);
+
+		for (int i = 0; i < count; ++i)
+			s_batchIDs[i] = (Planeverb::EmissionID)emissionIDs[i];
+
+		Planeverb::GetOutputs(s_batchIDs.data(), s_batchOutputs.data(), (size_t)count);
+		ConvertOutputs(s_batchOutputs.data(), out, count);
+	}
+
+	// positions are tightly packed x, y, z floats, which matches an array of Unity Vector3
+	PVU_EXPORT void PVU_CC
+	PlaneverbQueryPositions(const float* positions, PlaneverbOutput* out, int count)
+	{
+		if (count <= 0)
+			return;
+
+		if (s_batchOutputs.size() < (size_t)count)
+			s_batchOutputs.resize(count);
+
+		Planeverb::QueryPositions(reinterpret_cast<const Planeverb::vec3*>(positions), s_batchOutputs.data(), (size_t)count);
+		ConvertOutputs(s_batchOutputs.data(), out, count);
+	}
+
 	PVU_EXPORT int PVU_CC
 	PlaneverbAddGeometry(float posX, float posY,
 		float width, float height, 
@@ -171,10 +225,14 @@ extern "C"
 		if (gridPos.x > gridSize.x || gridPos.y > gridSize.y)
 			return 0;
 
+		// responses aren't stored in streaming analysis mode
 		const int n = grid->GetResponseSize();
-		const auto data = grid->GetResponse(gridPos);
+		std::vector<Planeverb::Cell> response(n);
+		if (!grid->GetResponse(gridPos, 0, response.data()))
+			return 0;
+
 		for (int i = 0; i < n; ++i) {
-			out[i] = data[i].pr;
+			out[i] = response[i].pr;
 		}
 		return n;
 	}
@@ -250,6 +308,9 @@ extern "C"
 		if (gridId >= 0 && gridId < s_userGrids.size() && s_userGrids[gridId]) {
 
 			auto const& grid = s_userGrids[gridId];
+			if (grid->GetAnalysisMode() != Planeverb::pv_StoredResponseAnalysis)
+				return;
+
 			//grid->GenerateResponseCPU(Planeverb::vec3{ listenerX, 0, listenerZ });
 			PlaneverbGenerateGridResponse(gridId, listenerX, listenerZ);
 
@@ -259,13 +320,9 @@ extern "C"
 			const unsigned ySize = dim.y ;
 			const unsigned zSize = grid->GetResponseSize();
 
+			// out is [x][y][t], which is how a row of responses is gathered
 			for(unsigned x = 0; x < xSize; ++x) {
-				for(unsigned y = 0; y < ySize; ++y) {
-					const auto data = grid->GetResponse(Planeverb::vec2i{ x, y });
-					for (unsigned k = 0; k < zSize; ++k) {
-						out[x * (ySize * zSize) + y * zSize + k] = data[k];
-					}
-				}
+				grid->GatherResponses(0, x * ySize, ySize, out + (size_t)x * ySize * zSize);
 			}
 		}
 	}
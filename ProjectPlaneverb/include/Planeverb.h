@@ -28,8 +28,16 @@ namespace Planeverb
 	// Stop tracking a sound that's finished playing
 	PV_API void EndEmission(EmissionID id);
 
-	// Retrieve acoustic output for a given emitter
-	PV_API PlaneverbOutput GetOutput(EmissionID emitter);
+	// Retrieve acoustic output for a given emitter as heard by a listener (see PlaneverbConfig::listenerCount)
+	PV_API PlaneverbOutput GetOutput(EmissionID emitter, unsigned listener = 0);
+
+	// Retrieve acoustic output for many emitters at once, out must hold count outputs.
+	// All outputs come from the same analysis
+	PV_API void GetOutputs(const EmissionID* emitters, PlaneverbOutput* out, size_t count, unsigned listener = 0);
+
+	// Retrieve acoustic output for arbitrary world positions, out must hold count outputs.
+	// All outputs come from the same analysis
+	PV_API void QueryPositions(const vec3* positions, PlaneverbOutput* out, size_t count, unsigned listener = 0);
 
 	// Add a new piece of geometry to the scene
 	PV_API PlaneObjectID AddGeometry(const AABB* transform);
@@ -43,7 +51,20 @@ namespace Planeverb
 	// Updates listener
 	PV_API void SetListenerPosition(const vec3& listenerPosition);
 
-	// Retrieves an Impulse Response for debugging purposes.
-	PV_API std::pair<const Cell*, unsigned> GetImpulseResponse(const vec3& position);
+	// Updates one of several listeners, ignored if listener is not below PlaneverbConfig::listenerCount
+	PV_API void SetListenerPosition(unsigned listener, const vec3& listenerPosition);
+
+	// Counters of the background updates, how many were cancelled and the work they wasted. All 0 with baked probes
+	PV_API PlaneverbUpdateStats GetUpdateStats();
+
+	// Bakes outputs offline for listener probes on a lattice over static geometry (see PlaneverbBakeConfig)
+	// and writes them to a probe file for PlaneverbConfig::bakedProbeFile. Runs on the calling thread and doesn't need Init
+	// Can throw pv_InvalidConfig or pv_NotEnoughMemory, returns false if the file couldn't be written
+	PV_API bool BakeProbes(const PlaneverbConfig* config, const PlaneverbBakeConfig* bakeConfig,
+		const AABB* geometry, size_t geometryCount, const char* filePath);
+
+	// Copies the Impulse Response at position into out for debugging purposes, if maxLength cells hold all of it.
+	// Returns the response length, 0 if responses aren't stored. Call with maxLength 0 to size out
+	PV_API unsigned GetImpulseResponse(const vec3& position, Cell* out, unsigned maxLength, unsigned listener = 0);
 	
 } // namespace Planeverb
@@ -33,6 +33,13 @@
 #define PRINT_PROFILE_SECTION false
 #define PRINT_GRID false
 
+// Per-cell analyzer debug values (EDry/EFree), recorded in debug builds only
+#ifdef _DEBUG
+#define PV_ANALYZER_DEBUG_VALUES true
+#else
+#define PV_ANALYZER_DEBUG_VALUES false
+#endif
+
 #if PRINT_PROFILE
 #define PROFILE_TIME(line, tag)	\
 	std::cout << tag << ": ";	\
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "PvMathTypes.h"
+#include <cstddef>	// size_t
 
 namespace Planeverb
 {
@@ -35,6 +36,30 @@ namespace Planeverb
 		pv_ReflectingBoundary,	// walls of the grid reflect acoustic energy - !!! Not supported !!!
 	};
 
+	enum PlaneverbAnalysisMode
+	{
+		pv_StoredResponseAnalysis,	// store every impulse response, then analyze them. required by GetImpulseResponse
+		pv_StreamingAnalysis,		// analyze while simulating, impulse responses are never stored
+	};
+
+	enum PlaneverbResponseChannels
+	{
+		pv_ResponsePressureVelocity,	// store pressure and particle velocity, required for source directivity
+		pv_ResponsePressureOnly,		// store pressure only, source directivity is reported as zero
+	};
+
+	enum PlaneverbOutputInterpolation
+	{
+		pv_NearestCell,				// output of the grid cell the emitter is in
+		pv_BilinearInterpolation,	// blend of the four surrounding cells, cells the pulse never reached (walls) are left out
+	};
+
+	enum PlaneverbSimulationLength
+	{
+		pv_FixedSimulationLength,		// always simulate the whole response length
+		pv_AdaptiveSimulationLength,	// stop once the field energy has decayed below the audible threshold
+	};
+
 	struct PlaneverbConfig
 	{
 		// grid size in meters
@@ -55,10 +80,87 @@ namespace Planeverb
 		unsigned maxThreadUsage = 0; // can specify number of threads, 0 means as many as possible, minimum 2 otherwise
 		PlaneverbExecutionType threadExecutionType = pv_CPU; // CPU or GPU
 
+		// how impulse responses are analyzed
+		// streaming analysis uses memory proportional to the grid size instead of grid size times response length
+		PlaneverbAnalysisMode analysisMode = pv_StoredResponseAnalysis;
+
+		// fields kept per sample when impulse responses are stored
+		// pressure only uses a third of the memory of pressure and velocity
+		PlaneverbResponseChannels responseChannels = pv_ResponsePressureVelocity;
+
+		// how outputs are looked up between grid cells
+		// interpolation removes the steps in the output as emitters move, so less DSP smoothing is needed
+		PlaneverbOutputInterpolation outputInterpolation = pv_NearestCell;
+
+		// seconds simulated per impulse response, 0 uses PV_IMPULSE_RESPONSE_S
+		Real responseLengthInSeconds = 0.f;
+
+		// adaptive simulations stop early once the total field energy is adaptiveDecayThresholdDB below its peak,
+		// but never before the analysis windows have reached the farthest corner of the grid.
+		// the analysis then only uses the simulated part of each response
+		PlaneverbSimulationLength simulationLength = pv_FixedSimulationLength;
+
+		// energy decay in dB (negative) that ends an adaptive simulation, 0 uses PV_AUDIBLE_THRESHOLD_GAIN
+		Real adaptiveDecayThresholdDB = 0.f;
+
+		// listeners simulated together in one pass over the grid, 1 to PV_MAX_LISTENERS.
+		// every listener has its own fields, responses and results, the geometry is shared.
+		// costs memory per listener, but far less time than simulating them one after another
+		unsigned listenerCount = 1;
+
+		// the background thread sleeps until a listener moves further than listenerUpdateDistance (meters) from
+		// where it was last picked up, geometry changes, or its results are maxStalenessInSeconds old.
+		// a distance of 0 wakes it on any move, a staleness of 0 never wakes it for smaller moves
+		Real listenerUpdateDistance = 0.f;
+		Real maxStalenessInSeconds = 1.f;
+
+		// background updates started per second at most while the scene keeps changing, 0 means no limit
+		Real targetUpdateRate = 0.f;
+
+		// largest share of time the background thread spends updating, in (0, 1].
+		// after each update it rests in proportion to how long the update took
+		Real maxCpuDutyCycle = 1.f;
+
+		// a listener moving further than listenerCancelDistance (meters) from the position being simulated, or a geometry
+		// change if cancelOnGeometryChange is set, stops the update in flight and starts the next one at once.
+		// a distance of 0 never cancels for moves. an update that follows a cancelled one always runs to the end,
+		// so results keep coming while the scene changes faster than updates finish (see GetUpdateStats)
+		Real listenerCancelDistance = 2.f;
+		bool cancelOnGeometryChange = true;
+
+		// probe file written by BakeProbes, nullptr to simulate at runtime.
+		// when set, outputs are interpolated from the baked probes around each listener and nothing is simulated,
+		// so geometry changes are ignored. the grid is the one the probes were baked on, memoryBudget doesn't apply
+		const char* bakedProbeFile = nullptr;
+
+		// bytes of baked probe data kept mapped at most, 0 means no limit.
+		// the file is paged in around the listeners and ahead of them as they move, the least recently used
+		// parts are dropped once this is exceeded, so memory doesn't grow with the size of the level
+		size_t bakedProbeCacheSize = 64 * 1024 * 1024;
+
+		// upper bound in bytes on the memory allocated by Init, 0 means no limit
+		// when the config doesn't fit, Init falls back to pressure only responses, then the shortest
+		// response length, then coarser resolutions. throws pv_NotEnoughMemory only if none of those fit
+		size_t memoryBudget = 0;
+
 		// grid world offset - !!! Not supported !!!
 		vec2 gridWorldOffset = { 0.f, 0.f };
 	};
 
+	// Offline probe baking settings, see BakeProbes
+	struct PlaneverbBakeConfig
+	{
+		// distance between listener probes, rounded to whole grid cells.
+		// baked files grow with the number of probes times the number of grid cells
+		Real probeSpacingInMeters = 1.f;
+
+		// probes per side of a file chunk, a chunk is the unit read from the file at runtime
+		unsigned chunkSizeInProbes = 4;
+
+		// probes simulated together in one pass, 1 to PV_MAX_LISTENERS (see PlaneverbConfig::listenerCount)
+		unsigned probesPerPass = 4;
+	};
+
 	// Final acoustic output for an emitter
 	struct PlaneverbOutput
 	{
@@ -68,6 +170,16 @@ namespace Planeverb
 		Real lowpass;
 		vec2 direction;
 		vec2 sourceDirectivity;
+		unsigned epoch;		// analysis that produced these values, counts up from 1. 0 before the first analysis
+	};
+
+	// Background update counters since Init, see GetUpdateStats
+	struct PlaneverbUpdateStats
+	{
+		size_t completedUpdates;	// updates whose results were published
+		size_t cancelledUpdates;	// updates stopped for a newer listener position or geometry
+		size_t wastedSteps;			// time steps the cancelled updates simulated
+		Real wastedSeconds;			// time spent in cancelled updates
 	};
 
 	// ID typedefs
@@ -78,6 +190,7 @@ namespace Planeverb
 	const constexpr PlaneObjectID PV_INVALID_PLANE_OBJECT_ID = (PlaneObjectID)(-1);
 	const constexpr EmissionID PV_INVALID_EMISSION_ID = (EmissionID)(-1);
 	const constexpr Real PV_INVALID_DRY_GAIN = (Real)-1.f;
+	const constexpr unsigned PV_MAX_LISTENERS = 8;		// most listeners simulated together
 
 	// Internal constants
 	const constexpr Real PV_PI = (Real)3.141593f;						// PI
@@ -100,6 +213,7 @@ namespace Planeverb
 	const constexpr Real PV_DELAY_CLOSE_THRESHOLD = (Real)5.f;			// "close enough" delay threshold when analyzing for direction
 	const constexpr Real PV_IMPULSE_RESPONSE_S = PV_SQRT_2 * Real(12.5) / PV_C + Real(0.25);			// number of seconds to collect per impulse response
 	//                                                             ^ should be half of the scene width
+	const constexpr Real PV_MIN_IMPULSE_RESPONSE_S = PV_SQRT_2 * Real(12.5) / PV_C + Real(0.125);	// shortest response picked when fitting a memory budget
 
 	// struct to represent grid cells
 	// 16 bytes
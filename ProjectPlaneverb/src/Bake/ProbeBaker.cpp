@@ -0,0 +1,285 @@
+#include <Bake\ProbeBaker.h>
+#include <Bake\ProbeFormat.h>
+#include <FDTD\Grid.h>
+#include <FDTD\FreeGrid.h>
+#include <DSP\Analyzer.h>
+#include <Planeverb.h>
+#include <PvDefinitions.h>
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <limits>
+
+namespace Planeverb
+{
+	#pragma region ClientInterface
+	bool BakeProbes(const PlaneverbConfig* config, const PlaneverbBakeConfig* bakeConfig,
+		const AABB* geometry, size_t geometryCount, const char* filePath)
+	{
+		if (filePath == nullptr || (geometry == nullptr && geometryCount != 0))
+		{
+			throw pv_InvalidConfig;
+		}
+
+		ProbeBaker baker(config, bakeConfig);
+		for (size_t i = 0; i < geometryCount; ++i)
+		{
+			baker.AddGeometry(geometry + i);
+		}
+		return baker.Bake(filePath);
+	}
+	#pragma endregion
+
+	namespace
+	{
+		// writes zeros up to the next chunk boundary
+		void PadToChunkAlignment(std::ofstream& file, uint64_t& offset)
+		{
+			static const char zeros[PV_PROBE_CHUNK_ALIGNMENT] = {};
+			const uint64_t padding = (PV_PROBE_CHUNK_ALIGNMENT - offset % PV_PROBE_CHUNK_ALIGNMENT) % PV_PROBE_CHUNK_ALIGNMENT;
+			file.write(zeros, (std::streamsize)padding);
+			offset += padding;
+		}
+	} // namespace <>
+
+	ProbeBaker::ProbeBaker(const PlaneverbConfig* config, const PlaneverbBakeConfig* bakeConfig) :
+		m_mem(nullptr), m_grid(nullptr), m_freeGrid(nullptr), m_analyzers()
+	{
+		// throw if input is invalid
+		if (config == nullptr || bakeConfig == nullptr ||
+			config->gridResolution < pv_LowResolution ||
+			config->gridSizeInMeters.x == 0 || config->gridSizeInMeters.y == 0 ||
+			config->responseLengthInSeconds < (Real)0.f ||
+			config->adaptiveDecayThresholdDB > (Real)0.f ||
+			!(bakeConfig->probeSpacingInMeters > (Real)0.f) ||
+			bakeConfig->chunkSizeInProbes == 0 ||
+			bakeConfig->probesPerPass == 0 || bakeConfig->probesPerPass > PV_MAX_LISTENERS)
+		{
+			throw pv_InvalidConfig;
+		}
+
+		// every probe of a pass is a listener of the grid
+		std::memcpy(&m_config, config, sizeof(PlaneverbConfig));
+		m_config.listenerCount = bakeConfig->probesPerPass;
+		m_config.bakedProbeFile = nullptr;
+		m_bakeConfig = *bakeConfig;
+		config = &m_config;
+
+		// determine size for the pool, throw if operator new fails
+		size_t systemSize = sizeof(Grid) + sizeof(FreeGrid) + sizeof(Analyzer) * config->listenerCount;
+		size_t internalSize = Grid::GetMemoryRequirement(config) +
+			FreeGrid::GetMemoryRequirement(config) +
+			Analyzer::GetMemoryRequirement(config) * config->listenerCount;
+		size_t size = systemSize + internalSize;
+		m_mem = new char[size];
+		if (m_mem == nullptr)
+		{
+			throw pv_NotEnoughMemory;
+		}
+		std::memset(m_mem, 0, size);
+
+		char* tempSysMem = m_mem;
+		char* tempPoolMem = m_mem + systemSize;
+
+		// placement new construct the systems, same order as the context
+		m_grid = new (tempSysMem) Grid(config, tempPoolMem);
+		tempSysMem += sizeof(Grid);
+		tempPoolMem += Grid::GetMemoryRequirement(config);
+
+		m_freeGrid = new (tempSysMem) FreeGrid(config, tempPoolMem);
+		tempSysMem += sizeof(FreeGrid);
+		tempPoolMem += FreeGrid::GetMemoryRequirement(config);
+
+		for (unsigned i = 0; i < config->listenerCount; ++i)
+		{
+			m_analyzers[i] = new (tempSysMem) Analyzer(m_grid, m_freeGrid, tempPoolMem, i);
+			tempSysMem += sizeof(Analyzer);
+			tempPoolMem += Analyzer::GetMemoryRequirement(config);
+		}
+	}
+
+	ProbeBaker::~ProbeBaker()
+	{
+		// call dtor on all systems in reverse order
+		for (unsigned i = m_config.listenerCount; i > 0; --i)
+			m_analyzers[i - 1]->~Analyzer();
+		m_freeGrid->~FreeGrid();
+		m_grid->~Grid();
+
+		delete[] m_mem;
+	}
+
+	void ProbeBaker::AddGeometry(const AABB* transform)
+	{
+		m_grid->AddAABB(transform);
+	}
+
+	// quantizes the published results of an analyzer, cells the pulse never reached are left without data
+	void ProbeBaker::QuantizeProbe(const Analyzer* analyzer, ProbeCell* out) const
+	{
+		const vec2i gridSize = m_grid->GetGridSize();
+		const unsigned numCells = gridSize.x * gridSize.y;
+		const Real maxDelay = std::numeric_limits<Real>::max();
+
+		// the whole probe comes from one analysis, quantized again if the grid was taken back meanwhile
+		AnalyzerSnapshot snapshot;
+		do
+		{
+			analyzer->BeginRead(&snapshot);
+			for (unsigned i = 0; i < numCells; ++i)
+			{
+				ProbeCell& cell = out[i];
+				std::memset(&cell, 0, sizeof(ProbeCell));
+				if (snapshot.delays[i] == maxDelay)
+					continue;
+
+				const AnalyzerResult& result = snapshot.results[i];
+				cell.occlusion = QuantizeGain(result.occlusion);
+				cell.wetGain = QuantizeGain(result.wetGain);
+				cell.rt60 = QuantizeSeconds(result.rt60);
+				cell.lowpass = QuantizeFrequency(result.lowpassIntensity);
+				cell.flags = pv_ProbeCellReached;
+				if (QuantizeDirection(result.direction, cell.direction))
+					cell.flags |= pv_ProbeCellDirection;
+				if (QuantizeDirection(result.sourceDirectivity, cell.sourceDirectivity))
+					cell.flags |= pv_ProbeCellDirectivity;
+			}
+		} while (!analyzer->EndRead(snapshot));
+	}
+
+	bool ProbeBaker::Bake(const char* filePath)
+	{
+		const vec2i gridSize = m_grid->GetGridSize();
+		const vec2& gridOffset = m_grid->GetGridOffset();
+		const Real dx = m_grid->GetDX();
+		const unsigned numCells = gridSize.x * gridSize.y;
+		const unsigned probesPerPass = m_config.listenerCount;
+		const unsigned chunkSize = m_bakeConfig.chunkSizeInProbes;
+
+		// probe lattice, centered on the grid
+		ProbeFileHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, PV_PROBE_FILE_MAGIC, sizeof(header.magic));
+		header.version = PV_PROBE_FILE_VERSION;
+		header.headerSize = sizeof(ProbeFileHeader);
+		header.cellSize = sizeof(ProbeCell);
+		header.dx = (float)dx;
+		header.gridOffsetX = (float)gridOffset.x;
+		header.gridOffsetY = (float)gridOffset.y;
+		header.gridRows = gridSize.x;
+		header.gridColumns = gridSize.y;
+		header.probeSpacing = std::max((unsigned)std::round(m_bakeConfig.probeSpacingInMeters / dx), 1u);
+		header.probeRows = (gridSize.x - 1) / header.probeSpacing + 1;
+		header.probeColumns = (gridSize.y - 1) / header.probeSpacing + 1;
+		header.probeOriginRow = (gridSize.x - 1 - (header.probeRows - 1) * header.probeSpacing) / 2;
+		header.probeOriginColumn = (gridSize.y - 1 - (header.probeColumns - 1) * header.probeSpacing) / 2;
+		header.chunkSize = chunkSize;
+		header.chunkRows = (header.probeRows + chunkSize - 1) / chunkSize;
+		header.chunkColumns = (header.probeColumns + chunkSize - 1) / chunkSize;
+		header.probeTableOffset = sizeof(ProbeFileHeader);
+		header.chunkTableOffset = header.probeTableOffset + sizeof(uint32_t) * (uint64_t)header.probeRows * header.probeColumns;
+
+		// probes inside geometry have no data, the others take the next slot of their chunk
+		const unsigned numProbes = header.probeRows * header.probeColumns;
+		const unsigned numChunks = header.chunkRows * header.chunkColumns;
+		std::vector<uint32_t> probeTable(numProbes, PV_PROBE_NO_DATA);
+		std::vector<ProbeChunkEntry> chunkTable(numChunks);
+		const uint64_t probeSize = sizeof(ProbeCell) * (uint64_t)numCells;
+		uint64_t offset = header.chunkTableOffset + sizeof(ProbeChunkEntry) * (uint64_t)numChunks;
+		for (unsigned chunk = 0; chunk < numChunks; ++chunk)
+		{
+			const unsigned firstRow = (chunk / header.chunkColumns) * chunkSize;
+			const unsigned firstColumn = (chunk % header.chunkColumns) * chunkSize;
+			uint32_t slots = 0;
+			for (unsigned row = firstRow; row < std::min(firstRow + chunkSize, header.probeRows); ++row)
+			{
+				for (unsigned column = firstColumn; column < std::min(firstColumn + chunkSize, header.probeColumns); ++column)
+				{
+					const vec2i cell(header.probeOriginRow + row * header.probeSpacing, header.probeOriginColumn + column * header.probeSpacing);
+					if (m_grid->IsOpenCell(cell))
+						probeTable[row * header.probeColumns + column] = slots++;
+				}
+			}
+
+			ProbeChunkEntry& entry = chunkTable[chunk];
+			entry.size = probeSize * slots;
+			if (slots > 0)
+			{
+				offset += (PV_PROBE_CHUNK_ALIGNMENT - offset % PV_PROBE_CHUNK_ALIGNMENT) % PV_PROBE_CHUNK_ALIGNMENT;
+				entry.offset = offset;
+				offset += entry.size;
+			}
+		}
+
+		std::ofstream file(filePath, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(probeTable.data()), sizeof(uint32_t) * probeTable.size());
+		file.write(reinterpret_cast<const char*>(chunkTable.data()), sizeof(ProbeChunkEntry) * chunkTable.size());
+		offset = header.chunkTableOffset + sizeof(ProbeChunkEntry) * (uint64_t)numChunks;
+
+		// bake chunk by chunk, so only one chunk of probe data is held at a time
+		std::vector<ProbeCell> chunkData;
+		vec3 listeners[PV_MAX_LISTENERS];
+		unsigned slots[PV_MAX_LISTENERS];
+		for (unsigned chunk = 0; chunk < numChunks; ++chunk)
+		{
+			const ProbeChunkEntry& entry = chunkTable[chunk];
+			if (entry.size == 0)
+				continue;
+			chunkData.resize((size_t)(entry.size / sizeof(ProbeCell)));
+
+			const unsigned firstRow = (chunk / header.chunkColumns) * chunkSize;
+			const unsigned firstColumn = (chunk % header.chunkColumns) * chunkSize;
+			const unsigned endRow = std::min(firstRow + chunkSize, header.probeRows);
+			const unsigned endColumn = std::min(firstColumn + chunkSize, header.probeColumns);
+			unsigned row = firstRow, column = firstColumn;
+			while (row < endRow)
+			{
+				// next pass, a listener at the center of each probe's cell
+				unsigned count = 0;
+				for (; row < endRow && count < probesPerPass; )
+				{
+					const uint32_t slot = probeTable[row * header.probeColumns + column];
+					if (slot != PV_PROBE_NO_DATA)
+					{
+						const Real cellRow = (Real)(header.probeOriginRow + row * header.probeSpacing) + (Real)0.5f;
+						const Real cellColumn = (Real)(header.probeOriginColumn + column * header.probeSpacing) + (Real)0.5f;
+						listeners[count] = vec3(cellRow * dx - gridOffset.x, (Real)0.f, cellColumn * dx - gridOffset.y);
+						slots[count] = slot;
+						++count;
+					}
+					if (++column == endColumn)
+					{
+						column = firstColumn;
+						++row;
+					}
+				}
+				if (count == 0)
+					break;
+
+				// the grid always simulates all of its listeners, a short last pass repeats its last probe
+				for (unsigned k = count; k < probesPerPass; ++k)
+					listeners[k] = listeners[count - 1];
+
+				m_grid->GenerateResponses(listeners);
+				for (unsigned k = 0; k < count; ++k)
+				{
+					m_analyzers[k]->AnalyzeResponses(listeners[k]);
+					QuantizeProbe(m_analyzers[k], chunkData.data() + (size_t)slots[k] * numCells);
+				}
+			}
+
+			PadToChunkAlignment(file, offset);
+			file.write(reinterpret_cast<const char*>(chunkData.data()), (std::streamsize)entry.size);
+			offset += entry.size;
+		}
+
+		file.close();
+		return !file.fail();
+	}
+} // namespace Planeverb
@@ -0,0 +1,36 @@
+#pragma once
+#include <PvTypes.h>
+
+namespace Planeverb
+{
+	// Forward declarations
+	class Grid;
+	class FreeGrid;
+	class Analyzer;
+	struct ProbeCell;
+
+	// Offline probe baking. simulates a listener at every probe of a lattice over static geometry,
+	// a few probes per pass, and writes the quantized analysis of each probe to a probe file (see ProbeFormat.h)
+	class ProbeBaker
+	{
+	public:
+		// Can throw pv_InvalidConfig or pv_NotEnoughMemory
+		ProbeBaker(const PlaneverbConfig* config, const PlaneverbBakeConfig* bakeConfig);
+		~ProbeBaker();
+
+		void AddGeometry(const AABB* transform);
+
+		// bakes every probe and writes the file, false if it couldn't be written
+		bool Bake(const char* filePath);
+
+	private:
+		void QuantizeProbe(const Analyzer* analyzer, ProbeCell* out) const;
+
+		PlaneverbConfig m_config;				// copy of the input config, one listener per probe of a pass
+		PlaneverbBakeConfig m_bakeConfig;		// copy of the bake settings
+		char* m_mem;							// pool for all systems
+		Grid* m_grid;							// grid simulating the probes of a pass
+		FreeGrid* m_freeGrid;					// free field reference
+		Analyzer* m_analyzers[PV_MAX_LISTENERS];	// analyzer per probe of a pass
+	};
+} // namespace Planeverb
@@ -0,0 +1,139 @@
+#pragma once
+#include <PvTypes.h>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+namespace Planeverb
+{
+	// Baked probe file layout, little endian:
+	//   ProbeFileHeader
+	//   probe table, one uint32_t per lattice probe (row-major): slot of the probe in its chunk, PV_PROBE_NO_DATA if
+	//     the probe is inside geometry
+	//   chunk table, one ProbeChunkEntry per chunk (row-major)
+	//   chunks, each starting on a PV_PROBE_CHUNK_ALIGNMENT boundary so they can be mapped on their own.
+	//     a chunk holds the probes of a square of the lattice that have data, in probe table order, and every probe
+	//     is a whole grid of ProbeCells in result order (row * gridColumns + column)
+	// The simulation is reciprocal, so a probe stores what a listener at the probe hears from every emitter cell
+
+	const constexpr char PV_PROBE_FILE_MAGIC[4] = { 'P', 'V', 'P', 'B' };
+	const constexpr uint32_t PV_PROBE_FILE_VERSION = 1;			// bumped on any layout change, readers reject others
+	const constexpr uint64_t PV_PROBE_CHUNK_ALIGNMENT = 4096;		// page size, chunks are aligned to it
+	const constexpr uint32_t PV_PROBE_NO_DATA = (uint32_t)(-1);	// probe table entry of probes inside geometry
+	const constexpr unsigned PV_BAKED_EPOCH = 1;					// epoch reported for baked outputs
+
+	struct ProbeFileHeader
+	{
+		char magic[4];				// PV_PROBE_FILE_MAGIC
+		uint32_t version;			// PV_PROBE_FILE_VERSION
+		uint32_t headerSize;		// sizeof(ProbeFileHeader)
+		uint32_t cellSize;			// sizeof(ProbeCell)
+		float dx;					// meters per grid cell
+		float gridOffsetX;			// grid world offset
+		float gridOffsetY;
+		uint32_t gridRows;			// grid cells per probe
+		uint32_t gridColumns;
+		uint32_t probeSpacing;		// grid cells between probes
+		uint32_t probeOriginRow;	// grid cell of probe [0, 0]
+		uint32_t probeOriginColumn;
+		uint32_t probeRows;			// probe lattice size
+		uint32_t probeColumns;
+		uint32_t chunkSize;			// probes per chunk side
+		uint32_t chunkRows;			// chunk lattice size
+		uint32_t chunkColumns;
+		uint32_t reserved;
+		uint64_t probeTableOffset;	// file offsets of the tables
+		uint64_t chunkTableOffset;
+	};
+	static_assert(sizeof(ProbeFileHeader) == 88, "probe file header layout changed");
+
+	struct ProbeChunkEntry
+	{
+		uint64_t offset;			// file offset of the chunk, 0 if no probe of the chunk has data
+		uint64_t size;				// bytes of probe data
+	};
+
+	// flags of a quantized cell
+	enum ProbeCellFlags : uint8_t
+	{
+		pv_ProbeCellReached = 1 << 0,		// the pulse reached the cell, cells inside geometry have no data
+		pv_ProbeCellDirection = 1 << 1,		// direction is set
+		pv_ProbeCellDirectivity = 1 << 2,	// source directivity is set
+	};
+
+	// Quantized AnalyzerResult, 10 bytes
+	struct ProbeCell
+	{
+		uint16_t occlusion;			// gain in dB, see QuantizeGain
+		uint16_t wetGain;			// gain in dB, see QuantizeGain
+		uint16_t rt60;				// milliseconds
+		uint8_t lowpass;			// cutoff on a log scale, see QuantizeFrequency
+		uint8_t flags;				// ProbeCellFlags
+		uint8_t direction;			// angle in 1/256 turns
+		uint8_t sourceDirectivity;	// angle in 1/256 turns
+	};
+	static_assert(sizeof(ProbeCell) == 10, "probe cell layout changed");
+
+	// gains are stored in 1/256 dB steps from PV_PROBE_MIN_GAIN_DB, 0 means silent
+	const constexpr Real PV_PROBE_MIN_GAIN_DB = (Real)-100.f;
+	const constexpr Real PV_PROBE_GAIN_STEPS_PER_DB = (Real)256.f;
+
+	// lowpass cutoffs are stored as 255 steps over the audible range on a log scale
+	const constexpr Real PV_PROBE_FREQUENCY_OCTAVES = (Real)9.965784f;	// log2(PV_MAX_AUDIBLE_FREQ / PV_MIN_AUDIBLE_FREQ)
+
+	inline uint16_t QuantizeGain(Real gain)
+	{
+		if (!(gain > (Real)0.f))
+			return 0;
+		const Real steps = ((Real)20.f * std::log10(gain) - PV_PROBE_MIN_GAIN_DB) * PV_PROBE_GAIN_STEPS_PER_DB;
+		return (uint16_t)std::min(std::max(std::round(steps), (Real)1.f), (Real)65535.f);
+	}
+
+	inline Real DequantizeGain(uint16_t code)
+	{
+		if (code == 0)
+			return (Real)0.f;
+		return std::pow((Real)10.f, ((Real)code / PV_PROBE_GAIN_STEPS_PER_DB + PV_PROBE_MIN_GAIN_DB) / (Real)20.f);
+	}
+
+	inline uint16_t QuantizeSeconds(Real seconds)
+	{
+		if (!(seconds > (Real)0.f))
+			return 0;
+		return (uint16_t)std::min(std::round(seconds * (Real)1000.f), (Real)65535.f);
+	}
+
+	inline Real DequantizeSeconds(uint16_t code)
+	{
+		return (Real)code * (Real)0.001f;
+	}
+
+	inline uint8_t QuantizeFrequency(Real frequency)
+	{
+		if (!(frequency > PV_MIN_AUDIBLE_FREQ))
+			return 0;
+		const Real steps = std::log2(frequency / PV_MIN_AUDIBLE_FREQ) / PV_PROBE_FREQUENCY_OCTAVES * (Real)255.f;
+		return (uint8_t)std::min(std::round(steps), (Real)255.f);
+	}
+
+	inline Real DequantizeFrequency(uint8_t code)
+	{
+		return PV_MIN_AUDIBLE_FREQ * std::exp2((Real)code / (Real)255.f * PV_PROBE_FREQUENCY_OCTAVES);
+	}
+
+	// unit vectors as angles, false for the zero vector
+	inline bool QuantizeDirection(const vec2& direction, uint8_t& code)
+	{
+		if (direction.x == (Real)0.f && direction.y == (Real)0.f)
+			return false;
+		const Real turns = std::atan2(direction.y, direction.x) / ((Real)2.f * PV_PI);
+		code = (uint8_t)((int)std::round(turns * (Real)256.f) & 255);
+		return true;
+	}
+
+	inline vec2 DequantizeDirection(uint8_t code)
+	{
+		const Real angle = (Real)code * ((Real)2.f * PV_PI / (Real)256.f);
+		return vec2(std::cos(angle), std::sin(angle));
+	}
+} // namespace Planeverb
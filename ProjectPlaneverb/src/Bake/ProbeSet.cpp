@@ -0,0 +1,583 @@
+#include <Bake\ProbeSet.h>
+#include <Bake\ProbeFormat.h>
+#include <DSP\Analyzer.h>
+#include <PvDefinitions.h>
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace Planeverb
+{
+	namespace
+	{
+		const constexpr unsigned PV_NO_CHUNK = (unsigned)(-1);	// end of the LRU list
+
+		// prefetching looks this far ahead of a moving listener
+		const constexpr Real PV_PROBE_PREFETCH_SECONDS = (Real)2.f;
+
+		// listener moves faster than this are teleports and don't count towards its velocity
+		const constexpr Real PV_PROBE_MAX_LISTENER_SPEED = (Real)100.f;
+
+		// listener updates closer together than this are merged, their velocity would be mostly noise
+		const constexpr Real PV_PROBE_MIN_TRACK_INTERVAL = (Real)0.005f;
+
+		// weight of the newest velocity sample
+		const constexpr Real PV_PROBE_VELOCITY_SMOOTHING = (Real)0.5f;
+
+		// end of the probe and chunk tables
+		uint64_t GetTablesEnd(const ProbeFileHeader* header)
+		{
+			const uint64_t numProbes = (uint64_t)header->probeRows * header->probeColumns;
+			const uint64_t numChunks = (uint64_t)header->chunkRows * header->chunkColumns;
+			return std::max(header->probeTableOffset + sizeof(uint32_t) * numProbes,
+				header->chunkTableOffset + sizeof(ProbeChunkEntry) * numChunks);
+		}
+
+		// checks the header and that the tables lie inside the file
+		bool IsValidProbeHeader(const ProbeFileHeader* header, uint64_t size)
+		{
+			if (std::memcmp(header->magic, PV_PROBE_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+				header->version != PV_PROBE_FILE_VERSION ||
+				header->headerSize != sizeof(ProbeFileHeader) ||
+				header->cellSize != sizeof(ProbeCell) ||
+				!(header->dx > 0.f) || header->probeSpacing == 0 || header->chunkSize == 0 ||
+				header->probeRows == 0 || header->probeColumns == 0 ||
+				header->chunkRows != (header->probeRows + header->chunkSize - 1) / header->chunkSize ||
+				header->chunkColumns != (header->probeColumns + header->chunkSize - 1) / header->chunkSize)
+			{
+				return false;
+			}
+			return header->probeTableOffset < size && header->chunkTableOffset < size && GetTablesEnd(header) <= size;
+		}
+
+		// checks that every chunk lies inside the file and every probe with data fits in its chunk
+		bool IsValidProbeTables(const char* data, uint64_t size)
+		{
+			const ProbeFileHeader* header = reinterpret_cast<const ProbeFileHeader*>(data);
+			const uint64_t numProbes = (uint64_t)header->probeRows * header->probeColumns;
+			const uint64_t numChunks = (uint64_t)header->chunkRows * header->chunkColumns;
+			const uint64_t probeSize = sizeof(ProbeCell) * (uint64_t)header->gridRows * header->gridColumns;
+			const uint32_t* probeTable = reinterpret_cast<const uint32_t*>(data + header->probeTableOffset);
+			const ProbeChunkEntry* chunkTable = reinterpret_cast<const ProbeChunkEntry*>(data + header->chunkTableOffset);
+			for (uint64_t chunk = 0; chunk < numChunks; ++chunk)
+			{
+				if (chunkTable[chunk].size != 0 &&
+					(chunkTable[chunk].offset > size || chunkTable[chunk].size > size - chunkTable[chunk].offset))
+				{
+					return false;
+				}
+			}
+			for (uint64_t probe = 0; probe < numProbes; ++probe)
+			{
+				if (probeTable[probe] == PV_PROBE_NO_DATA)
+					continue;
+				const uint64_t row = probe / header->probeColumns;
+				const uint64_t column = probe % header->probeColumns;
+				const ProbeChunkEntry& entry = chunkTable[(row / header->chunkSize) * header->chunkColumns + column / header->chunkSize];
+				if ((probeTable[probe] + 1) * probeSize > entry.size)
+					return false;
+			}
+			return true;
+		}
+
+		// opens a probe file and maps its header and tables, nullptr if it isn't a valid probe file
+		const char* MapTables(MappedFile& file, const char* filePath, void** view)
+		{
+			*view = nullptr;
+			if (!file.Open(filePath) || file.GetSize() < sizeof(ProbeFileHeader))
+				return nullptr;
+
+			void* headerView;
+			const ProbeFileHeader* header = reinterpret_cast<const ProbeFileHeader*>(file.Map(0, sizeof(ProbeFileHeader), &headerView));
+			if (!header)
+				return nullptr;
+			const bool isValid = IsValidProbeHeader(header, file.GetSize());
+			const uint64_t tablesEnd = isValid ? GetTablesEnd(header) : 0;
+			MappedFile::Unmap(headerView);
+			if (!isValid)
+				return nullptr;
+
+			const char* data = file.Map(0, (size_t)tablesEnd, view);
+			if (data && !IsValidProbeTables(data, file.GetSize()))
+			{
+				MappedFile::Unmap(*view);
+				*view = nullptr;
+				return nullptr;
+			}
+			return data;
+		}
+
+		// lattice coordinate of a grid position along one axis, clamped to the lattice.
+		// first is the lower of the two probes to blend and fraction the weight of the upper one
+		void LocateProbe(Real cell, unsigned origin, unsigned spacing, unsigned count, unsigned& first, Real& fraction)
+		{
+			const Real position = std::min(std::max((cell - (Real)origin) / (Real)spacing, (Real)0.f), (Real)(count - 1));
+			first = std::min((unsigned)position, count > 1 ? count - 2 : 0u);
+			fraction = (count > 1) ? position - (Real)first : (Real)0.f;
+		}
+	} // namespace <>
+
+	ProbeSet::ProbeSet(const PlaneverbConfig* config) :
+		m_file(), m_tablesView(nullptr), m_header(nullptr), m_probeTable(nullptr), m_chunkTable(nullptr),
+		m_listenerCount(config->listenerCount), m_mutex(), m_chunks(nullptr), m_lruHead(PV_NO_CHUNK), m_lruTail(PV_NO_CHUNK),
+		m_residentSize(0), m_cacheSize(config->bakedProbeCacheSize), m_queryMisses(0), m_tracks(),
+		m_prefetchSignal(), m_prefetchPending(false), m_isRunning(true), m_prefetchProcessor()
+	{
+		// the tables stay mapped, chunks are mapped as listeners get near them
+		const char* data = MapTables(m_file, config->bakedProbeFile, &m_tablesView);
+		if (data == nullptr)
+		{
+			throw pv_InvalidConfig;
+		}
+		m_header = reinterpret_cast<const ProbeFileHeader*>(data);
+		m_probeTable = reinterpret_cast<const uint32_t*>(data + m_header->probeTableOffset);
+		m_chunkTable = reinterpret_cast<const ProbeChunkEntry*>(data + m_header->chunkTableOffset);
+
+		const unsigned numChunks = m_header->chunkRows * m_header->chunkColumns;
+		m_chunks = new ChunkSlot[numChunks];
+		if (m_chunks == nullptr)
+		{
+			MappedFile::Unmap(m_tablesView);
+			throw pv_NotEnoughMemory;
+		}
+		for (unsigned i = 0; i < numChunks; ++i)
+		{
+			m_chunks[i].data = nullptr;
+			m_chunks[i].view = nullptr;
+			m_chunks[i].pins = 0;
+			m_chunks[i].prev = PV_NO_CHUNK;
+			m_chunks[i].next = PV_NO_CHUNK;
+		}
+
+		m_prefetchProcessor = std::thread(&ProbeSet::PrefetchProcessor, this);
+	}
+
+	ProbeSet::~ProbeSet()
+	{
+		// stop the prefetch thread
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isRunning = false;
+		}
+		m_prefetchSignal.notify_one();
+		if (m_prefetchProcessor.joinable())
+		{
+			m_prefetchProcessor.join();
+		}
+
+		// unmap everything that is still resident
+		for (unsigned chunk = m_lruHead; chunk != PV_NO_CHUNK; chunk = m_chunks[chunk].next)
+			MappedFile::Unmap(m_chunks[chunk].view);
+		delete[] m_chunks;
+		m_chunks = nullptr;
+		MappedFile::Unmap(m_tablesView);
+		m_tablesView = nullptr;
+	}
+
+	size_t ProbeSet::GetMemoryRequirement(const PlaneverbConfig* config)
+	{
+		if (config->bakedProbeFile == nullptr)
+			return 0;
+
+		MappedFile file;
+		void* view;
+		const ProbeFileHeader* header = reinterpret_cast<const ProbeFileHeader*>(MapTables(file, config->bakedProbeFile, &view));
+		if (header == nullptr)
+			return 0;
+
+		const size_t tablesSize = (size_t)GetTablesEnd(header);
+		const size_t slotsSize = sizeof(ChunkSlot) * header->chunkRows * header->chunkColumns;
+		MappedFile::Unmap(view);
+
+		const size_t fileSize = (size_t)file.GetSize();
+		const size_t cacheSize = (config->bakedProbeCacheSize != 0) ? std::min(config->bakedProbeCacheSize, fileSize) : fileSize;
+		return tablesSize + slotsSize + cacheSize;
+	}
+
+	size_t ProbeSet::GetResidentSize()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_residentSize;
+	}
+
+	size_t ProbeSet::GetQueryMisses()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_queryMisses;
+	}
+
+	// the four probes around a listener and their bilinear weights, probes sit at cell centers.
+	// on a lattice one probe wide the second probe along that axis is past the end, with weight 0
+	void ProbeSet::LocateListener(const vec3& listenerPos, unsigned probeRows[4], unsigned probeColumns[4], Real weights[4]) const
+	{
+		const ProbeFileHeader& header = *m_header;
+		const Real invDX = (Real)1.f / (Real)header.dx;
+
+		unsigned row0, column0;
+		Real fx, fy;
+		LocateProbe((listenerPos.x + header.gridOffsetX) * invDX - (Real)0.5f, header.probeOriginRow, header.probeSpacing, header.probeRows, row0, fx);
+		LocateProbe((listenerPos.z + header.gridOffsetY) * invDX - (Real)0.5f, header.probeOriginColumn, header.probeSpacing, header.probeColumns, column0, fy);
+
+		probeRows[0] = row0;		probeColumns[0] = column0;
+		probeRows[1] = row0 + 1;	probeColumns[1] = column0;
+		probeRows[2] = row0;		probeColumns[2] = column0 + 1;
+		probeRows[3] = row0 + 1;	probeColumns[3] = column0 + 1;
+		weights[0] = ((Real)1.f - fx) * ((Real)1.f - fy);
+		weights[1] = fx * ((Real)1.f - fy);
+		weights[2] = ((Real)1.f - fx) * fy;
+		weights[3] = fx * fy;
+	}
+
+	unsigned ProbeSet::GetChunk(unsigned probeRow, unsigned probeColumn) const
+	{
+		return (probeRow / m_header->chunkSize) * m_header->chunkColumns + probeColumn / m_header->chunkSize;
+	}
+
+	// cells of a probe in its mapped chunk
+	const ProbeCell* ProbeSet::GetProbe(const char* chunkData, unsigned probeRow, unsigned probeColumn) const
+	{
+		const uint32_t slot = m_probeTable[probeRow * m_header->probeColumns + probeColumn];
+		const size_t probeLength = (size_t)m_header->gridRows * m_header->gridColumns;
+		return reinterpret_cast<const ProbeCell*>(chunkData) + slot * probeLength;
+	}
+
+	// chunks a listener moving from one position to another needs, nearest first. stops at the listener's share
+	// of the cache so prefetching never evicts what it just fetched
+	unsigned ProbeSet::FindPrefetchChunks(const vec3& from, const vec3& to, unsigned* chunks) const
+	{
+		const ProbeFileHeader& header = *m_header;
+		const size_t budget = (m_cacheSize != 0) ? m_cacheSize / m_listenerCount : (size_t)(-1);
+
+		// sampled every half chunk, so no chunk on the way is skipped
+		const Real step = (Real)0.5f * (Real)(header.chunkSize * header.probeSpacing) * (Real)header.dx;
+		const Real dx = to.x - from.x;
+		const Real dz = to.z - from.z;
+		const unsigned samples = std::min((unsigned)(std::sqrt(dx * dx + dz * dz) / step) + 1, PV_PROBE_MAX_PREFETCH_CHUNKS * 4);
+
+		unsigned count = 0;
+		size_t size = 0;
+		for (unsigned s = 0; s < samples; ++s)
+		{
+			const Real t = (samples > 1) ? (Real)s / (Real)(samples - 1) : (Real)0.f;
+			unsigned probeRows[4], probeColumns[4];
+			Real weights[4];
+			LocateListener(vec3(from.x + dx * t, from.y, from.z + dz * t), probeRows, probeColumns, weights);
+
+			for (int k = 0; k < 4; ++k)
+			{
+				if (probeRows[k] >= header.probeRows || probeColumns[k] >= header.probeColumns)
+					continue;
+				const unsigned chunk = GetChunk(probeRows[k], probeColumns[k]);
+				if (m_chunkTable[chunk].size == 0 || std::find(chunks, chunks + count, chunk) != chunks + count)
+					continue;
+
+				if (count == PV_PROBE_MAX_PREFETCH_CHUNKS || (count > 0 && size + m_chunkTable[chunk].size > budget))
+					return count;
+				chunks[count++] = chunk;
+				size += (size_t)m_chunkTable[chunk].size;
+			}
+		}
+		return count;
+	}
+
+	// maps the chunk if it isn't resident and makes it the most recently used, nullptr if it has no data or
+	// can't be mapped. mapped is set if the chunk wasn't resident
+	const char* ProbeSet::PinChunk(unsigned chunk, bool* mapped)
+	{
+		ChunkSlot& slot = m_chunks[chunk];
+		*mapped = false;
+		if (slot.data == nullptr)
+		{
+			const ProbeChunkEntry& entry = m_chunkTable[chunk];
+			if (entry.size == 0)
+				return nullptr;
+			slot.data = m_file.Map(entry.offset, (size_t)entry.size, &slot.view);
+			if (slot.data == nullptr)
+				return nullptr;
+			m_residentSize += (size_t)entry.size;
+			*mapped = true;
+		}
+		else
+		{
+			UnlinkChunk(chunk);
+		}
+
+		slot.prev = PV_NO_CHUNK;
+		slot.next = m_lruHead;
+		if (m_lruHead != PV_NO_CHUNK)
+			m_chunks[m_lruHead].prev = chunk;
+		else
+			m_lruTail = chunk;
+		m_lruHead = chunk;
+
+		++slot.pins;
+		return slot.data;
+	}
+
+	void ProbeSet::UnpinChunk(unsigned chunk)
+	{
+		--m_chunks[chunk].pins;
+	}
+
+	void ProbeSet::UnlinkChunk(unsigned chunk)
+	{
+		ChunkSlot& slot = m_chunks[chunk];
+		if (slot.prev != PV_NO_CHUNK)
+			m_chunks[slot.prev].next = slot.next;
+		else
+			m_lruHead = slot.next;
+		if (slot.next != PV_NO_CHUNK)
+			m_chunks[slot.next].prev = slot.prev;
+		else
+			m_lruTail = slot.prev;
+		slot.prev = PV_NO_CHUNK;
+		slot.next = PV_NO_CHUNK;
+	}
+
+	// unmaps the least recently used chunks that aren't pinned until the cache fits
+	void ProbeSet::EvictChunks()
+	{
+		if (m_cacheSize == 0)
+			return;
+
+		unsigned chunk = m_lruTail;
+		while (m_residentSize > m_cacheSize && chunk != PV_NO_CHUNK)
+		{
+			ChunkSlot& slot = m_chunks[chunk];
+			const unsigned prev = slot.prev;
+			if (slot.pins == 0)
+			{
+				UnlinkChunk(chunk);
+				MappedFile::Unmap(slot.view);
+				slot.data = nullptr;
+				slot.view = nullptr;
+				m_residentSize -= (size_t)m_chunkTable[chunk].size;
+			}
+			chunk = prev;
+		}
+	}
+
+	void ProbeSet::BeginQuery(const vec3& listenerPos, ProbeNeighborhood* out)
+	{
+		unsigned probeRows[4], probeColumns[4];
+		LocateListener(listenerPos, probeRows, probeColumns, out->weights);
+		out->chunkCount = 0;
+
+		// neighbouring probes mostly share a chunk, each chunk is pinned once
+		const char* chunkData[4];
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (int k = 0; k < 4; ++k)
+		{
+			out->probes[k] = nullptr;
+			if (probeRows[k] >= m_header->probeRows || probeColumns[k] >= m_header->probeColumns ||
+				m_probeTable[probeRows[k] * m_header->probeColumns + probeColumns[k]] == PV_PROBE_NO_DATA)
+			{
+				continue;
+			}
+
+			const unsigned chunk = GetChunk(probeRows[k], probeColumns[k]);
+			const char* data = nullptr;
+			for (unsigned c = 0; c < out->chunkCount && !data; ++c)
+			{
+				if (out->chunks[c] == chunk)
+					data = chunkData[c];
+			}
+			if (!data)
+			{
+				bool mapped;
+				data = PinChunk(chunk, &mapped);
+				if (!data)
+					continue;
+				if (mapped)
+					++m_queryMisses;
+				chunkData[out->chunkCount] = data;
+				out->chunks[out->chunkCount++] = chunk;
+			}
+			out->probes[k] = GetProbe(data, probeRows[k], probeColumns[k]);
+		}
+	}
+
+	void ProbeSet::EndQuery(const ProbeNeighborhood& neighborhood)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (unsigned c = 0; c < neighborhood.chunkCount; ++c)
+			UnpinChunk(neighborhood.chunks[c]);
+		EvictChunks();
+	}
+
+	void ProbeSet::UpdateListener(unsigned listener, const vec3& listenerPos)
+	{
+		if (listener >= m_listenerCount)
+			return;
+
+		const auto now = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ListenerTrack& track = m_tracks[listener];
+		if (!track.tracked)
+		{
+			track.tracked = true;
+			track.position = listenerPos;
+			track.velocity = vec3();
+			track.time = now;
+		}
+		else
+		{
+			const Real dt = std::chrono::duration<Real>(now - track.time).count();
+			if (dt >= PV_PROBE_MIN_TRACK_INTERVAL)
+			{
+				const vec3 velocity((listenerPos.x - track.position.x) / dt, 0.f, (listenerPos.z - track.position.z) / dt);
+				if (velocity.x * velocity.x + velocity.z * velocity.z > PV_PROBE_MAX_LISTENER_SPEED * PV_PROBE_MAX_LISTENER_SPEED)
+				{
+					track.velocity = vec3();
+				}
+				else
+				{
+					track.velocity.x += (velocity.x - track.velocity.x) * PV_PROBE_VELOCITY_SMOOTHING;
+					track.velocity.z += (velocity.z - track.velocity.z) * PV_PROBE_VELOCITY_SMOOTHING;
+				}
+				track.position = listenerPos;
+				track.time = now;
+			}
+		}
+
+		// the prefetch thread only wakes when the chunks on the listener's way change
+		unsigned chunks[PV_PROBE_MAX_PREFETCH_CHUNKS];
+		const vec3 ahead(listenerPos.x + track.velocity.x * PV_PROBE_PREFETCH_SECONDS, listenerPos.y,
+			listenerPos.z + track.velocity.z * PV_PROBE_PREFETCH_SECONDS);
+		const unsigned count = FindPrefetchChunks(listenerPos, ahead, chunks);
+		if (count != track.prefetchCount || !std::equal(chunks, chunks + count, track.prefetch))
+		{
+			std::copy(chunks, chunks + count, track.prefetch);
+			track.prefetchCount = count;
+			m_prefetchPending = true;
+			m_prefetchSignal.notify_one();
+		}
+	}
+
+	// Prefetch thread runs this function
+	void ProbeSet::PrefetchProcessor()
+	{
+		unsigned chunks[PV_MAX_LISTENERS * PV_PROBE_MAX_PREFETCH_CHUNKS];
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_isRunning)
+		{
+			m_prefetchSignal.wait(lock, [this]() { return m_prefetchPending || !m_isRunning; });
+			m_prefetchPending = false;
+
+			// the nearest chunks of every listener come first
+			unsigned count = 0;
+			for (unsigned rank = 0; rank < PV_PROBE_MAX_PREFETCH_CHUNKS; ++rank)
+			{
+				for (unsigned listener = 0; listener < m_listenerCount; ++listener)
+				{
+					const ListenerTrack& track = m_tracks[listener];
+					if (rank < track.prefetchCount && std::find(chunks, chunks + count, track.prefetch[rank]) == chunks + count)
+						chunks[count++] = track.prefetch[rank];
+				}
+			}
+
+			// starts over as soon as a listener's way changes
+			for (unsigned i = 0; i < count && m_isRunning && !m_prefetchPending; ++i)
+			{
+				bool mapped;
+				const char* data = PinChunk(chunks[i], &mapped);
+				if (!data)
+					continue;
+
+				// pages are read without holding up queries, the pin keeps the chunk mapped
+				if (mapped)
+				{
+					lock.unlock();
+					MappedFile::Prefetch(data, (size_t)m_chunkTable[chunks[i]].size);
+					lock.lock();
+				}
+				UnpinChunk(chunks[i]);
+				EvictChunks();
+			}
+		}
+	}
+
+	bool ProbeSet::Query(const ProbeNeighborhood& neighborhood, const vec3& emitterPos, AnalyzerResult* out) const
+	{
+		const ProbeFileHeader& header = *m_header;
+		const Real invDX = (Real)1.f / (Real)header.dx;
+
+		// emitter cell, same lookup as the analyzer
+		const Real emitterRow = (emitterPos.x + header.gridOffsetX) * invDX;
+		const Real emitterColumn = (emitterPos.z + header.gridOffsetY) * invDX;
+		if (!(emitterRow > (Real)-1.f && emitterRow < (Real)header.gridRows && emitterColumn > (Real)-1.f && emitterColumn < (Real)header.gridColumns))
+			return false;
+		const unsigned emitterIndex = INDEX((unsigned)emitterRow, (unsigned)emitterColumn, vec2i(header.gridRows, header.gridColumns));
+
+		// probes without a result for the cell are left out. if that leaves nothing, the listener is next to
+		// geometry and the remaining probes around it count equally
+		AnalyzerResult blend;
+		std::memset(&blend, 0, sizeof(blend));
+		Real totalWeight = 0.f;
+		Real strongestWeight = 0.f;
+		const ProbeCell* strongest = nullptr;
+
+		for (int pass = 0; pass < 2 && !strongest; ++pass)
+		{
+			for (int k = 0; k < 4; ++k)
+			{
+				const Real w = (pass == 0) ? neighborhood.weights[k] : (Real)1.f;
+				const ProbeCell* probe = neighborhood.probes[k];
+				if (w <= (Real)0.f || !probe || !(probe[emitterIndex].flags & pv_ProbeCellReached))
+					continue;
+
+				const ProbeCell& cell = probe[emitterIndex];
+				blend.occlusion += w * DequantizeGain(cell.occlusion);
+				blend.wetGain += w * DequantizeGain(cell.wetGain);
+				blend.rt60 += w * DequantizeSeconds(cell.rt60);
+				blend.lowpassIntensity += w * DequantizeFrequency(cell.lowpass);
+				if (cell.flags & pv_ProbeCellDirection)
+				{
+					const vec2 direction = DequantizeDirection(cell.direction);
+					blend.direction.x += w * direction.x;
+					blend.direction.y += w * direction.y;
+				}
+				if (cell.flags & pv_ProbeCellDirectivity)
+				{
+					const vec2 directivity = DequantizeDirection(cell.sourceDirectivity);
+					blend.sourceDirectivity.x += w * directivity.x;
+					blend.sourceDirectivity.y += w * directivity.y;
+				}
+				totalWeight += w;
+
+				if (w > strongestWeight)
+				{
+					strongestWeight = w;
+					strongest = &cell;
+				}
+			}
+		}
+
+		if (!strongest)
+			return false;
+
+		// directions are renormalized, opposite directions that cancel out fall back to the strongest probe
+		const Real invWeight = (Real)1.f / totalWeight;
+		out->occlusion = blend.occlusion * invWeight;
+		out->wetGain = blend.wetGain * invWeight;
+		out->rt60 = blend.rt60 * invWeight;
+		out->lowpassIntensity = blend.lowpassIntensity * invWeight;
+
+		const vec2* directions[2] = { &blend.direction, &blend.sourceDirectivity };
+		vec2* outputs[2] = { &out->direction, &out->sourceDirectivity };
+		const uint8_t flags[2] = { pv_ProbeCellDirection, pv_ProbeCellDirectivity };
+		const uint8_t fallback[2] = { strongest->direction, strongest->sourceDirectivity };
+		for (int i = 0; i < 2; ++i)
+		{
+			const Real length = std::sqrt(directions[i]->x * directions[i]->x + directions[i]->y * directions[i]->y);
+			if (length > (Real)1e-6f)
+				*outputs[i] = vec2(directions[i]->x / length, directions[i]->y / length);
+			else if (strongest->flags & flags[i])
+				*outputs[i] = DequantizeDirection(fallback[i]);
+			else
+				*outputs[i] = vec2(0.f, 0.f);
+		}
+		return true;
+	}
+} // namespace Planeverb
@@ -0,0 +1,119 @@
+#pragma once
+#include <PvTypes.h>
+#include <Util\MappedFile.h>
+#include <cstdint>
+#include <chrono>				// std::chrono::steady_clock
+#include <mutex>				// std::mutex
+#include <condition_variable>	// std::condition_variable
+#include <thread>				// std::thread
+
+namespace Planeverb
+{
+	// Forward declarations
+	struct AnalyzerResult;
+	struct ProbeFileHeader;
+	struct ProbeChunkEntry;
+	struct ProbeCell;
+
+	// most chunks prefetched ahead of one listener
+	const constexpr unsigned PV_PROBE_MAX_PREFETCH_CHUNKS = 16;
+
+	// The probes around a listener, with the chunks they're in pinned until EndQuery
+	struct ProbeNeighborhood
+	{
+		const ProbeCell* probes[4];		// cells of each probe, nullptr for probes without data
+		Real weights[4];				// bilinear weight of each probe
+		unsigned chunks[4];				// pinned chunks
+		unsigned chunkCount;
+	};
+
+	// Baked probes read from a probe file (see ProbeFormat.h), queried instead of a simulation.
+	// only the header and tables stay mapped. chunks are mapped when a listener gets near them, prefetched along
+	// each listener's velocity by a background thread, and unmapped least recently used first once the resident
+	// chunks exceed PlaneverbConfig::bakedProbeCacheSize
+	class ProbeSet
+	{
+	public:
+		// Can throw pv_InvalidConfig if the file is missing or not a supported probe file, or pv_NotEnoughMemory
+		ProbeSet(const PlaneverbConfig* config);
+		~ProbeSet();
+
+		// pins the chunks of the probes around the listener, every BeginQuery needs an EndQuery.
+		// chunks that aren't resident yet are mapped on the calling thread
+		void BeginQuery(const vec3& listenerPos, ProbeNeighborhood* out);
+		void EndQuery(const ProbeNeighborhood& neighborhood);
+
+		// blends the results of the probes around the listener for the emitter's cell.
+		// probes inside geometry or that never reached the cell are left out, false if none is left
+		bool Query(const ProbeNeighborhood& neighborhood, const vec3& emitterPos, AnalyzerResult* out) const;
+
+		// tracks the listener's velocity and prefetches the chunks on its way in the background
+		void UpdateListener(unsigned listener, const vec3& listenerPos);
+
+		// bytes of chunk data mapped right now
+		size_t GetResidentSize();
+
+		// chunks BeginQuery had to map itself, i.e. prefetching didn't keep up
+		size_t GetQueryMisses();
+
+		// bytes held for the tables and resident chunks, pinned chunks can briefly exceed the cache size
+		static size_t GetMemoryRequirement(const struct PlaneverbConfig* config);
+
+	private:
+		// a chunk of the file, resident while it is mapped
+		struct ChunkSlot
+		{
+			const char* data;			// chunk data, nullptr if not resident
+			void* view;					// mapped view holding the data
+			unsigned pins;				// queries and prefetches using the chunk, pinned chunks aren't evicted
+			unsigned prev;				// LRU list of resident chunks, most recently used first
+			unsigned next;
+		};
+
+		// motion of a listener and the chunks ahead of it
+		struct ListenerTrack
+		{
+			bool tracked;
+			vec3 position;
+			vec3 velocity;
+			std::chrono::steady_clock::time_point time;
+			unsigned prefetch[PV_PROBE_MAX_PREFETCH_CHUNKS];	// nearest first
+			unsigned prefetchCount;
+		};
+
+		void LocateListener(const vec3& listenerPos, unsigned probeRows[4], unsigned probeColumns[4], Real weights[4]) const;
+		unsigned GetChunk(unsigned probeRow, unsigned probeColumn) const;
+		const ProbeCell* GetProbe(const char* chunkData, unsigned probeRow, unsigned probeColumn) const;
+		unsigned FindPrefetchChunks(const vec3& from, const vec3& to, unsigned* chunks) const;
+
+		// chunk cache, m_mutex must be held
+		const char* PinChunk(unsigned chunk, bool* mapped);
+		void UnpinChunk(unsigned chunk);
+		void UnlinkChunk(unsigned chunk);
+		void EvictChunks();
+
+		// prefetch thread
+		void PrefetchProcessor();
+
+		MappedFile m_file;					// the probe file
+		void* m_tablesView;					// mapped header and tables
+		const ProbeFileHeader* m_header;	// header at the start of the file
+		const uint32_t* m_probeTable;		// slot of each probe in its chunk
+		const ProbeChunkEntry* m_chunkTable;	// location of each chunk
+		unsigned m_listenerCount;			// listeners that can be tracked
+
+		std::mutex m_mutex;					// guards the cache and the listener tracks
+		ChunkSlot* m_chunks;				// slot per chunk
+		unsigned m_lruHead;					// most recently used resident chunk
+		unsigned m_lruTail;					// least recently used resident chunk
+		size_t m_residentSize;				// bytes of resident chunks
+		size_t m_cacheSize;					// bytes kept resident at most, 0 for no limit
+		size_t m_queryMisses;				// chunks mapped by BeginQuery
+
+		ListenerTrack m_tracks[PV_MAX_LISTENERS];	// motion of each listener
+		std::condition_variable m_prefetchSignal;	// wakes the prefetch thread
+		bool m_prefetchPending;				// a track's prefetch list changed
+		bool m_isRunning;					// running flag used by the prefetch thread
+		std::thread m_prefetchProcessor;	// prefetch thread handle
+	};
+} // namespace Planeverb
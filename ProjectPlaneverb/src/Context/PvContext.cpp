@@ -5,10 +5,13 @@
 #include <Emissions\EmissionManager.h>
 #include <DSP\Analyzer.h>
 #include <FDTD\FreeGrid.h>
+#include <Bake\ProbeSet.h>
 #include <Util\ScopedTimer.h>
 #include <Planeverb.h>
 
 #include <cstring>
+#include <chrono>
+#include <algorithm>
 
 namespace Planeverb
 {
@@ -55,53 +58,253 @@ namespace Planeverb
 		if(context)
 			context->SetListenerPosition(listenerPosition);
 	}
+
+	// sets the position of one of several listeners
+	void SetListenerPosition(unsigned listener, const vec3& listenerPosition)
+	{
+		auto* context = GetContext();
+		if(context)
+			context->SetListenerPosition(listener, listenerPosition);
+	}
+
+	// counters of the background updates
+	PlaneverbUpdateStats GetUpdateStats()
+	{
+		auto* context = GetContext();
+		if (context)
+			return context->GetUpdateStats();
+		return PlaneverbUpdateStats{};
+	}
 	#pragma endregion
 
 	namespace
 	{
-		// Background thread runs this function
+		// how a listener's results are brought up to date
+		enum ListenerUpdate
+		{
+			lu_Keep,		// nothing it can hear changed
+			lu_Changed,		// only cells reached through changed geometry
+			lu_Full,		// every cell
+		};
+
+		// grid cell a listener is simulated from
+		vec2i GetListenerCell(const Grid* grid, const vec3& listenerPos)
+		{
+			const Real invDX = (Real)1.f / grid->GetDX();
+			return vec2i((unsigned)((listenerPos.x + grid->GetGridOffset().x) * invDX),
+				(unsigned)((listenerPos.z + grid->GetGridOffset().y) * invDX));
+		}
+
+		// updates cancelled in a row at most, the next one runs to the end
+		const constexpr unsigned PV_MAX_CONSECUTIVE_CANCELS = 1;
+
+		std::chrono::steady_clock::duration ToDuration(Real seconds)
+		{
+			return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<Real>(seconds));
+		}
+
+		// Background thread runs this function. it sleeps until something changed or the results are stale,
+		// brings every listener's results up to date, then rests to keep to the update rate and duty cycle.
+		// an update that is cancelled because it is outdated publishes nothing and the next one starts at once
 		void BackgroundProcessor(Context* context)
 		{
+			using Clock = std::chrono::steady_clock;
+
 			// get acoustics systems and information
-			bool isRunning = context->IsRunning();
 			Grid* grid = context->GetGrid();
 			GeometryManager* geometry = context->GetGeometryManager();
-			Analyzer* analyzer = context->GetAnalyzer();
 			const PlaneverbConfig* config = context->GetConfig();
-			vec3 listenerPos = context->GetListenerPosition();
+			const unsigned listenerCount = config->listenerCount;
+			vec3 listenerPos[PV_MAX_LISTENERS];
+			vec3 analyzedPos[PV_MAX_LISTENERS];		// listener positions of the published results
+			ListenerUpdate updates[PV_MAX_LISTENERS];
+			bool hasResults = false;
+			unsigned publishedLength = 0;			// simulated length of the published results
+			unsigned cancelledInARow = 0;			// updates cancelled since results were last published
+
+			// scheduling limits
+			const Clock::duration staleness = ToDuration(config->maxStalenessInSeconds);
+			const Clock::duration period = (config->targetUpdateRate > (Real)0.f) ? ToDuration((Real)1.f / config->targetUpdateRate) : Clock::duration::zero();
+			const Real restPerWork = ((Real)1.f - config->maxCpuDutyCycle) / config->maxCpuDutyCycle;
+			Clock::time_point nextUpdate = Clock::now();	// earliest start of the next update
+			Clock::time_point lastWake = Clock::now();
+			Clock::time_point firstStart = Clock::now();	// start of the first update since results were last published
 			
 			// run while context runs
-			while (isRunning)
+			while (context->IsRunning())
 			{
+				// rest, then sleep until a listener moved far enough, geometry changed or the results went stale
+				context->RestUntil(nextUpdate);
+				context->WaitForUpdate((staleness > Clock::duration::zero()) ? lastWake + staleness : Clock::time_point::max());
+				if (!context->IsRunning())
+					break;
+				const Clock::time_point start = Clock::now();
+				lastWake = start;
+				if (cancelledInARow == 0)
+					firstStart = start;
+
+				// update geometry in grid, then pick up the listener positions
+				geometry->PushGeometryChanges();
+				context->CaptureListenerPositions(listenerPos);
+
+				// a listener that moved needs everything redone. one that didn't only needs the cells that geometry
+				// changes can have reached within the last simulated length, if the changes are in its reach at all.
+				// the changed region is kept until results are published, it covers the edits of cancelled updates too
+				vec2i changedFirst, changedLast;
+				const bool geometryChanged = grid->GetChangedRegion(changedFirst, changedLast);
+				const unsigned previousLength = publishedLength;
+				bool simulate = false;
+				for (unsigned i = 0; i < listenerCount; ++i)
+				{
+					const vec3& pos = listenerPos[i];
+					const vec3& analyzed = analyzedPos[i];
+					if (!hasResults || pos.x != analyzed.x || pos.y != analyzed.y || pos.z != analyzed.z)
+						updates[i] = lu_Full;
+					else if (geometryChanged && grid->GetStepDistance(GetListenerCell(grid, pos), changedFirst, changedLast) <= previousLength)
+						updates[i] = lu_Changed;
+					else
+						updates[i] = lu_Keep;
+					simulate = simulate || (updates[i] != lu_Keep);
+				}
+
+				// nothing any listener hears changed, the published results still hold
+				if (!simulate)
+				{
+					grid->ClearChangedRegion();
+					cancelledInARow = 0;
+					continue;
+				}
+
 				// debug profile if needed
+				bool completed = true;
 				PROFILE_SECTION(
 				{
-					// generate impulse responses
-					PROFILE_TIME(grid->GenerateResponse(listenerPos), "Time for Generating Response");
-					
-					// generate runtime data
-					PROFILE_TIME(analyzer->AnalyzeResponses(listenerPos), "Time for Analyzing Response");
+					// generate impulse responses of every listener in one pass. it stops early if the cancel flag is set,
+					// unless too many updates in a row were cancelled already
+					const std::atomic<bool>* cancel = (cancelledInARow < PV_MAX_CONSECUTIVE_CANCELS) ? context->GetCancelFlag() : nullptr;
+					PROFILE_TIME(completed = grid->GenerateResponses(listenerPos, cancel), "Time for Generating Response");
 
-					// update geometry in grid
-					geometry->PushGeometryChanges();
+					// an adaptive simulation that ran for a different length changed every response
+					const bool sameLength = (grid->GetSimulatedResponseSize() == previousLength);
 
-					// update listener position and running flag
-					listenerPos = context->GetListenerPosition();
-					isRunning = context->IsRunning();
+					// generate runtime data
+					for (unsigned i = 0; i < listenerCount && completed; ++i)
+					{
+						if (updates[i] == lu_Full || !sameLength)
+						{
+							PROFILE_TIME(context->GetAnalyzer(i)->AnalyzeResponses(listenerPos[i]), "Time for Analyzing Response");
+						}
+						else if (updates[i] == lu_Changed)
+						{
+							PROFILE_TIME(context->GetAnalyzer(i)->AnalyzeChangedResponses(listenerPos[i], changedFirst, changedLast),
+								"Time for Analyzing Changed Responses");
+						}
+						analyzedPos[i] = listenerPos[i];
+					}
 				}, 
 				"Time for one analysis iteration");
+
+				// a cancelled update leaves the published results, the changed region and the schedule as they are.
+				// whatever cancelled it also requested an update, so the next one starts without waiting
+				const Clock::time_point end = Clock::now();
+				if (!completed)
+				{
+					context->RecordCancelledUpdate(grid->GetSimulatedResponseSize(), std::chrono::duration<Real>(end - start).count());
+					++cancelledInARow;
+					continue;
+				}
+				grid->ClearChangedRegion();
+				publishedLength = grid->GetSimulatedResponseSize();
+				hasResults = true;
+				cancelledInARow = 0;
+				context->RecordCompletedUpdate();
+
+				// the next update starts one period after this one, and not before resting for the duty cycle.
+				// time spent on cancelled updates counts towards both
+				nextUpdate = std::max(firstStart + period, end + ToDuration(std::chrono::duration<Real>(end - firstStart).count() * restPerWork));
 			}
 		}
+
+		// next resolution bin below the given one
+		int GetCoarserResolution(int resolution)
+		{
+			const int resolutions[] = { pv_ExtremeResolution, pv_HighResolution, pv_MidResolution, pv_LowResolution };
+			for (int i = 0; i < _countof(resolutions); ++i)
+			{
+				if (resolutions[i] < resolution)
+					return resolutions[i];
+			}
+			return pv_LowResolution;
+		}
+
+		// Degrades the config until it fits its memory budget, cheapest loss of quality first:
+		// pressure only responses (loses source directivity in stored mode), the shortest response length
+		// (shorter decay tail for rt60), then coarser resolutions. returns false if nothing fits
+		bool FitMemoryBudget(PlaneverbConfig* config)
+		{
+			const size_t budget = config->memoryBudget;
+			while (Context::GetMemoryRequirement(config) > budget)
+			{
+				const Real responseLength = (config->responseLengthInSeconds > (Real)0.f) ?
+					config->responseLengthInSeconds : PV_IMPULSE_RESPONSE_S;
+
+				if (config->analysisMode == pv_StoredResponseAnalysis && config->responseChannels != pv_ResponsePressureOnly)
+				{
+					config->responseChannels = pv_ResponsePressureOnly;
+				}
+				else if (responseLength > PV_MIN_IMPULSE_RESPONSE_S)
+				{
+					config->responseLengthInSeconds = PV_MIN_IMPULSE_RESPONSE_S;
+				}
+				else if (config->gridResolution > pv_LowResolution)
+				{
+					config->gridResolution = GetCoarserResolution(config->gridResolution);
+				}
+				else
+				{
+					return false;
+				}
+			}
+			return true;
+		}
 	} // namespace <>
 
+	size_t Context::GetMemoryRequirement(const PlaneverbConfig* config)
+	{
+		// baked probes only need emissions besides the probe file
+		if (config->bakedProbeFile != nullptr)
+		{
+			return sizeof(EmissionManager) + sizeof(ProbeSet) +
+				EmissionManager::GetMemoryRequirement(config) + ProbeSet::GetMemoryRequirement(config);
+		}
+
+		size_t systemSize = sizeof(GeometryManager) + sizeof(Grid) + sizeof(EmissionManager) +
+			sizeof(Analyzer) * config->listenerCount + sizeof(FreeGrid);
+		size_t internalSize = GeometryManager::GetMemoryRequirement(config) +
+			Grid::GetMemoryRequirement(config) +
+			EmissionManager::GetMemoryRequirement(config) +
+			Analyzer::GetMemoryRequirement(config) * config->listenerCount +
+			FreeGrid::GetMemoryRequirement(config);
+
+		// the free grid allocates and releases its own grid while the pool is alive
+		return systemSize + internalSize + FreeGrid::GetTemporaryMemoryRequirement(config);
+	}
+
 	Context::Context(const PlaneverbConfig * config) : 
-		m_backgroundProcessor(), m_isRunning(true)
+		m_backgroundProcessor(), m_isRunning(true), m_updateRequested(true), m_capturedPos(), m_cancelRequested(false), m_updateStats(), m_systemMem(nullptr), m_mem(nullptr),
+		m_grid(nullptr), m_geometry(nullptr), m_emissions(nullptr), m_analyzers(), m_freeGrid(nullptr), m_probes(nullptr)
 	{
 		// throw if input is invalid
 		if (config == nullptr || config->gridResolution < pv_LowResolution ||
 			config->gridSizeInMeters.x == 0 || config->gridSizeInMeters.y == 0 ||
 			config->tempFileDirectory == nullptr || 
-			config->maxThreadUsage < 0)
+			config->maxThreadUsage < 0 ||
+			config->responseLengthInSeconds < (Real)0.f ||
+			config->adaptiveDecayThresholdDB > (Real)0.f ||
+			config->listenerCount == 0 || config->listenerCount > PV_MAX_LISTENERS ||
+			config->listenerUpdateDistance < (Real)0.f || config->maxStalenessInSeconds < (Real)0.f ||
+			config->listenerCancelDistance < (Real)0.f ||
+			config->targetUpdateRate < (Real)0.f || !(config->maxCpuDutyCycle > (Real)0.f && config->maxCpuDutyCycle <= (Real)1.f))
 		{
 			throw pv_InvalidConfig;
 		}
@@ -109,14 +312,49 @@ namespace Planeverb
 		// copy config
 		std::memcpy(&m_config, config, sizeof(PlaneverbConfig));
 
+		// baked probes replace the simulation, only emissions are tracked and nothing runs in the background
+		if (m_config.bakedProbeFile != nullptr)
+		{
+			config = &m_config;
+			size_t size = sizeof(EmissionManager) + sizeof(ProbeSet) + EmissionManager::GetMemoryRequirement(config);
+			m_systemMem = new char[size];
+			if (m_systemMem == nullptr)
+			{
+				throw pv_NotEnoughMemory;
+			}
+			std::memset(m_systemMem, 0, size);
+			m_mem = m_systemMem + sizeof(EmissionManager) + sizeof(ProbeSet);
+
+			// the probe file is the part most likely to be bad, release the pool if it is
+			try
+			{
+				m_probes = new (m_systemMem + sizeof(EmissionManager)) ProbeSet(&m_config);
+			}
+			catch (...)
+			{
+				delete[] m_systemMem;
+				throw;
+			}
+			m_emissions = new (m_systemMem) EmissionManager(m_mem);
+			return;
+		}
+
+		// pick a cheaper config if this one doesn't fit the budget, every system below uses the copy
+		if (m_config.memoryBudget != 0 && !FitMemoryBudget(&m_config))
+		{
+			throw pv_NotEnoughMemory;
+		}
+		config = &m_config;
+
 		// determine size for context pool, throw if operator new fails
-		unsigned systemSize = sizeof(GeometryManager) + sizeof(Grid) + sizeof(EmissionManager) + sizeof(Analyzer) + sizeof(FreeGrid);
-		unsigned internalSize = GeometryManager::GetMemoryRequirement(config) +
+		size_t systemSize = sizeof(GeometryManager) + sizeof(Grid) + sizeof(EmissionManager) +
+			sizeof(Analyzer) * config->listenerCount + sizeof(FreeGrid);
+		size_t internalSize = GeometryManager::GetMemoryRequirement(config) +
 			Grid::GetMemoryRequirement(config) +
 			EmissionManager::GetMemoryRequirement(config) +
-			Analyzer::GetMemoryRequirement(config) +
+			Analyzer::GetMemoryRequirement(config) * config->listenerCount +
 			FreeGrid::GetMemoryRequirement(config);
-		unsigned size = systemSize + internalSize;
+		size_t size = systemSize + internalSize;
 		m_systemMem = new char[size];
 		if (m_systemMem == nullptr)
 		{
@@ -151,27 +389,153 @@ namespace Planeverb
 		tempSysMem += sizeof(FreeGrid);
 		tempPoolMem += FreeGrid::GetMemoryRequirement(config);
 
-		// placement new construct the analyzer
-		m_analyzer = new (tempSysMem) Analyzer(m_grid, m_freeGrid, tempPoolMem);
-		tempSysMem += sizeof(Analyzer);
-		tempPoolMem += Analyzer::GetMemoryRequirement(config);
+		// placement new construct an analyzer per listener
+		for (unsigned i = 0; i < config->listenerCount; ++i)
+		{
+			m_analyzers[i] = new (tempSysMem) Analyzer(m_grid, m_freeGrid, tempPoolMem, i);
+			tempSysMem += sizeof(Analyzer);
+			tempPoolMem += Analyzer::GetMemoryRequirement(config);
+		}
 
 		// start background thread after all systems are initialized
 		m_backgroundProcessor = std::thread(BackgroundProcessor, this);
 	}
 
+	void Context::SetListenerPosition(unsigned listener, const vec3& listenerPos)
+	{
+		if (listener >= m_config.listenerCount)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_scheduleMutex);
+			m_listenerPos[listener] = listenerPos;
+
+			// smaller moves wait for the results to go stale
+			const vec3& captured = m_capturedPos[listener];
+			const Real dx = listenerPos.x - captured.x;
+			const Real dy = listenerPos.y - captured.y;
+			const Real dz = listenerPos.z - captured.z;
+			const Real distance = m_config.listenerUpdateDistance;
+			const Real moved = dx * dx + dy * dy + dz * dz;
+			if (moved > distance * distance && !m_updateRequested)
+			{
+				m_updateRequested = true;
+				m_scheduleSignal.notify_one();
+			}
+
+			// far moves, like a teleport, make the update in flight pointless
+			const Real cancelDistance = m_config.listenerCancelDistance;
+			if (cancelDistance > (Real)0.f && moved > cancelDistance * cancelDistance)
+			{
+				m_cancelRequested.store(true, std::memory_order_relaxed);
+				if (!m_updateRequested)
+				{
+					m_updateRequested = true;
+					m_scheduleSignal.notify_one();
+				}
+			}
+		}
+
+		// baked probes are paged in along the listener's way
+		if (m_probes)
+			m_probes->UpdateListener(listener, listenerPos);
+	}
+
+	void Context::StopRunning()
+	{
+		std::lock_guard<std::mutex> lock(m_scheduleMutex);
+		m_isRunning = false;
+		m_cancelRequested.store(true, std::memory_order_relaxed);
+		m_scheduleSignal.notify_all();
+	}
+
+	void Context::RequestUpdate()
+	{
+		std::lock_guard<std::mutex> lock(m_scheduleMutex);
+		m_updateRequested = true;
+		if (m_config.cancelOnGeometryChange)
+			m_cancelRequested.store(true, std::memory_order_relaxed);
+		m_scheduleSignal.notify_one();
+	}
+
+	void Context::WaitForUpdate(std::chrono::steady_clock::time_point deadline)
+	{
+		std::unique_lock<std::mutex> lock(m_scheduleMutex);
+		auto isWoken = [this]() { return m_updateRequested || !m_isRunning; };
+		if (deadline == std::chrono::steady_clock::time_point::max())
+			m_scheduleSignal.wait(lock, isWoken);
+		else
+			m_scheduleSignal.wait_until(lock, deadline, isWoken);
+		m_updateRequested = false;
+	}
+
+	void Context::RestUntil(std::chrono::steady_clock::time_point time)
+	{
+		std::unique_lock<std::mutex> lock(m_scheduleMutex);
+		m_scheduleSignal.wait_until(lock, time, [this]() { return !m_isRunning; });
+	}
+
+	void Context::CaptureListenerPositions(vec3* positions)
+	{
+		std::lock_guard<std::mutex> lock(m_scheduleMutex);
+		for (unsigned i = 0; i < m_config.listenerCount; ++i)
+		{
+			positions[i] = m_listenerPos[i];
+			m_capturedPos[i] = m_listenerPos[i];
+		}
+		m_cancelRequested.store(false, std::memory_order_relaxed);
+	}
+
+	vec3 Context::GetListenerPosition(unsigned listener)
+	{
+		std::lock_guard<std::mutex> lock(m_scheduleMutex);
+		return m_listenerPos[listener];
+	}
+
+	void Context::RecordCompletedUpdate()
+	{
+		std::lock_guard<std::mutex> lock(m_scheduleMutex);
+		++m_updateStats.completedUpdates;
+	}
+
+	void Context::RecordCancelledUpdate(unsigned steps, Real seconds)
+	{
+		std::lock_guard<std::mutex> lock(m_scheduleMutex);
+		++m_updateStats.cancelledUpdates;
+		m_updateStats.wastedSteps += steps;
+		m_updateStats.wastedSeconds += seconds;
+	}
+
+	PlaneverbUpdateStats Context::GetUpdateStats()
+	{
+		std::lock_guard<std::mutex> lock(m_scheduleMutex);
+		return m_updateStats;
+	}
+
 	Context::~Context()
 	{
 		// stop the background thread
 		StopRunning();
-		m_backgroundProcessor.join();
+		if (m_backgroundProcessor.joinable())
+		{
+			m_backgroundProcessor.join();
+		}
 
 		// call dtor on all systems in reverse order
-		m_analyzer->~Analyzer();
-		m_emissions->~EmissionManager();
-		m_geometry->~GeometryManager();
-		m_grid->~Grid();
-		m_freeGrid->~FreeGrid();
+		if (m_probes)
+		{
+			m_probes->~ProbeSet();
+			m_emissions->~EmissionManager();
+		}
+		else
+		{
+			for (unsigned i = m_config.listenerCount; i > 0; --i)
+				m_analyzers[i - 1]->~Analyzer();
+			m_emissions->~EmissionManager();
+			m_geometry->~GeometryManager();
+			m_grid->~Grid();
+			m_freeGrid->~FreeGrid();
+		}
 
 		// delete pool
 		delete[] m_systemMem;
@@ -1,6 +1,10 @@
 #pragma once
 #include <PvTypes.h>	// vec3
 #include <thread>		// std::thread
+#include <atomic>		// std::atomic
+#include <mutex>		// std::mutex
+#include <condition_variable>	// std::condition_variable
+#include <chrono>		// std::chrono::steady_clock
 
 namespace Planeverb
 {
@@ -11,6 +15,7 @@ namespace Planeverb
 	class EmissionManager;
 	class Analyzer;
 	class FreeGrid;
+	class ProbeSet;
 
 	// Global context singleton that stores all systems
 	class Context
@@ -20,26 +25,57 @@ namespace Planeverb
 		Context(const PlaneverbConfig* config);
 		~Context();
 
+		// peak memory used by a context with this config, including the temporary free grid
+		static size_t GetMemoryRequirement(const PlaneverbConfig* config);
+
 		// getters
 		const PlaneverbConfig* GetConfig() const { return &m_config; }
 		Grid* GetGrid() { return m_grid; }
 		FreeGrid* GetFreeGrid() { return m_freeGrid; }
 		GeometryManager* GetGeometryManager() { return m_geometry; }
-		Analyzer* GetAnalyzer() { return m_analyzer; }
+		Analyzer* GetAnalyzer(unsigned listener = 0) { return (listener < m_config.listenerCount) ? m_analyzers[listener] : nullptr; }
 		EmissionManager* GetEmissionManager() { return m_emissions; }
+		ProbeSet* GetProbeSet() { return m_probes; }
 		bool IsRunning() const { return m_isRunning; }
-		const vec3& GetListenerPosition() const { return m_listenerPos; }
 
 		// setters
-		void StopRunning() { m_isRunning = false; }
-		void SetListenerPosition(const vec3& listenerPos) { m_listenerPos = listenerPos; }
+		void StopRunning();
+		void SetListenerPosition(const vec3& listenerPos) { SetListenerPosition(0, listenerPos); }
+		void SetListenerPosition(unsigned listener, const vec3& listenerPos);
+
+		// background thread scheduling. listener moves past the update distance and geometry edits request an update,
+		// the background thread waits for a request (or its deadline) and then captures the listener positions
+		void RequestUpdate();
+		void WaitForUpdate(std::chrono::steady_clock::time_point deadline);
+		void RestUntil(std::chrono::steady_clock::time_point time);
+		void CaptureListenerPositions(vec3* positions);
+
+		// copy of a listener's position read under the schedule lock, SetListenerPosition may be writing it
+		vec3 GetListenerPosition(unsigned listener = 0);
+
+		// set while the update in flight is outdated, listener moves past the cancel distance and geometry edits
+		// set it, CaptureListenerPositions clears it
+		const std::atomic<bool>* GetCancelFlag() const { return &m_cancelRequested; }
+
+		// update counters, kept by the background thread
+		void RecordCompletedUpdate();
+		void RecordCancelledUpdate(unsigned steps, Real seconds);
+		PlaneverbUpdateStats GetUpdateStats();
 		
 	private:
 		PlaneverbConfig m_config;			// copy of the input config
 		std::thread m_backgroundProcessor;	// background thread handle
-		bool m_isRunning = true;			// running flag used by thread
+		std::atomic<bool> m_isRunning;		// running flag used by thread
+
+		vec3 m_listenerPos[PV_MAX_LISTENERS];	// global listener positions
 
-		vec3 m_listenerPos;					// global listener position
+		// background thread scheduling
+		std::mutex m_scheduleMutex;			// guards the schedule and the listener positions
+		std::condition_variable m_scheduleSignal;	// wakes the background thread
+		bool m_updateRequested;				// something changed since the background thread last woke up
+		vec3 m_capturedPos[PV_MAX_LISTENERS];	// listener positions the background thread last picked up
+		std::atomic<bool> m_cancelRequested;	// the update in flight should stop
+		PlaneverbUpdateStats m_updateStats;	// background update counters
 
 		char* m_systemMem;
 		char* m_mem;						// all memory for systems stored linearly
@@ -53,11 +89,14 @@ namespace Planeverb
 		// emission manager
 		EmissionManager* m_emissions;		// emission manager handle
 
-		// response analyzer
-		Analyzer* m_analyzer;				// analyzer handle
+		// response analyzers
+		Analyzer* m_analyzers[PV_MAX_LISTENERS];	// analyzer handle per listener
 		
 		// free grid
 		FreeGrid* m_freeGrid;				// free grid handle
+
+		// baked probes, replace the grid, geometry, free grid and analyzers, which are nullptr then
+		ProbeSet* m_probes;					// probe set handle, nullptr when simulating
 	};
 
 	// Internal context singleton getter function
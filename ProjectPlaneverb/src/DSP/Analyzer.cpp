@@ -4,17 +4,96 @@
 #include <PvDefinitions.h>
 
 #include <omp.h>
+#include <emmintrin.h>
 #include <cmath>
 #include <iostream>
 #include <utility>
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <limits>
 
 namespace Planeverb
 {
+	namespace
+	{
+		// analysis threads for a thread usage setting, 0 uses every processor.
+		// fixed up front since every thread owns scratch memory in the pool
+		unsigned GetAnalysisThreadCount(unsigned maxThreadUsage)
+		{
+			return (maxThreadUsage == 0) ? (unsigned)std::max(omp_get_num_procs(), 1) : maxThreadUsage;
+		}
+
+		// decay curve scratch per thread, padded to whole SSE registers
+		size_t GetDecayCurveLength(unsigned responseLength)
+		{
+			return ((size_t)responseLength + 3) & ~(size_t)3;
+		}
+
+		// log2 of 4 positive normal floats, exponent plus a degree 5 polynomial of the mantissa.
+		// absolute error below 1e-4, which is 3e-4 dB on the decay curve
+		PV_FORCEINLINE __m128 FastLog2(__m128 x)
+		{
+			const __m128i bits = _mm_castps_si128(x);
+			const __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+			const __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+			__m128 p = _mm_set1_ps(0.0596515482674574969533f);
+			p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-0.465725644288844778798f));
+			p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(1.48116647521213171641f));
+			p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-2.52074962577807006663f));
+			p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(2.8882704548164776201f));
+			p = _mm_mul_ps(p, _mm_sub_ps(m, _mm_set1_ps(1.f)));
+			return _mm_add_ps(p, exponent);
+		}
+
+		PV_FORCEINLINE Real HorizontalSum(__m128 v)
+		{
+			const __m128 pairs = _mm_add_ps(v, _mm_movehl_ps(v, v));
+			return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+		}
+
+		// sum(y_i) and sum(x_i * y_i) of y_i = 10 * log10(curve[i]), x_i = i, i in [0, n).
+		// energies are clamped to the smallest normal float so silent tails don't produce -inf
+		void RegressDecayCurve(const Real* curve, int n, Real& ysum, Real& xysum)
+		{
+			const __m128 dBPerLog2 = _mm_set1_ps(3.01029995663981195f);	// 10 * log10(2)
+			const __m128 minEnergy = _mm_set1_ps(std::numeric_limits<Real>::min());
+			const __m128 four = _mm_set1_ps(4.f);
+			__m128 x = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+			__m128 ys = _mm_setzero_ps();
+			__m128 xys = _mm_setzero_ps();
+
+			int i = 0;
+			for (; i + 4 <= n; i += 4)
+			{
+				const __m128 y = _mm_mul_ps(dBPerLog2, FastLog2(_mm_max_ps(_mm_loadu_ps(curve + i), minEnergy)));
+				ys = _mm_add_ps(ys, y);
+				xys = _mm_add_ps(xys, _mm_mul_ps(x, y));
+				x = _mm_add_ps(x, four);
+			}
+
+			// remainder through the same approximation, padded with the last energy
+			if (i < n)
+			{
+				alignas(16) Real tail[4];
+				for (int k = 0; k < 4; ++k)
+					tail[k] = curve[std::min(i + k, n - 1)];
+				const __m128 valid = _mm_cmplt_ps(x, _mm_set1_ps((Real)n));
+				const __m128 y = _mm_and_ps(valid, _mm_mul_ps(dBPerLog2, FastLog2(_mm_max_ps(_mm_load_ps(tail), minEnergy))));
+				ys = _mm_add_ps(ys, y);
+				xys = _mm_add_ps(xys, _mm_mul_ps(x, y));
+			}
+
+			ysum = HorizontalSum(ys);
+			xysum = HorizontalSum(xys);
+		}
+	} // namespace <>
+
 	// allocate memory for analysis results
-	Analyzer::Analyzer(Grid * grid, FreeGrid* freeGrid, char* mem) :
-		m_mem(mem),	m_grid(grid), m_freeGrid(freeGrid), m_results(nullptr)
+	Analyzer::Analyzer(Grid * grid, FreeGrid* freeGrid, char* mem, unsigned listener) :
+		m_mem(mem), m_results(nullptr), m_frontGrid(0), m_epoch(0), m_streamState(nullptr), m_responseTiles(nullptr), m_decayCurves(nullptr),
+		m_grid(grid), m_freeGrid(freeGrid), m_listener(listener), EDryValues(nullptr), EFreeValues(nullptr)
 	{
 		// set up data
 		vec2i gridSize = m_grid->GetGridSize();
@@ -23,9 +102,15 @@ namespace Planeverb
 		m_responseLength = m_grid->GetResponseSize();
 		m_samplingRate = m_grid->GetSamplingRate();
 		m_dx = grid->GetDX();
-		m_numThreads = grid->GetMaxThreads();
+		m_numThreads = GetAnalysisThreadCount(grid->GetMaxThreads());
 		m_resolution = grid->GetResolution();
 
+		// analysis windows
+		m_directGainSamples = (int)(PV_DRY_GAIN_ANALYSIS_LENGTH * (Real)m_samplingRate);
+		m_sourceDirSamples = (int)(PV_DRY_DIRECTION_ANALYSIS_LENGTH * (Real)m_samplingRate);
+		m_wetGainSamples = (int)(PV_WET_GAIN_ANALYSIS_LENGTH * (Real)m_samplingRate);
+		m_schroederOffsetSamples = (int)(PV_SCHROEDER_OFFSET_S * m_samplingRate);
+
 		// find size for both grids, allocate pool of memory
 		/*unsigned size =
             (int)m_gridX * (int)m_gridY * sizeof(AnalyzerResult) +
@@ -36,13 +121,50 @@ namespace Planeverb
 		}
 
 		// set grid ptrs into pool
-		m_results = reinterpret_cast<AnalyzerResult*>(m_mem);
-		m_delaySamples = reinterpret_cast<Real*>(m_mem + (unsigned long long)m_gridX * (unsigned long long)m_gridY * sizeof(AnalyzerResult));
-
+		const size_t numCells = (size_t)m_gridX * (size_t)m_gridY;
+		char* temp = m_mem;
+		m_resultGrids[0] = reinterpret_cast<AnalyzerResult*>(temp);		temp += numCells * sizeof(AnalyzerResult);
+		m_resultGrids[1] = reinterpret_cast<AnalyzerResult*>(temp);		temp += numCells * sizeof(AnalyzerResult);
+		m_delayGrids[0] = reinterpret_cast<Real*>(temp);				temp += numCells * sizeof(Real);
+		m_delayGrids[1] = reinterpret_cast<Real*>(temp);				temp += numCells * sizeof(Real);
+		m_pathDistance = reinterpret_cast<Real*>(temp);					temp += numCells * sizeof(Real);
+		m_pathAnchor = reinterpret_cast<unsigned*>(temp);				temp += numCells * sizeof(unsigned);
+		m_pathHeap = reinterpret_cast<unsigned*>(temp);					temp += numCells * sizeof(unsigned);
+		m_pathHeapPosition = reinterpret_cast<unsigned*>(temp);			temp += numCells * sizeof(unsigned);
+
+#if PV_ANALYZER_DEBUG_VALUES
         //Debug
-        EDryValues = reinterpret_cast<float*>(m_mem + (unsigned long long)m_gridX * (unsigned long long)m_gridY * sizeof(AnalyzerResult) + (unsigned long long)m_gridX * (unsigned long long)m_gridY* sizeof(Real));
-        EFreeValues = reinterpret_cast<float*>(m_mem + (unsigned long long)m_gridX * (unsigned long long)m_gridY * sizeof(AnalyzerResult) + 
-            (unsigned long long)m_gridX * (unsigned long long)m_gridY * sizeof(Real) + (unsigned long long)m_gridX * (unsigned long long)m_gridY * sizeof(float));
+        EDryValues = reinterpret_cast<float*>(temp);					temp += numCells * sizeof(float);
+        EFreeValues = reinterpret_cast<float*>(temp);					temp += numCells * sizeof(float);
+#endif
+
+		// grid 0 is published first, zeroed like the rest of the pool. no cell has an onset yet
+		m_results = m_resultGrids[1];
+		m_delaySamples = m_delayGrids[1];
+		for (size_t i = 0; i < numCells; ++i)
+		{
+			m_delayGrids[0][i] = std::numeric_limits<Real>::max();
+			m_delayGrids[1][i] = std::numeric_limits<Real>::max();
+		}
+		m_gridSequence[0].store(0, std::memory_order_relaxed);
+		m_gridSequence[1].store(0, std::memory_order_relaxed);
+		m_gridEpoch[0].store(0, std::memory_order_relaxed);
+		m_gridEpoch[1].store(0, std::memory_order_relaxed);
+
+		// streaming state follows the delay (and debug) grids, the grid feeds it every time step
+		if (m_grid->GetAnalysisMode() == pv_StreamingAnalysis)
+		{
+			m_streamState = reinterpret_cast<StreamingAnalysisState*>(temp);
+			m_grid->SetStreamingAnalyzer(this, m_listener);
+		}
+		// otherwise responses are gathered a few cells at a time out of the grid's time-major cube,
+		// every analysis thread gets its own tile and decay curve
+		else
+		{
+			m_responseTiles = reinterpret_cast<Cell*>(temp);
+			temp += (size_t)m_numThreads * PV_ANALYZER_GATHER_CELLS * m_responseLength * sizeof(Cell);
+			m_decayCurves = reinterpret_cast<Real*>(temp);
+		}
 	}
 	Analyzer::~Analyzer()
 	{
@@ -50,15 +172,21 @@ namespace Planeverb
 		//delete[] m_mem;
 	}
 
-	void Analyzer::AnalyzeResponses(const vec3& listenerPosGiven)
+	void Analyzer::AnalyzeResponses(const vec3& listenerPos)
 	{
-		vec2i dim(m_gridX, m_gridY);
+		Analyze(listenerPos, nullptr);
+	}
 
-		// set OMP thread count
-		if (m_numThreads == 0)
-			omp_set_num_threads(omp_get_max_threads());
-		else
-			omp_set_num_threads(m_numThreads);
+	void Analyzer::AnalyzeChangedResponses(const vec3& listenerPos, const vec2i& changedFirst, const vec2i& changedLast)
+	{
+		const vec2i changedRegion[2] = { changedFirst, changedLast };
+		Analyze(listenerPos, changedRegion);
+	}
+
+	// analyzes every cell, or only the cells a change in changedRegion (first and last cell) can have reached
+	void Analyzer::Analyze(const vec3& listenerPosGiven, const vec2i* changedRegion)
+	{
+		vec2i dim(m_gridX, m_gridY);
 
         unsigned gridSize = (m_gridX) * (m_gridY);
 
@@ -66,58 +194,319 @@ namespace Planeverb
 		listenerPos.x += m_grid->GetGridOffset().x;
 		listenerPos.z += m_grid->GetGridOffset().y;
 
-		// reset delay values
-		Real* delayLooper = m_delaySamples;
-		Real maxVal = (Real)std::numeric_limits<Real>::max();
-		for (unsigned i = 0; i < gridSize; ++i)
-			*delayLooper++ = maxVal;
+		// a change only alters cells the pulse can reach through it within the simulated length.
+		// the listener cell is the one the grid simulated from
+		const unsigned simulatedSteps = m_grid->GetSimulatedResponseSize();
+		const unsigned stepsToChange = changedRegion ? m_grid->GetStepDistance(
+			vec2i((unsigned)(listenerPos.x / m_dx), (unsigned)(listenerPos.z / m_dx)), changedRegion[0], changedRegion[1]) : 0;
+		auto isAffected = [&](unsigned serialIndex)
+		{
+			if (!changedRegion)
+				return true;
+			vec2i gridIndex;
+			INDEX_TO_POS(gridIndex.x, gridIndex.y, serialIndex, dim);
+			return stepsToChange + m_grid->GetStepDistance(gridIndex, changedRegion[0], changedRegion[1]) <= simulatedSteps;
+		};
 
-        //Debug
-        float* temp_dry = EDryValues;
-        for (unsigned i = 0; i < gridSize; ++i)
-            *temp_dry++ = 0.0f;
+		// take the back grid, readers that still see it as front retry once the sequence is odd.
+		// cells without an onset keep their last value, so start from the published results
+		const unsigned front = m_frontGrid.load(std::memory_order_relaxed);
+		const unsigned back = 1u - front;
+		const unsigned sequence = m_gridSequence[back].load(std::memory_order_relaxed);
+		m_gridSequence[back].store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_results = m_resultGrids[back];
+		m_delaySamples = m_delayGrids[back];
+		std::memcpy(m_results, m_resultGrids[front], sizeof(AnalyzerResult) * gridSize);
+
+		// reset delay values, cells a change can't have reached keep theirs
+		if (changedRegion)
+		{
+			std::memcpy(m_delaySamples, m_delayGrids[front], sizeof(Real) * gridSize);
+		}
+		else
+		{
+			Real* delayLooper = m_delaySamples;
+			Real maxVal = (Real)std::numeric_limits<Real>::max();
+			for (unsigned i = 0; i < gridSize; ++i)
+				*delayLooper++ = maxVal;
+		}
 
+		// streaming mode already accumulated everything during the simulation
+		if (m_streamState)
+		{
+#pragma omp parallel for schedule(static) num_threads(m_numThreads)
+			for (int serialIndex = 0; serialIndex < (int)gridSize; ++serialIndex)
+			{
+				if (!isAffected((unsigned)serialIndex))
+					continue;
+				vec2i gridIndex;
+				INDEX_TO_POS(gridIndex.x, gridIndex.y, (unsigned)serialIndex, dim);
+				EncodeStreamedResponse((unsigned)serialIndex, gridIndex, listenerPos);
+			}
+		}
+		else
+		{
+#if PV_ANALYZER_DEBUG_VALUES
+			//Debug
+			if (!changedRegion)
+			{
+				std::memset(EDryValues, 0, sizeof(float) * gridSize);
+				std::memset(EFreeValues, 0, sizeof(float) * gridSize);
+			}
+#endif
+
+			// every cell is encoded independently, threads take whole tiles.
+			// cells without an onset bail early, so tiles are handed out dynamically
+			// an adaptive simulation may have stopped early, the rest of each response is silent
+			const unsigned numSamples = m_grid->GetSimulatedResponseSize();
+			const int numTiles = (int)((gridSize + PV_ANALYZER_GATHER_CELLS - 1) / PV_ANALYZER_GATHER_CELLS);
+			const size_t tileSize = PV_ANALYZER_GATHER_CELLS * (size_t)m_responseLength;
+#pragma omp parallel num_threads(m_numThreads)
+			{
+				Cell* responseTile = m_responseTiles + (size_t)omp_get_thread_num() * tileSize;
+				Real* decayCurve = m_decayCurves + (size_t)omp_get_thread_num() * GetDecayCurveLength(m_responseLength);
+
+#pragma omp for schedule(dynamic)
+				for (int tile = 0; tile < numTiles; ++tile)
+				{
+					// retrieve a tile of IRs, the cube is time-major so neighbouring cells are read together.
+					// tiles a change can't have reached aren't read at all
+					const unsigned tileStart = (unsigned)tile * PV_ANALYZER_GATHER_CELLS;
+					const unsigned tileCount = std::min(PV_ANALYZER_GATHER_CELLS, gridSize - tileStart);
+					bool affected[PV_ANALYZER_GATHER_CELLS];
+					bool anyAffected = false;
+					for (unsigned c = 0; c < tileCount; ++c)
+					{
+						affected[c] = isAffected(tileStart + c);
+						anyAffected = anyAffected || affected[c];
+					}
+					if (!anyAffected)
+						continue;
+					m_grid->GatherResponses(m_listener, tileStart, tileCount, responseTile);
+
+					for (unsigned c = 0; c < tileCount; ++c)
+					{
+						if (!affected[c])
+							continue;
+
+						// convert index to grid position
+						const unsigned serialIndex = tileStart + c;
+						vec2i gridIndex;
+						unsigned gridX, gridY;
+						INDEX_TO_POS(gridX, gridY, serialIndex, dim);
+						gridIndex.x = gridX;
+						gridIndex.y = gridY;
+
+						const Cell* response = responseTile + c * m_responseLength;
+
+						EncodeResponse(serialIndex, gridIndex, response, listenerPos, numSamples, decayCurve);
+					}
+				}
+			}
+		}
 
-        float* temp_Free = EFreeValues;
-        for (unsigned i = 0; i < gridSize; ++i)
-            *temp_Free++ = 0.0f;
+		// run a post processing step to find directions based off of delays, for the whole grid at once
+		EncodeListenerDirections(listenerPos);
 
-		// each type of analysis can be done in parallel
-		// each index can be done in parallel
-		
-//#pragma omp parallel for
-		for (unsigned serialIndex = 0; serialIndex < gridSize; ++serialIndex)
+		// publish the completed grid
+		const unsigned epoch = m_epoch.load(std::memory_order_relaxed) + 1;
+		m_gridEpoch[back].store(epoch, std::memory_order_relaxed);
+		m_gridSequence[back].store(sequence + 2, std::memory_order_release);
+		m_frontGrid.store(back, std::memory_order_release);
+		m_epoch.store(epoch, std::memory_order_release);
+	}
+
+	bool Analyzer::ReadResponseResult(const vec3& emitterPos, AnalyzerResult* out, unsigned* epoch) const
+	{
+		// retrieve analyzer result based off of an emitter position in world space
+		unsigned index;
+		GetResultIndices(&emitterPos, &index, 1);
+		if (index == PV_INVALID_RESULT_INDEX)
+			return false;
+
+		AnalyzerSnapshot snapshot;
+		AnalyzerResult result;
+		do
 		{
-			// convert index to grid position, to retrieve IR
-			vec2i gridIndex;
-			unsigned gridX, gridY;
-			INDEX_TO_POS(gridX, gridY, serialIndex, dim);
-			gridIndex.x = gridX;
-			gridIndex.y = gridY;
+			BeginRead(&snapshot);
+			result = snapshot.results[index];
+		} while (!EndRead(snapshot));
+
+		*out = result;
+		if (epoch)
+			*epoch = snapshot.epoch;
+		return true;
+	}
+
+	// sequence lock read: take the published grid once its sequence is even
+	void Analyzer::BeginRead(AnalyzerSnapshot* snapshot) const
+	{
+		for (;;)
+		{
+			const unsigned front = m_frontGrid.load(std::memory_order_acquire);
+			const unsigned sequence = m_gridSequence[front].load(std::memory_order_acquire);
+			if (sequence & 1u)
+				continue;
+
+			snapshot->results = m_resultGrids[front];
+			snapshot->delays = m_delayGrids[front];
+			snapshot->grid = front;
+			snapshot->sequence = sequence;
+			snapshot->epoch = m_gridEpoch[front].load(std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	// the copies are valid if the grid wasn't taken back by the writer meanwhile
+	bool Analyzer::EndRead(const AnalyzerSnapshot& snapshot) const
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return m_gridSequence[snapshot.grid].load(std::memory_order_relaxed) == snapshot.sequence;
+	}
+
+	namespace
+	{
+		// a * b for 4 unsigned lanes, SSE2 has no 32 bit mullo
+		PV_FORCEINLINE __m128i MultiplyLow(__m128i a, __m128i b)
+		{
+			const __m128i even = _mm_mul_epu32(a, b);
+			const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+			return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+		}
+	} // namespace <>
 
-			const Cell* response = m_grid->GetResponse(gridIndex);
+	// Same conversion as GetResponseResult. truncation puts (-1, 0) in cell 0 like the unsigned cast does,
+	// so the bounds are tested on the unrounded grid position
+	void Analyzer::GetResultIndices(const vec3* positions, unsigned* indices, size_t count) const
+	{
+		const auto& offset = m_grid->GetGridOffset();
+		const Real gridX = (Real)m_gridX;
+		const Real gridY = (Real)m_gridY;
+
+		const __m128 offsetX = _mm_set1_ps(offset.x);
+		const __m128 offsetY = _mm_set1_ps(offset.y);
+		const __m128 dx = _mm_set1_ps(m_dx);
+		const __m128 lower = _mm_set1_ps((Real)-1.f);
+		const __m128 upperX = _mm_set1_ps(gridX);
+		const __m128 upperY = _mm_set1_ps(gridY);
+		const __m128i rowLength = _mm_set1_epi32((int)m_gridY);
+		const __m128i invalid = _mm_set1_epi32((int)PV_INVALID_RESULT_INDEX);
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const vec3* p = positions + i;
+			const __m128 posX = _mm_div_ps(_mm_add_ps(_mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x), offsetX), dx);
+			const __m128 posY = _mm_div_ps(_mm_add_ps(_mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z), offsetY), dx);
+
+			const __m128 inside = _mm_and_ps(
+				_mm_and_ps(_mm_cmpgt_ps(posX, lower), _mm_cmplt_ps(posX, upperX)),
+				_mm_and_ps(_mm_cmpgt_ps(posY, lower), _mm_cmplt_ps(posY, upperY)));
+			const __m128i index = _mm_add_epi32(MultiplyLow(_mm_cvttps_epi32(posX), rowLength), _mm_cvttps_epi32(posY));
 
-            EncodeResponse(serialIndex, gridIndex, response, listenerPos, m_responseLength);
+			const __m128i mask = _mm_castps_si128(inside);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i), _mm_or_si128(_mm_and_si128(mask, index), _mm_andnot_si128(mask, invalid)));
 		}
 
-		// run a post processing step to find directions based off of delays
-		// can be run in parallel for each grid position
-		
-//#pragma omp parallel for
-		for (unsigned i = 0; i < gridSize; ++i)
+		for (; i < count; ++i)
+		{
+			const Real posX = (positions[i].x + offset.x) / m_dx;
+			const Real posY = (positions[i].z + offset.y) / m_dx;
+			const bool inside = posX > (Real)-1.f && posX < gridX && posY > (Real)-1.f && posY < gridY;
+			indices[i] = inside ? INDEX((unsigned)posX, (unsigned)posY, vec2i(m_gridX, m_gridY)) : PV_INVALID_RESULT_INDEX;
+		}
+	}
+
+	namespace
+	{
+		// normalized weighted sum of unit vectors, keeps the fallback when the vectors cancel out
+		vec2 NormalizeBlend(const vec2& sum, const vec2& fallback)
+		{
+			const Real length = std::sqrt(sum.x * sum.x + sum.y * sum.y);
+			if (length <= (Real)1e-6f)
+				return fallback;
+			return vec2(sum.x / length, sum.y / length);
+		}
+	} // namespace <>
+
+	// Cell results are sampled at the cell corners, so a position between cells x and x + 1 blends the two
+	// and lands exactly on the nearest cell lookup at whole cell positions.
+	// scalars blend linearly, directions blend on the unit circle (normalized weighted sum).
+	// cells outside the grid or without an onset (walls, unreached cells) get no weight
+	bool Analyzer::InterpolateResult(const AnalyzerSnapshot& snapshot, const vec3& position, AnalyzerResult* out) const
+	{
+		const auto& offset = m_grid->GetGridOffset();
+		const Real posX = (position.x + offset.x) / m_dx;
+		const Real posY = (position.z + offset.y) / m_dx;
+		if (!(posX > (Real)-1.f && posX < (Real)m_gridX && posY > (Real)-1.f && posY < (Real)m_gridY))
+			return false;
+
+		const int x0 = (int)std::floor(posX);
+		const int y0 = (int)std::floor(posY);
+		const Real fx = posX - (Real)x0;
+		const Real fy = posY - (Real)y0;
+
+		const int cellX[4] = { x0, x0 + 1, x0, x0 + 1 };
+		const int cellY[4] = { y0, y0, y0 + 1, y0 + 1 };
+		const Real weights[4] =
 		{
-			// retrieve IR
-            vec2i gridIndex;
-            unsigned gridX, gridY;
-            INDEX_TO_POS(gridX, gridY, i, dim);
-            gridIndex.x = gridX;
-            gridIndex.y = gridY;
+			((Real)1.f - fx) * ((Real)1.f - fy),
+			fx * ((Real)1.f - fy),
+			((Real)1.f - fx) * fy,
+			fx * fy
+		};
+
+		const Real maxDelay = std::numeric_limits<Real>::max();
+		const vec2i dim(m_gridX, m_gridY);
+		AnalyzerResult blend{};
+		Real totalWeight = 0.f;
+		Real strongestWeight = 0.f;
+		const AnalyzerResult* strongest = nullptr;
 
-			const Cell* response = m_grid->GetResponse(gridIndex);
+		for (int k = 0; k < 4; ++k)
+		{
+			if (weights[k] <= (Real)0.f || cellX[k] < 0 || cellY[k] < 0 || cellX[k] >= (int)m_gridX || cellY[k] >= (int)m_gridY)
+				continue;
+
+			const unsigned index = INDEX((unsigned)cellX[k], (unsigned)cellY[k], dim);
+			if (snapshot.delays[index] == maxDelay)
+				continue;
+
+			const AnalyzerResult& result = snapshot.results[index];
+			const Real w = weights[k];
+			blend.occlusion += w * result.occlusion;
+			blend.wetGain += w * result.wetGain;
+			blend.rt60 += w * result.rt60;
+			blend.lowpassIntensity += w * result.lowpassIntensity;
+			blend.direction.x += w * result.direction.x;
+			blend.direction.y += w * result.direction.y;
+			blend.sourceDirectivity.x += w * result.sourceDirectivity.x;
+			blend.sourceDirectivity.y += w * result.sourceDirectivity.y;
+			totalWeight += w;
+
+			if (w > strongestWeight)
+			{
+				strongestWeight = w;
+				strongest = &result;
+			}
+		}
 
-			// analyze for listener direction
-			m_results[i].direction = EncodeListenerDirection(i, response, listenerPos, m_responseLength);
+		// no usable neighbour, same as the nearest cell lookup
+		if (!strongest)
+		{
+			*out = snapshot.results[INDEX((unsigned)posX, (unsigned)posY, dim)];
+			return true;
 		}
+
+		const Real invWeight = (Real)1.f / totalWeight;
+		out->occlusion = blend.occlusion * invWeight;
+		out->wetGain = blend.wetGain * invWeight;
+		out->rt60 = blend.rt60 * invWeight;
+		out->lowpassIntensity = blend.lowpassIntensity * invWeight;
+		out->direction = NormalizeBlend(blend.direction, strongest->direction);
+		out->sourceDirectivity = NormalizeBlend(blend.sourceDirectivity, strongest->sourceDirectivity);
+		return true;
 	}
 
 	/*const*/ AnalyzerResult * Analyzer::GetResponseResult(const vec3 & emitterPos) const
@@ -126,9 +515,9 @@ namespace Planeverb
 		const auto& offset = m_grid->GetGridOffset();
 		unsigned posX = (unsigned)((emitterPos.x + offset.x) / m_dx); //(unsigned)(emitterPos.x + offset.x);
 		unsigned posY = (unsigned)((emitterPos.z + offset.y) / m_dx); //(unsigned)(emitterPos.z + offset.y);
-		if (posX > m_gridX || posY > m_gridY)
+		if (posX >= m_gridX || posY >= m_gridY)
 			return nullptr;
-		/*const*/ auto* res = &(m_results[INDEX(posX, posY, vec2i(m_gridX, m_gridY))]);
+		/*const*/ auto* res = &(m_resultGrids[m_frontGrid.load(std::memory_order_acquire)][INDEX(posX, posY, vec2i(m_gridX, m_gridY))]);
 		return res;
 	}
 
@@ -138,10 +527,10 @@ namespace Planeverb
         {
             return nullptr;
         }
-        return &m_results[index];
+        return &m_resultGrids[m_frontGrid.load(std::memory_order_acquire)][index];
     }
 
-	unsigned Analyzer::GetMemoryRequirement(const PlaneverbConfig * config)
+	size_t Analyzer::GetMemoryRequirement(const PlaneverbConfig * config)
 	{
 		Real m_dx, m_dt;
 		unsigned samplingRate;
@@ -151,23 +540,39 @@ namespace Planeverb
         m_gridSize.x = (unsigned)((1.f / m_dx) * config->gridSizeInMeters.x + 1);
         m_gridSize.y = (unsigned)((1.f / m_dx) * config->gridSizeInMeters.y + 1);
 
-		unsigned m_gridX = (unsigned)m_gridSize.x;
-		unsigned m_gridY = (unsigned)m_gridSize.y;
+		const size_t numCells = (size_t)m_gridSize.x * (size_t)m_gridSize.y;
 		
 		// find size for both grids, allocate pool of memory
-        unsigned size =
-            m_gridX * m_gridY * sizeof(AnalyzerResult) +
-            m_gridX * m_gridY * sizeof(Real);
+        size_t size =
+            numCells * sizeof(AnalyzerResult) * 2 +		// front and back result grids
+            numCells * sizeof(Real) * 2 +				// front and back delay grids
+            numCells * (sizeof(Real) + 3 * sizeof(unsigned));	// direction field distance, anchor and heap
 
 
+#if PV_ANALYZER_DEBUG_VALUES
         //Debug
-        size += m_gridX * m_gridY * sizeof(float)
-                + m_gridX * m_gridY * sizeof(float);
+        size += numCells * sizeof(float)
+                + numCells * sizeof(float);
+#endif
+
+		// running analysis state replaces the stored responses
+		if (config->analysisMode == pv_StreamingAnalysis)
+		{
+			size += numCells * sizeof(StreamingAnalysisState);
+		}
+		// gather tile and decay curve per analysis thread for the stored responses
+		else
+		{
+			const unsigned responseLength = CalculateResponseLength(config, samplingRate);
+			size += (size_t)GetAnalysisThreadCount(config->maxThreadUsage) *
+				(PV_ANALYZER_GATHER_CELLS * (size_t)responseLength * sizeof(Cell) + GetDecayCurveLength(responseLength) * sizeof(Real));
+		}
 
 		return size;
 	}
 
-    void Analyzer::EncodeResponse(unsigned serialIndex, vec2i gridIndex, const Cell* response, const vec3& listenerPos, unsigned n)
+    void Analyzer::EncodeResponse(unsigned serialIndex, vec2i gridIndex, const Cell* response, const vec3& listenerPos, unsigned n,
+		Real* decayCurve)
     {
         const int numSamples = (int)n;
 
@@ -179,12 +584,14 @@ namespace Planeverb
         {
             Real next = response[onsetSample].pr;
 
+#if PV_ANALYZER_DEBUG_VALUES
             //Debug
             if (onsetSample == 9)
             {
                 EDryValues[serialIndex] = (float)response[onsetSample].pr;
                 EFreeValues[serialIndex] = (float)onsetSample;
             }
+#endif
 
             if (std::abs(next) > PV_AUDIBLE_THRESHOLD_GAIN)
             {
@@ -206,20 +613,20 @@ namespace Planeverb
         // 
         // DRY PROCESSING: OBSTRUCTION and SOURCE DIRECTION
         //
-        int directGainSamples = (int)(PV_DRY_GAIN_ANALYSIS_LENGTH * (Real)m_samplingRate);
-        int sourceDirSamples = (int)(PV_DRY_DIRECTION_ANALYSIS_LENGTH * (Real)m_samplingRate);
+        int directGainSamples = m_directGainSamples;
+        int sourceDirSamples = m_sourceDirSamples;
         int sourceDirEnd = onsetSample + sourceDirSamples;
         int directEnd = onsetSample + directGainSamples;
 
         assert(sourceDirSamples <= directGainSamples && "Code below assumes source directivity is estimated on a shorter interval of time than dry gain.");
 
-        Real obstructionGain = 0.0f;
+        Real Edry = 0;
         vec2 radiationDir(0,0);
         {
-            Real Edry = 0;
-
+            // a late onset leaves part of the windows past the end of the response, which is silent
+            // (the next response in the gather tile follows it)
             int j = 0;
-            for (; j < sourceDirEnd; ++j)
+            for (; j < std::min(sourceDirEnd, numSamples); ++j)
             {
                 const auto& r = response[j];    
                 Edry += r.pr * r.pr;
@@ -227,57 +634,19 @@ namespace Planeverb
                 radiationDir.y += r.pr * r.vy;
             }
 
-            for (; j < directEnd; ++j)
+            for (; j < std::min(directEnd, numSamples); ++j)
             {
                 const auto& r = response[j];
                 Edry += r.pr * r.pr;
             }
-
-            // Normalize dry energy by free-space energy to obtain geometry-based 
-            // obstruction gain with distance attenuation factored out
-            Real EfreePr = 0.0f;
-            {
-                const int listenerX = (int)(listenerPos.x * (1.f / m_dx));
-                const int listenerY = (int)(listenerPos.z * (1.f / m_dx));
-                const int emitterX = gridIndex.x;
-                const int emitterY = gridIndex.y;
-
-                EfreePr = m_freeGrid->GetEFreePerR(listenerX, listenerY, emitterX, emitterY);
-            }
-
-            //Debug
-            /*EDryValues[serialIndex] = (float)onsetSample;
-            EFreeValues[serialIndex] = (float)numSamples;*/
-
-            Real E = (Edry / EfreePr);
-            obstructionGain = std::sqrt(E);
-
-            // Normalize and negate flux direction to obtain radiated unit vector
-            auto norm = std::sqrt(radiationDir.x*radiationDir.x + radiationDir.y*radiationDir.y);
-            norm = -1.0f / (norm > 0.0f ? norm : 1.0f);
-            radiationDir.x = norm * radiationDir.x;
-            radiationDir.y = norm * radiationDir.y;
         }
-        
-        m_results[serialIndex].occlusion = obstructionGain;
-        m_results[serialIndex].sourceDirectivity = radiationDir;
-
-        //
-        // LOW-PASS CUTOFF FREQUENCY
-        //
-
-        // get input distance driven by inverse of occlusion. If occlusion is very small, cap out at "lots of occlusion"
-        Real r = 1.0 / std::max(0.001f, obstructionGain);
-        // Find LPF cutoff frequency by feeding into equation: y = -147 + (18390) / (1 + (x / 12)^0.8 )
-        m_results[serialIndex].lowpassIntensity = 
-            (Real)-147.f + ((Real)18390.f) / ((Real)1.f + std::pow(r / (Real)12.f, (Real)0.8f));
 
         //
         // Wet gain
         //
         Real wetEnergy = 0.0f;
         {
-            const int wetGainSamples = (int)(PV_WET_GAIN_ANALYSIS_LENGTH * (Real)m_samplingRate);
+            const int wetGainSamples = m_wetGainSamples;
             const int end = std::min(directEnd + 1 + wetGainSamples, numSamples);
             for (int j = directEnd + 1; j < end; j++)
             {
@@ -286,12 +655,10 @@ namespace Planeverb
             }
         }
 
-        // Normalize as if source had unit energy at 1m distance
-        m_results[serialIndex].wetGain = std::sqrt(wetEnergy / m_freeGrid->GetEnergyAtOneMeter());
-
         //
         // Decay Time
         //
+        Real slopeDBperSample = 0.f;
         {
             // FIND THE T60 OF A SIGNAL
             //==========================
@@ -324,7 +691,7 @@ namespace Planeverb
 
             int startingPoint = directEnd + 1;
             // linear regression ignores some fixed bit of tail of energy decay curve which dips towards 0
-            int endPoint = numSamples - (int)(PV_SCHROEDER_OFFSET_S * m_samplingRate);
+            int endPoint = numSamples - m_schroederOffsetSamples;
             int regressN = endPoint - startingPoint;
             Real rn = Real(regressN);
 
@@ -338,7 +705,6 @@ namespace Planeverb
 
             // Backward energy integral
             Real energyDecayCurve = 0.f;
-            Real energyDecayCurveDB = 0.f;
             Real xysum = 0;
             Real ysum = 0;
 
@@ -349,27 +715,234 @@ namespace Planeverb
                 energyDecayCurve += p * p;
             }
 
+            // the running sum is serial, so the curve is integrated first (x_i = i - startingPoint)
+            // and converted to dB and regressed 4 samples at a time
             for (int i = endPoint-1; i >= startingPoint; --i)
             {
                 auto p = response[i].pr;
                 energyDecayCurve += p * p;
-                energyDecayCurveDB = 10.f * std::log10(energyDecayCurve);
-
-                Real y_i = energyDecayCurveDB;
-                auto x_i = (i - startingPoint);
-                xysum += y_i * x_i;
-                ysum += y_i;
+                decayCurve[i - startingPoint] = energyDecayCurve;
+            }
+            if (regressN > 0)
+            {
+                RegressDecayCurve(decayCurve, regressN, ysum, xysum);
             }
 
             Real ymean = ysum / rn;
             Real numerator = xysum - ymean * xsum - xmean * ysum + rn * xmean * ymean;
             
-            Real slopeDBperSample = numerator / denominator;
-            Real slopeDBperSec = slopeDBperSample * m_samplingRate;
-            m_results[serialIndex].rt60 = -60.f / slopeDBperSec;
+            slopeDBperSample = numerator / denominator;
         }
+
+        EncodeParameters(serialIndex, gridIndex, listenerPos, Edry, radiationDir, wetEnergy, slopeDBperSample);
     }
 
+	void Analyzer::BeginStreaming()
+	{
+		// reset running state, onset of -1 means not found yet
+		const unsigned gridSize = m_gridX * m_gridY;
+		StreamingAnalysisState initial{};
+		initial.onsetSample = -1;
+		std::fill(m_streamState, m_streamState + gridSize, initial);
+
+#if PV_ANALYZER_DEBUG_VALUES
+		//Debug
+		std::memset(EDryValues, 0, sizeof(float) * gridSize);
+		std::memset(EFreeValues, 0, sizeof(float) * gridSize);
+#endif
+	}
+
+	// Streaming equivalent of the accumulation loops in EncodeResponse.
+	// The dry, flux and wet sums are added in the same order as the stored path, so they match it exactly.
+	// The Schroeder integral can't be regressed until the tail is known, so the regression window is
+	// collected into PV_STREAMING_DECAY_BINS energy bins and regressed piecewise in EncodeStreamedResponse.
+	void Analyzer::AccumulateStep(unsigned t, const Real* pr, const Real* vx, const Real* vy, unsigned begin, unsigned end)
+	{
+		const int sample = (int)t;
+		const int endPoint = (int)m_responseLength - m_schroederOffsetSamples;
+
+		for (unsigned i = begin; i < end; ++i)
+		{
+			StreamingAnalysisState& state = m_streamState[i];
+			const Real p = pr[i];
+
+			// onset delay
+			if (state.onsetSample < 0)
+			{
+#if PV_ANALYZER_DEBUG_VALUES
+				//Debug
+				if (sample == 9)
+				{
+					EDryValues[i] = (float)p;
+					EFreeValues[i] = (float)sample;
+				}
+#endif
+
+				if (std::abs(p) > PV_AUDIBLE_THRESHOLD_GAIN)
+				{
+					state.onsetSample = sample;
+				}
+			}
+
+			// dry energy and flux, everything before the onset is part of the dry window too
+			const int onset = state.onsetSample;
+			if (onset < 0 || sample < onset + m_sourceDirSamples)
+			{
+				state.dryEnergy += p * p;
+				state.flux.x += p * vx[i];
+				state.flux.y += p * vy[i];
+				continue;
+			}
+			const int directEnd = onset + m_directGainSamples;
+			if (sample < directEnd)
+			{
+				state.dryEnergy += p * p;
+				continue;
+			}
+
+			// wet energy
+			const int startingPoint = directEnd + 1;
+			if (sample >= startingPoint && sample < startingPoint + m_wetGainSamples)
+			{
+				state.wetEnergy += p * p;
+			}
+
+			// decay energy, binned over the regression window
+			if (sample >= endPoint)
+			{
+				state.tailEnergy += p * p;
+			}
+			else if (sample >= startingPoint)
+			{
+				const int regressN = endPoint - startingPoint;
+				const int binWidth = (regressN + (int)PV_STREAMING_DECAY_BINS - 1) / (int)PV_STREAMING_DECAY_BINS;
+				state.decayEnergy[(sample - startingPoint) / binWidth] += p * p;
+			}
+		}
+	}
+
+	void Analyzer::EncodeStreamedResponse(unsigned serialIndex, vec2i gridIndex, const vec3& listenerPos)
+	{
+		const StreamingAnalysisState& state = m_streamState[serialIndex];
+
+		//no onset found, fill infinity and bail, can't encode anything else.
+		if (state.onsetSample < 0)
+		{
+			m_delaySamples[serialIndex] = std::numeric_limits<Real>::max();
+			return;
+		}
+		m_delaySamples[serialIndex] = (Real)state.onsetSample;
+
+		//
+		// Decay Time
+		//
+		// Same regression as EncodeResponse, but the energy decay curve is only known at the bin edges.
+		// Inside each bin the curve (in dB) is taken as linear between its edges, which gives closed forms
+		// for the bin's contribution to sum(y_i) and sum(x_i * y_i).
+		// Bins are laid out over the full response length. if the simulation stopped early the window
+		// ends at the simulated length instead, bins past it become part of the tail
+		const int startingPoint = state.onsetSample + m_directGainSamples + 1;
+		const int endPoint = (int)m_grid->GetSimulatedResponseSize() - m_schroederOffsetSamples;
+		const int regressN = endPoint - startingPoint;
+		const int binnedN = (int)m_responseLength - m_schroederOffsetSamples - startingPoint;
+		Real slopeDBperSample = -std::numeric_limits<Real>::infinity(); // no decay window, reports an rt60 of 0
+		if (regressN > 1)
+		{
+			const int binWidth = (binnedN + (int)PV_STREAMING_DECAY_BINS - 1) / (int)PV_STREAMING_DECAY_BINS;
+			const double minEnergy = (double)std::numeric_limits<Real>::min();
+			double energyDecayCurve = (double)state.tailEnergy;
+			double xysum = 0.0;
+			double ysum = 0.0;
+
+			// integrate backwards, bin by bin
+			for (int bin = (int)PV_STREAMING_DECAY_BINS - 1; bin >= 0; --bin)
+			{
+				const int a = bin * binWidth;
+				const int b = std::min(a + binWidth, regressN);
+				if (a >= regressN)
+				{
+					energyDecayCurve += (double)state.decayEnergy[bin];
+					continue;
+				}
+
+				const double yEnd = 10.0 * std::log10(std::max(energyDecayCurve, minEnergy));
+				energyDecayCurve += (double)state.decayEnergy[bin];
+				const double yStart = 10.0 * std::log10(std::max(energyDecayCurve, minEnergy));
+
+				const double n = (double)(b - a);
+				const double slope = (yEnd - yStart) / n;
+				const double sumU = n * (n - 1.0) * 0.5;					// sum of (x - a)
+				const double sumU2 = (n - 1.0) * n * (2.0 * n - 1.0) / 6.0;	// sum of (x - a)^2
+				ysum += n * yStart + slope * sumU;
+				xysum += yStart * (n * a + sumU) + slope * (a * sumU + sumU2);
+			}
+
+			const double rn = (double)regressN;
+			const double xmean = (rn - 1.0) * 0.5;
+			const double xsum = rn * xmean;
+			const double denominator = (1.0 / 12.0) * rn * (rn * rn - 1.0);
+			const double ymean = ysum / rn;
+			const double numerator = xysum - ymean * xsum - xmean * ysum + rn * xmean * ymean;
+			slopeDBperSample = (Real)(numerator / denominator);
+		}
+
+		EncodeParameters(serialIndex, gridIndex, listenerPos, state.dryEnergy, state.flux, state.wetEnergy, slopeDBperSample);
+	}
+
+	void Analyzer::EncodeParameters(unsigned serialIndex, vec2i gridIndex, const vec3& listenerPos,
+		Real Edry, vec2 radiationDir, Real wetEnergy, Real slopeDBperSample)
+	{
+		Real obstructionGain = 0.0f;
+		{
+			// Normalize dry energy by free-space energy to obtain geometry-based 
+			// obstruction gain with distance attenuation factored out
+			Real EfreePr = 0.0f;
+			{
+				const int listenerX = (int)(listenerPos.x * (1.f / m_dx));
+				const int listenerY = (int)(listenerPos.z * (1.f / m_dx));
+				const int emitterX = gridIndex.x;
+				const int emitterY = gridIndex.y;
+
+				EfreePr = m_freeGrid->GetEFreePerR(listenerX, listenerY, emitterX, emitterY);
+			}
+
+			Real E = (Edry / EfreePr);
+			obstructionGain = std::sqrt(E);
+
+			// Normalize and negate flux direction to obtain radiated unit vector
+			auto norm = std::sqrt(radiationDir.x*radiationDir.x + radiationDir.y*radiationDir.y);
+			norm = -1.0f / (norm > 0.0f ? norm : 1.0f);
+			radiationDir.x = norm * radiationDir.x;
+			radiationDir.y = norm * radiationDir.y;
+		}
+
+		m_results[serialIndex].occlusion = obstructionGain;
+		m_results[serialIndex].sourceDirectivity = radiationDir;
+
+		//
+		// LOW-PASS CUTOFF FREQUENCY
+		//
+
+		// get input distance driven by inverse of occlusion. If occlusion is very small, cap out at "lots of occlusion"
+		Real r = 1.0 / std::max(0.001f, obstructionGain);
+		// Find LPF cutoff frequency by feeding into equation: y = -147 + (18390) / (1 + (x / 12)^0.8 )
+		m_results[serialIndex].lowpassIntensity = 
+			(Real)-147.f + ((Real)18390.f) / ((Real)1.f + std::pow(r / (Real)12.f, (Real)0.8f));
+
+		//
+		// Wet gain
+		//
+
+		// Normalize as if source had unit energy at 1m distance
+		m_results[serialIndex].wetGain = std::sqrt(wetEnergy / m_freeGrid->GetEnergyAtOneMeter());
+
+		//
+		// Decay Time
+		//
+		Real slopeDBperSec = slopeDBperSample * m_samplingRate;
+		m_results[serialIndex].rt60 = -60.f / slopeDBperSec;
+	}
+
 	namespace
 	{
 		static const std::pair<int, int> POSSIBLE_NEIGHBORS[] = 
@@ -378,98 +951,208 @@ namespace Planeverb
 			{0, -1},				{0, 1},
 			{1, -1},	{1, 0},		{1, 1}
 		};
-	} // namespace <>
 
-    vec2 Analyzer::EncodeListenerDirection(unsigned index, const Cell * response, const vec3& listenerPos, unsigned numSamples)
-    {
-        Real loudness = m_results[index].occlusion;
-        vec2i dim(m_gridX, m_gridY);
-        int nextIndex = index;
-        const constexpr Real maxDelay = std::numeric_limits<Real>::max();
-        Real delay = maxDelay;
-        Real nextDelay = maxDelay;
-        Real samplingRate = (Real)m_samplingRate;
-        Real wavelength = PV_C / (Real)m_resolution;
-        const Real threshold = (Real)0.3f;
-        Real thresholdDist = threshold * wavelength;
-
-        // loop while not close to the listener
-        while (delay > PV_DELAY_CLOSE_THRESHOLD && loudness < PV_DISTANCE_GAIN_THRESHOLD)
-        {
-            int r, c;
-            INDEX_TO_POS(r, c, nextIndex, dim);
-            Real nextLoudness = 0.f;
-            Real nextDelay = maxDelay;
+		const constexpr Real PV_SQRT2 = (Real)1.41421356f;
 
-            // for each neighbor find the neighbor with the smallest delay time
-            for (int i = 0; i < _countof(POSSIBLE_NEIGHBORS); ++i)
-            {
-                int nr = r + POSSIBLE_NEIGHBORS[i].first;
-                int nc = c + POSSIBLE_NEIGHBORS[i].second;
-                if (nr < 0 || nc < 0 || nr >= (int)dim.x || nc >= (int)dim.y)
-                    continue;
-
-                int newPosIndex = INDEX(nr, nc, dim);
-                auto& result = m_results[newPosIndex];
-                Real delay = m_delaySamples[newPosIndex];
-                if ((unsigned)delay == numSamples || result.occlusion == 0.f)
-                    continue;
-                else if (delay < nextDelay && result.occlusion > 0.f)
-                {
-                    nextLoudness = result.occlusion;
-                    nextIndex = newPosIndex;
-                    nextDelay = delay;
-                }
-            }
+		// Indexed binary min heap of cells keyed by their path distance, ties broken by index so the
+		// direction field doesn't depend on insertion order. position[cell] is the cell's heap slot,
+		// PV_INVALID_RESULT_INDEX while it isn't queued
+		struct CellHeap
+		{
+			unsigned* heap;
+			unsigned* position;
+			const Real* key;
+			unsigned size;
+
+			bool Less(unsigned a, unsigned b) const
+			{
+				return key[a] < key[b] || (key[a] == key[b] && a < b);
+			}
+
+			void Place(unsigned slot, unsigned cell)
+			{
+				heap[slot] = cell;
+				position[cell] = slot;
+			}
+
+			void SiftUp(unsigned slot)
+			{
+				const unsigned cell = heap[slot];
+				while (slot > 0)
+				{
+					const unsigned parent = (slot - 1) / 2;
+					if (!Less(cell, heap[parent]))
+						break;
+					Place(slot, heap[parent]);
+					slot = parent;
+				}
+				Place(slot, cell);
+			}
+
+			void SiftDown(unsigned slot)
+			{
+				const unsigned cell = heap[slot];
+				for (;;)
+				{
+					unsigned child = 2 * slot + 1;
+					if (child >= size)
+						break;
+					if (child + 1 < size && Less(heap[child + 1], heap[child]))
+						++child;
+					if (!Less(heap[child], cell))
+						break;
+					Place(slot, heap[child]);
+					slot = child;
+				}
+				Place(slot, cell);
+			}
+
+			// insert, or move up after the key decreased
+			void Update(unsigned cell)
+			{
+				if (position[cell] == PV_INVALID_RESULT_INDEX)
+				{
+					Place(size, cell);
+					++size;
+				}
+				SiftUp(position[cell]);
+			}
+
+			unsigned Pop()
+			{
+				const unsigned top = heap[0];
+				position[top] = PV_INVALID_RESULT_INDEX;
+				if (--size > 0)
+				{
+					heap[0] = heap[size];
+					SiftDown(0);
+				}
+				return top;
+			}
+		};
+	} // namespace <>
 
-            // case couldn't find a valid neighbor
-            if (nextDelay == std::numeric_limits<Real>::max() || nextDelay >= delay)
-            {
-                break;
-            }
+	// Dijkstra sweep over the grid seeded at the listener cell. Cells with an onset are nodes, neighbours
+	// (8-connected, diagonals only between two open cells) are edges weighted by their distance.
+	// Cells get settled in path distance order, so a cell's predecessor is final before the cell itself,
+	// and each cell's anchor - the first cell on its path back to the listener that the direct sound
+	// reaches - is resolved in O(1) from its predecessor's. O(cells log cells) for the whole grid.
+	// A cell is its own anchor if it's loud (close) enough, its onset is close, or its onset delay
+	// matches the straight line distance to the listener (line of sight).
+	// Directions point from the listener to the anchor, cells the sweep can't reach point to themselves.
+	void Analyzer::EncodeListenerDirections(const vec3& listenerPos)
+	{
+		const vec2i dim(m_gridX, m_gridY);
+		const unsigned gridSize = m_gridX * m_gridY;
+		const constexpr Real maxDelay = std::numeric_limits<Real>::max();
+		const Real infinity = std::numeric_limits<Real>::infinity();
+		const Real samplingRate = (Real)m_samplingRate;
+		const Real wavelength = PV_C / (Real)m_resolution;
+		const Real threshold = (Real)0.3f;
+		const Real thresholdDist = threshold * wavelength;
+
+		// open cells carry sound, walls and unreached cells have no onset
+		auto isOpen = [&](unsigned index)
+		{
+			return m_delaySamples[index] != maxDelay && m_results[index].occlusion > 0.f;
+		};
 
-            delay = nextDelay;
-            loudness = nextLoudness;
-
-            // line of sight check
-            Real geodesicDist = PV_C * nextDelay / samplingRate;
-            int r2, c2;
-            INDEX_TO_POS(r2, c2, nextIndex, dim);
-
-            // convert grid position to worldspace
-            Real ex = (Real)r2 * m_dx;
-            Real ey = (Real)c2 * m_dx;
-
-            // find vector between and normalize
-            vec2 temp(ex - listenerPos.x, ey - listenerPos.z);
-            Real euclideanDist = (temp.x * temp.x) + (temp.y * temp.y);;
-            euclideanDist = std::sqrt(euclideanDist);
-            Real distCheck = std::abs(geodesicDist - euclideanDist);
-            bool isInLineOfSight = distCheck < thresholdDist;
-            if (isInLineOfSight)
-                break;
-        }
+		auto isAnchor = [&](unsigned index)
+		{
+			const Real delay = m_delaySamples[index];
+			if (delay <= PV_DELAY_CLOSE_THRESHOLD || m_results[index].occlusion >= PV_DISTANCE_GAIN_THRESHOLD)
+				return true;
+
+			// line of sight check
+			int r, c;
+			INDEX_TO_POS(r, c, index, dim);
+			const Real geodesicDist = PV_C * delay / samplingRate;
+			const Real ex = (Real)r * m_dx - listenerPos.x;
+			const Real ey = (Real)c * m_dx - listenerPos.z;
+			const Real euclideanDist = std::sqrt(ex * ex + ey * ey);
+			return std::abs(geodesicDist - euclideanDist) < thresholdDist;
+		};
 
-        // find direction vector between nextIndex and listener position
+		// every cell starts unreached and anchored to itself
+		for (unsigned i = 0; i < gridSize; ++i)
+		{
+			m_pathDistance[i] = infinity;
+			m_pathAnchor[i] = i;
+			m_pathHeapPosition[i] = PV_INVALID_RESULT_INDEX;
+		}
 
-        // convert 1D index to 2D grid position
-        int r, c;
-        INDEX_TO_POS(r, c, nextIndex, dim);
+		CellHeap queue = { m_pathHeap, m_pathHeapPosition, m_pathDistance, 0 };
 
-        // convert grid position to worldspace
-        Real ex = (Real)r * m_dx;
-        Real ey = (Real)c * m_dx;
+		// seed at the listener's cell, which may be inside geometry
+		const int listenerX = std::min(std::max((int)(listenerPos.x / m_dx), 0), (int)m_gridX - 1);
+		const int listenerY = std::min(std::max((int)(listenerPos.z / m_dx), 0), (int)m_gridY - 1);
+		const unsigned seed = INDEX((unsigned)listenerX, (unsigned)listenerY, dim);
+		m_pathDistance[seed] = 0.f;
+		queue.Update(seed);
 
-        // find vector between and normalize
-        vec2 output(ex - listenerPos.x, ey - listenerPos.z);
-        Real length = (output.x * output.x) + (output.y * output.y);
-        if (length != 0.f)
-        {
-            length = std::sqrt(length);
-            output.x /= length;
-            output.y /= length;
-        }
+		while (queue.size > 0)
+		{
+			const unsigned index = queue.Pop();
+
+			// predecessor (stored in the anchor grid while queued) is settled, inherit its anchor
+			const unsigned predecessor = m_pathAnchor[index];
+			if (index != seed && !isAnchor(index))
+				m_pathAnchor[index] = m_pathAnchor[predecessor];
+			else
+				m_pathAnchor[index] = index;
+
+			int r, c;
+			INDEX_TO_POS(r, c, index, dim);
+			for (int i = 0; i < (int)_countof(POSSIBLE_NEIGHBORS); ++i)
+			{
+				const int dr = POSSIBLE_NEIGHBORS[i].first;
+				const int dc = POSSIBLE_NEIGHBORS[i].second;
+				const int nr = r + dr;
+				const int nc = c + dc;
+				if (nr < 0 || nc < 0 || nr >= (int)dim.x || nc >= (int)dim.y)
+					continue;
+
+				const unsigned neighbour = INDEX(nr, nc, dim);
+				if (!isOpen(neighbour))
+					continue;
+
+				// no corner cutting through walls
+				const bool diagonal = (dr != 0 && dc != 0);
+				if (diagonal && !(isOpen(INDEX(nr, c, dim)) && isOpen(INDEX(r, nc, dim))))
+					continue;
+
+				const Real distance = m_pathDistance[index] + (diagonal ? PV_SQRT2 : (Real)1.f);
+				if (distance < m_pathDistance[neighbour])
+				{
+					m_pathDistance[neighbour] = distance;
+					m_pathAnchor[neighbour] = index;
+					queue.Update(neighbour);
+				}
+			}
+		}
 
-        return output;
-    }
+		// directions from the listener to each cell's anchor
+#pragma omp parallel for schedule(static) num_threads(m_numThreads)
+		for (int i = 0; i < (int)gridSize; ++i)
+		{
+			// convert 1D index to 2D grid position
+			int r, c;
+			INDEX_TO_POS(r, c, m_pathAnchor[i], dim);
+
+			// convert grid position to worldspace
+			Real ex = (Real)r * m_dx;
+			Real ey = (Real)c * m_dx;
+
+			// find vector between and normalize
+			vec2 output(ex - listenerPos.x, ey - listenerPos.z);
+			Real length = (output.x * output.x) + (output.y * output.y);
+			if (length != 0.f)
+			{
+				length = std::sqrt(length);
+				output.x /= length;
+				output.y /= length;
+			}
+			m_results[i].direction = output;
+		}
+	}
 } // namespace Planeverb
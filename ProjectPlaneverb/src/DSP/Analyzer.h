@@ -1,6 +1,7 @@
 #pragma once
 
 #include <PvTypes.h>	// vec2, vec3, Real
+#include <atomic>
 
 namespace Planeverb
 {
@@ -20,42 +21,124 @@ namespace Planeverb
 		vec2 sourceDirectivity;
 	};
 
+	// Published result grid captured by Analyzer::BeginRead
+	struct AnalyzerSnapshot
+	{
+		const AnalyzerResult* results;	// published grid
+		const Real* delays;				// onset delays of the published grid, max Real where no onset was found
+		unsigned grid;					// which of the two grids
+		unsigned sequence;				// grid sequence when the snapshot was taken
+		unsigned epoch;					// analysis that produced the grid
+	};
+
+	// result index of positions outside the grid
+	const constexpr unsigned PV_INVALID_RESULT_INDEX = (unsigned)(-1);
+
+	// number of energy bins kept per cell for the streaming Schroeder integration
+	const constexpr unsigned PV_STREAMING_DECAY_BINS = 32;
+
+	// number of consecutive cells gathered out of the stored response cube at once, one cache line of pressure
+	const constexpr unsigned PV_ANALYZER_GATHER_CELLS = 16;
+
+	// Running per-cell analysis state used in streaming mode, replaces the stored impulse response
+	struct StreamingAnalysisState
+	{
+		int onsetSample;							// first sample above the audible threshold, -1 until found
+		Real dryEnergy;								// energy up to the end of the direct sound
+		vec2 flux;									// pressure * velocity up to the end of the source direction window
+		Real wetEnergy;								// energy of the early reflections
+		Real tailEnergy;							// energy after the Schroeder regression window
+		Real decayEnergy[PV_STREAMING_DECAY_BINS];	// energy of the regression window, binned in time
+	};
+
 	// Analyzes acoustic grid IR output
 	class Analyzer
 	{
 	public:
-		Analyzer(Grid* grid, FreeGrid* freeGrid, char* mem);
+		// analyzes the responses of one of the grid's listeners
+		Analyzer(Grid* grid, FreeGrid* freeGrid, char* mem, unsigned listener = 0);
 		~Analyzer();
 
         void AnalyzeResponses(const vec3& listenerPos);
+
+		// re-encodes only the cells that geometry changed inside the box [changedFirst, changedLast] can have reached,
+		// every other cell keeps its published result. matches a full analysis as long as the listener position and
+		// simulated length are the ones the published results were analyzed with
+		void AnalyzeChangedResponses(const vec3& listenerPos, const vec2i& changedFirst, const vec2i& changedLast);
+
+		// streaming analysis, called by the grid while it simulates
+		void BeginStreaming();
+		void AccumulateStep(unsigned t, const Real* pr, const Real* vx, const Real* vy, unsigned begin, unsigned end);
+
+		// Results are double buffered. AnalyzeResponses writes the back grid and publishes it when complete.
+		// ReadResponseResult copies out of the published grid without locking and is safe while an analysis runs,
+		// the pointer getters read the published grid directly and should only be used between analyses
+		bool ReadResponseResult(const vec3& emitterPos, AnalyzerResult* out, unsigned* epoch) const;
+
+		// Batched lock-free reads: everything read through the snapshot between BeginRead and a successful
+		// EndRead comes from the same analysis. EndRead fails if the writer took the grid back meanwhile,
+		// in which case the reads must be redone
+		void BeginRead(AnalyzerSnapshot* snapshot) const;
+		bool EndRead(const AnalyzerSnapshot& snapshot) const;
+
+		// world space positions to result indices, PV_INVALID_RESULT_INDEX outside the grid. 4 at a time with SSE2
+		void GetResultIndices(const vec3* positions, unsigned* indices, size_t count) const;
+
+		// bilinear blend of the four cells around a world space position, false outside the grid
+		bool InterpolateResult(const AnalyzerSnapshot& snapshot, const vec3& position, AnalyzerResult* out) const;
 		/*const*/ AnalyzerResult* GetResponseResult(const vec3& emitterPos) const;
 		AnalyzerResult* GetResponseByIndex(unsigned index);
-		static unsigned GetMemoryRequirement(const struct PlaneverbConfig* config);
+		unsigned GetEpoch() const { return m_epoch.load(std::memory_order_acquire); }
+		static size_t GetMemoryRequirement(const struct PlaneverbConfig* config);
 		unsigned GetGridX() { return m_gridX; }
 		unsigned GetGridY() { return m_gridY; }
 
-		//Debug
-		float GetEDry(unsigned index) { return EDryValues[index]; }
-		float GetEFree(unsigned index) { return EFreeValues[index]; }
+		//Debug, only recorded when PV_ANALYZER_DEBUG_VALUES is set
+		float GetEDry(unsigned index) { return EDryValues ? EDryValues[index] : 0.f; }
+		float GetEFree(unsigned index) { return EFreeValues ? EFreeValues[index] : 0.f; }
 
 	private:
-        void EncodeResponse(unsigned serialIndex, vec2i gridIndex, const Cell* response, const vec3& listenerPos, unsigned numSamples);
-		vec2 EncodeListenerDirection(unsigned index, const Cell* response, const vec3& listenerPos, unsigned numSamples);
+		void Analyze(const vec3& listenerPos, const vec2i* changedRegion);
+        void EncodeResponse(unsigned serialIndex, vec2i gridIndex, const Cell* response, const vec3& listenerPos, unsigned numSamples,
+			Real* decayCurve);
+		void EncodeStreamedResponse(unsigned serialIndex, vec2i gridIndex, const vec3& listenerPos);
+		void EncodeParameters(unsigned serialIndex, vec2i gridIndex, const vec3& listenerPos,
+			Real Edry, vec2 radiationDir, Real wetEnergy, Real slopeDBperSample);
+		void EncodeListenerDirections(const vec3& listenerPos);
 		char* m_mem;				// pool of memory
-		AnalyzerResult* m_results;	// 2D grid using 1D memory, grid of results
-		Real* m_delaySamples;		// grid of delay, to be used to find direction
+		AnalyzerResult* m_results;	// 2D grid using 1D memory, grid of results being written (back grid)
+		AnalyzerResult* m_resultGrids[2];				// front and back result grids
+		std::atomic<unsigned> m_frontGrid;				// index of the published grid
+		std::atomic<unsigned> m_gridSequence[2];		// odd while a grid is being written, readers retry on change
+		std::atomic<unsigned> m_gridEpoch[2];			// epoch that produced each grid
+		std::atomic<unsigned> m_epoch;					// number of published analyses, 0 until the first one
+		StreamingAnalysisState* m_streamState;	// per-cell running analysis, streaming mode only
+		Cell* m_responseTiles;		// responses gathered from the grid, one tile per analysis thread, stored mode only
+		Real* m_decayCurves;		// backward energy integral scratch, one per analysis thread, stored mode only
+		Real* m_delaySamples;		// grid of delay, to be used to find direction (back grid)
+		Real* m_delayGrids[2];		// delays published along with each result grid
+		Real* m_pathDistance;		// direction field: path distance to the listener in cells
+		unsigned* m_pathAnchor;		// direction field: first cell in line of sight on the path to the listener
+		unsigned* m_pathHeap;		// direction field: cells queued by path distance
+		unsigned* m_pathHeapPosition;	// direction field: heap slot of each queued cell
 
 		Grid* m_grid;				// handle to the grid system
 		FreeGrid* m_freeGrid;		// handle to the free grid system
+		unsigned m_listener;		// grid listener whose responses are analyzed
 		unsigned m_gridX, m_gridY;	// number of cells in the grid x and y
 		Real m_dx;					// meters per grid for conversions
 		unsigned m_responseLength;	// number of samples per IR
 		unsigned m_samplingRate;	// sampling rate for conversions (samples per second)
-		unsigned m_numThreads;		// number of threads the module is allowed to use
+		unsigned m_numThreads;		// number of analysis threads, each one owns a response tile and decay curve
 		int m_resolution;			// grid resolution
 
-		//Debug
+		// analysis windows in samples
+		int m_directGainSamples;
+		int m_sourceDirSamples;
+		int m_wetGainSamples;
+		int m_schroederOffsetSamples;
 
+		//Debug, nullptr unless PV_ANALYZER_DEBUG_VALUES is set
 		float* EDryValues;
 		float* EFreeValues;
 
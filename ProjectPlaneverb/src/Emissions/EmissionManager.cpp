@@ -79,7 +79,7 @@ namespace Planeverb
 		return nullptr;
 	}
 
-	unsigned EmissionManager::GetMemoryRequirement(const PlaneverbConfig * config)
+	size_t EmissionManager::GetMemoryRequirement(const PlaneverbConfig * config)
 	{
 		return 0;
 	}
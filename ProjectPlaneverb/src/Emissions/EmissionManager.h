@@ -22,7 +22,7 @@ namespace Planeverb
 		void EndEmission(EmissionID id);
 
 		const vec3* GetEmitter(EmissionID id) const;
-		static unsigned GetMemoryRequirement(const struct PlaneverbConfig* config);
+		static size_t GetMemoryRequirement(const struct PlaneverbConfig* config);
 	private:
 		std::vector<vec3> m_emitterPositions;	// dynamic array of current emitter positions, ID is index into vector
 		std::vector<EmissionID> m_openSlots;	// dynamic array of open slots into the emitter positions vector, handles dynamic sources
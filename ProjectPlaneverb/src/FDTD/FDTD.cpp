@@ -1,4 +1,5 @@
 #include <FDTD\Grid.h>
+#include <FDTD\FDTDKernels.h>
 #include <Planeverb.h>
 #include <PvDefinitions.h>
 
@@ -6,84 +7,518 @@
 
 #include <DSP\Analyzer.h>
 #include <Emissions\EmissionManager.h>
+#include <Bake\ProbeSet.h>
+#include <Bake\ProbeFormat.h>
 #include <Util/ScopedTimer.h>
 #include <omp.h>
+#include <xmmintrin.h>
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 namespace Planeverb
 {
+	namespace
+	{
+		// number of outputs whose positions and indices are kept on the stack at once by the batch queries
+		const constexpr size_t PV_OUTPUT_BATCH_SIZE = 64;
+
+		// time steps read ahead by GatherResponses
+		const constexpr unsigned PV_GATHER_PREFETCH_STEPS = 16;
+
+		// cells GatherResponses transposes at once, one cache line of a slice
+		const constexpr unsigned PV_GATHER_CHUNK_CELLS = 16;
+
+		// time steps between field energy checks of an adaptive length simulation
+		const constexpr unsigned PV_ENERGY_CHECK_INTERVAL = 16;
+
+		// group lengths (PV_TEMPORAL_BLOCK_STEPS / threads) divide the energy check interval, so no group straddles a check
+		static_assert(PV_ENERGY_CHECK_INTERVAL % PV_TEMPORAL_BLOCK_STEPS == 0, "step groups must not straddle an energy check");
+
+		// time steps between checks of the cancel flag, a group starting on a multiple checks it
+		const constexpr unsigned PV_CANCEL_CHECK_INTERVAL = 32;
+		static_assert(PV_CANCEL_CHECK_INTERVAL % PV_TEMPORAL_BLOCK_STEPS == 0, "every group length divides the cancel check interval");
+
+		// rows a pipeline step advances between progress updates
+		const constexpr unsigned PV_TEMPORAL_CHUNK_ROWS = 2;
+
+		// threads taking part in the pipeline, any more are left idle
+		const constexpr unsigned PV_MAX_PIPELINE_THREADS = 64;
+
+		// rows a step group has finished, one cache line each so the pipeline threads don't false share
+		struct alignas(64) StageProgress
+		{
+			std::atomic<size_t> rows;
+		};
+
+		// spins until done() holds, yields now and then in case the thread it waits for was preempted.
+		// gives up once abort is set, the thread it waits for may have stopped, returns false then
+		template <typename Condition>
+		bool SpinUntil(Condition done, const std::atomic<bool>& abort)
+		{
+			for (unsigned spins = 1; !done(); ++spins)
+			{
+				if (abort.load(std::memory_order_relaxed))
+					return false;
+				if (spins % 256 == 0)
+					std::this_thread::yield();
+				else
+					_mm_pause();
+			}
+			return true;
+		}
+
+		// finds the next run of tiles active at step t starting at tile, as a [begin, end) column span.
+		// returns false once the band has no more
+		bool NextActiveSpan(const unsigned* activation, unsigned numTiles, unsigned columns, unsigned t,
+			unsigned& tile, unsigned& begin, unsigned& end)
+		{
+			while (tile < numTiles && activation[tile] > t)
+				++tile;
+			if (tile == numTiles)
+				return false;
+
+			begin = tile * PV_TILE_COLUMNS;
+			while (tile < numTiles && activation[tile] <= t)
+				++tile;
+			end = std::min(tile * PV_TILE_COLUMNS, columns);
+			return true;
+		}
+
+		// steps ahead of the wavefront that tiles get activated, covers the pulse being added after the sweeps
+		const constexpr unsigned PV_TILE_ACTIVATION_MARGIN = 2;
+
+		// distance from value to the interval [low, high]
+		PV_FORCEINLINE unsigned GapTo(int value, int low, int high)
+		{
+			return (unsigned)(value < low ? low - value : (value > high ? value - high : 0));
+		}
+
+		// acoustic energy of cells [begin, end), pressure and velocity share units in the update equations
+		double FieldEnergy(const Real* pr, const Real* vx, const Real* vy, unsigned begin, unsigned end)
+		{
+			double energy = 0.0;
+			for (unsigned i = begin; i < end; ++i)
+			{
+				energy += (double)(pr[i] * pr[i] + vx[i] * vx[i] + vy[i] * vy[i]);
+			}
+			return energy;
+		}
+
+		void CopyOutput(const AnalyzerResult& result, unsigned epoch, PlaneverbOutput& output)
+		{
+			output.occlusion = (Real)result.occlusion;
+			output.wetGain = (Real)result.wetGain;
+			output.lowpass = (Real)result.lowpassIntensity;
+			output.rt60 = (Real)result.rt60;
+			output.direction = result.direction;
+			output.sourceDirectivity = result.sourceDirectivity;
+			output.epoch = epoch;
+		}
+
+		void SetInvalidOutput(PlaneverbOutput& output)
+		{
+			std::memset(&output, 0, sizeof(output));
+			output.occlusion = PV_INVALID_DRY_GAIN;
+		}
+
+		// fills outputs for one batch of positions, validPositions may be null if every position is valid
+		void ResolveOutputs(const Analyzer* analyzer, const AnalyzerSnapshot& snapshot, bool interpolate,
+			const vec3* positions, const bool* validPositions, PlaneverbOutput* out, size_t count)
+		{
+			if (interpolate)
+			{
+				AnalyzerResult result;
+				for (size_t i = 0; i < count; ++i)
+				{
+					if ((!validPositions || validPositions[i]) && analyzer->InterpolateResult(snapshot, positions[i], &result))
+						CopyOutput(result, snapshot.epoch, out[i]);
+					else
+						SetInvalidOutput(out[i]);
+				}
+				return;
+			}
+
+			unsigned indices[PV_OUTPUT_BATCH_SIZE];
+			analyzer->GetResultIndices(positions, indices, count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				if ((validPositions && !validPositions[i]) || indices[i] == PV_INVALID_RESULT_INDEX)
+					SetInvalidOutput(out[i]);
+				else
+					CopyOutput(snapshot.results[indices[i]], snapshot.epoch, out[i]);
+			}
+		}
+
+		// fills outputs for one batch of positions from baked probes, validPositions may be null if every position is valid
+		void ResolveBakedOutputs(ProbeSet* probes, const vec3& listenerPos,
+			const vec3* positions, const bool* validPositions, PlaneverbOutput* out, size_t count)
+		{
+			// the probes around the listener stay mapped for the whole batch
+			ProbeNeighborhood neighborhood;
+			probes->BeginQuery(listenerPos, &neighborhood);
+			AnalyzerResult result;
+			for (size_t i = 0; i < count; ++i)
+			{
+				if ((!validPositions || validPositions[i]) && probes->Query(neighborhood, positions[i], &result))
+					CopyOutput(result, PV_BAKED_EPOCH, out[i]);
+				else
+					SetInvalidOutput(out[i]);
+			}
+			probes->EndQuery(neighborhood);
+		}
+	} // namespace <>
+
 #pragma region ClientInterface
-	PlaneverbOutput GetOutput(EmissionID emitter)
+	PlaneverbOutput GetOutput(EmissionID emitter, unsigned listener)
 	{
 		PlaneverbOutput out;
-		std::memset(&out, 0, sizeof(out));
+		GetOutputs(&emitter, &out, 1, listener);
+		return out;
+	}
+
+	void GetOutputs(const EmissionID* emitters, PlaneverbOutput* out, size_t count, unsigned listener)
+	{
 		auto* context = GetContext();
+		const Analyzer* analyzer = context ? context->GetAnalyzer(listener) : nullptr;
+		ProbeSet* probes = context ? context->GetProbeSet() : nullptr;
 
-		// case module hasn't been created yet
-		if(!context)
+		// case module hasn't been created yet or there's no such listener
+		if (!analyzer && !(probes && listener < context->GetConfig()->listenerCount))
 		{
-			out.occlusion = PV_INVALID_DRY_GAIN;
-			return out;
+			for (size_t i = 0; i < count; ++i)
+				SetInvalidOutput(out[i]);
+			return;
 		}
 
-		auto* analyzer = context->GetAnalyzer();
-		auto* emissions = context->GetEmissionManager();
-		const auto* emitterPos = emissions->GetEmitter(emitter);
+		const EmissionManager* emissions = context->GetEmissionManager();
+		const bool interpolate = (context->GetConfig()->outputInterpolation == pv_BilinearInterpolation);
+		vec3 positions[PV_OUTPUT_BATCH_SIZE];
+		bool validEmitters[PV_OUTPUT_BATCH_SIZE];
 
-		// case emitter is invalid
-		if (!emitterPos)
+		// baked probes don't change, no snapshot needed
+		if (probes)
 		{
-			out.occlusion = PV_INVALID_DRY_GAIN;
-			return out;
+			const vec3 listenerPos = context->GetListenerPosition(listener);
+			for (size_t first = 0; first < count; first += PV_OUTPUT_BATCH_SIZE)
+			{
+				const size_t batch = std::min(PV_OUTPUT_BATCH_SIZE, count - first);
+				for (size_t i = 0; i < batch; ++i)
+				{
+					const vec3* emitterPos = emissions->GetEmitter(emitters[first + i]);
+					validEmitters[i] = (emitterPos != nullptr);
+					positions[i] = emitterPos ? *emitterPos : vec3();
+				}
+				ResolveBakedOutputs(probes, listenerPos, positions, validEmitters, out + first, batch);
+			}
+			return;
 		}
 
-		auto* result = analyzer->GetResponseResult(*emitterPos);
+		// one consistent snapshot for the whole batch, the background thread may be writing the next analysis.
+		// redone if an analysis got published meanwhile
+		AnalyzerSnapshot snapshot;
+		do
+		{
+			analyzer->BeginRead(&snapshot);
+			for (size_t first = 0; first < count; first += PV_OUTPUT_BATCH_SIZE)
+			{
+				const size_t batch = std::min(PV_OUTPUT_BATCH_SIZE, count - first);
+
+				// gather emitter positions, invalid emitters are masked out
+				for (size_t i = 0; i < batch; ++i)
+				{
+					const vec3* emitterPos = emissions->GetEmitter(emitters[first + i]);
+					validEmitters[i] = (emitterPos != nullptr);
+					positions[i] = emitterPos ? *emitterPos : vec3();
+				}
 
-		// case invalid emitter position
-		if (!result)
+				ResolveOutputs(analyzer, snapshot, interpolate, positions, validEmitters, out + first, batch);
+			}
+		} while (!analyzer->EndRead(snapshot));
+	}
+
+	void QueryPositions(const vec3* positions, PlaneverbOutput* out, size_t count, unsigned listener)
+	{
+		auto* context = GetContext();
+		const Analyzer* analyzer = context ? context->GetAnalyzer(listener) : nullptr;
+		ProbeSet* probes = context ? context->GetProbeSet() : nullptr;
+
+		// case module hasn't been created yet or there's no such listener
+		if (!analyzer && !(probes && listener < context->GetConfig()->listenerCount))
 		{
-			out.occlusion = PV_INVALID_DRY_GAIN;
-			return out;
+			for (size_t i = 0; i < count; ++i)
+				SetInvalidOutput(out[i]);
+			return;
 		}
 
-		// copy over values
-		out.occlusion = (Real)result->occlusion;
-        out.wetGain = (Real)result->wetGain;
-		out.lowpass = (Real)result->lowpassIntensity;
-		out.rt60 = (Real)result->rt60;
-		out.direction = result->direction;
-		out.sourceDirectivity = result->sourceDirectivity;
+		if (probes)
+		{
+			ResolveBakedOutputs(probes, context->GetListenerPosition(listener), positions, nullptr, out, count);
+			return;
+		}
 
-		return out;
+		const bool interpolate = (context->GetConfig()->outputInterpolation == pv_BilinearInterpolation);
+
+		// one snapshot for the whole batch, redone if an analysis got published meanwhile
+		AnalyzerSnapshot snapshot;
+		do
+		{
+			analyzer->BeginRead(&snapshot);
+			for (size_t first = 0; first < count; first += PV_OUTPUT_BATCH_SIZE)
+			{
+				const size_t batch = std::min(PV_OUTPUT_BATCH_SIZE, count - first);
+				ResolveOutputs(analyzer, snapshot, interpolate, positions + first, nullptr, out + first, batch);
+			}
+		} while (!analyzer->EndRead(snapshot));
 	}
 
-	std::pair<const Cell*, unsigned> GetImpulseResponse(const vec3& position)
+	unsigned GetImpulseResponse(const vec3& position, Cell* out, unsigned maxLength, unsigned listener)
 	{
-		Grid* grid = GetContext()->GetGrid();
+		auto* context = GetContext();
+		Grid* grid = context ? context->GetGrid() : nullptr;
+
+		// case module hasn't been created yet or runs on baked probes
+		if (!grid)
+		{
+			return 0;
+		}
+
+		// case responses aren't stored (streaming analysis) or there's no such listener
+		const unsigned length = grid->GetResponseSize();
+		if (grid->GetAnalysisMode() != pv_StoredResponseAnalysis || listener >= grid->GetListenerCount())
+		{
+			return 0;
+		}
+
+		// case out is too short, only the length is returned
+		if (!out || maxLength < length)
+		{
+			return length;
+		}
 		Real dx = grid->GetDX();
 		vec2i gridPosition =
 		{
 			(unsigned)(position.x / dx),
 			(unsigned)(position.z / dx)
 		};
-		return std::make_pair(grid->GetResponse(gridPosition), grid->GetResponseSize());
+		grid->GetResponse(gridPosition, listener, out);
+		return length;
 	}
 
 #pragma endregion
 	
-	Cell* Grid::GetResponse(const vec2i& gridPosition)
+	// gathers one response out of the cube into the caller's buffer, so concurrent callers don't share one.
+	// false if responses aren't stored or there's no such listener
+	bool Grid::GetResponse(const vec2i& gridPosition, unsigned listener, Cell* out) const
 	{
+		if (!m_response || listener >= m_listenerCount)
+		{
+			return false;
+		}
 		unsigned index = gridPosition.x * m_gridSize.y + gridPosition.y; // INDEX((int)gridPosition.x, (int)gridPosition.y, incDim);
-		return m_pulseResponse[index].data();
+		GatherResponses(listener, index, 1, out);
+		return true;
+	}
+
+	// transposes the responses of cells [firstCell, firstCell + count) out of a listener's time-major cube
+	// into out[cell * responseLength + t]. samples before a cell's tile activated and after an early stop
+	// were never stored and are zero.
+	// returns the number of simulated samples per response, 0 if nothing is stored
+	unsigned Grid::GatherResponses(unsigned listener, unsigned firstCell, unsigned count, Cell* out) const
+	{
+		if (!m_response)
+		{
+			return 0;
+		}
+
+		const unsigned responseLength = m_simulatedLength;
+		const unsigned sliceLength = m_responseSliceLength;
+		const bool hasVelocity = (m_responseChannels == 3);
+		const size_t stepLength = (size_t)sliceLength * m_responseChannels;
+		const Real* const cube = m_response + listener * m_responseCubeLength;
+		const unsigned* const tileActivation = m_tileActivation + (size_t)listener * m_tileBands * m_tilesPerBand;
+
+		for (unsigned chunkStart = 0; chunkStart < count; chunkStart += PV_GATHER_CHUNK_CELLS)
+		{
+			const unsigned chunk = std::min(PV_GATHER_CHUNK_CELLS, count - chunkStart);
+			Cell* chunkOut = out + (size_t)chunkStart * m_responseLength;
+
+			// first stored step of each cell
+			unsigned activation[PV_GATHER_CHUNK_CELLS];
+			unsigned firstActivation = responseLength;
+			for (unsigned c = 0; c < chunk; ++c)
+			{
+				const unsigned cell = firstCell + chunkStart + c;
+				const unsigned band = (cell / m_gridSize.y) / PV_TILE_ROWS;
+				const unsigned tile = (cell % m_gridSize.y) / PV_TILE_COLUMNS;
+				activation[c] = tileActivation[band * m_tilesPerBand + tile];
+				firstActivation = std::min(firstActivation, activation[c]);
+			}
+
+			for (unsigned t = 0; t < firstActivation; ++t)
+			{
+				for (unsigned c = 0; c < chunk; ++c)
+				{
+					Cell& cell = chunkOut[c * m_responseLength + t];
+					cell.pr = cell.vx = cell.vy = (Real)0.f;
+				}
+			}
+
+			// walk the cube in time order, neighbouring cells share cache lines.
+			// consecutive steps are a whole slice apart, too far for the hardware prefetcher
+			const Real* step = cube + (size_t)firstActivation * stepLength + firstCell + chunkStart;
+			for (unsigned t = firstActivation; t < responseLength; ++t)
+			{
+				if (t + PV_GATHER_PREFETCH_STEPS < responseLength)
+				{
+					const Real* ahead = step + PV_GATHER_PREFETCH_STEPS * stepLength;
+					for (unsigned channel = 0; channel < m_responseChannels; ++channel)
+					{
+						const Real* line = ahead + channel * sliceLength;
+						_mm_prefetch(reinterpret_cast<const char*>(line), _MM_HINT_T0);
+						_mm_prefetch(reinterpret_cast<const char*>(line + chunk - 1), _MM_HINT_T0);
+					}
+				}
+
+				for (unsigned c = 0; c < chunk; ++c)
+				{
+					Cell& cell = chunkOut[c * m_responseLength + t];
+					const bool stored = (t >= activation[c]);
+					cell.pr = stored ? step[c] : (Real)0.f;
+					cell.vx = (stored && hasVelocity) ? step[sliceLength + c] : (Real)0.f;
+					cell.vy = (stored && hasVelocity) ? step[2 * sliceLength + c] : (Real)0.f;
+				}
+				step += stepLength;
+			}
+		}
+
+		// B field isn't part of the cube
+		for (unsigned c = 0; c < count; ++c)
+		{
+			const short B = (short)m_beta[firstCell + c];
+			Cell* response = out + c * m_responseLength;
+			for (unsigned t = 0; t < responseLength; ++t)
+			{
+				response[t].b = B;
+				response[t].by = B;
+			}
+			for (unsigned t = responseLength; t < m_responseLength; ++t)
+			{
+				response[t] = Cell(0.f, 0.f, 0.f, B, B);
+			}
+		}
+
+		return responseLength;
 	}
 
 	unsigned Grid::GetResponseSize() const
 	{
 		return m_responseLength;
 	}
-	
+
+	// Every step the pressure reads the velocities one cell further along each axis and the velocities read
+	// the pressure one cell back, so the field spreads at most one cell per step (Manhattan distance).
+	// the y velocity of each row's first cell also reads the previous row's last cell, which adds the
+	// shortcuts over the row ends. a cell the pulse can't have reached yet is exactly 0 and stays 0 when
+	// updated, so skipping it changes nothing.
+	// a tile whose cells, and the cells above and left of it that its velocities read, are all solid
+	// only ever computes 0 and is never updated
+	void Grid::PrepareActiveTiles(unsigned listenerRow, unsigned listenerColumn, unsigned* tileActivation)
+	{
+		const int rows = (int)m_gridSize.x;
+		const int columns = (int)m_gridSize.y;
+
+		for (unsigned band = 0; band < m_tileBands; ++band)
+		{
+			const int r0 = (int)(band * PV_TILE_ROWS);
+			const int r1 = std::min(r0 + (int)PV_TILE_ROWS, rows) - 1;
+			for (unsigned tile = 0; tile < m_tilesPerBand; ++tile)
+			{
+				const int c0 = (int)(tile * PV_TILE_COLUMNS);
+				const int c1 = std::min(c0 + (int)PV_TILE_COLUMNS, columns) - 1;
+
+				// solid check over the tile plus the row above and the column left (the previous row's
+				// last cell for column 0). cells outside the grid count as solid
+				bool solid = true;
+				for (int r = r0 - 1; r <= r1 && solid; ++r)
+				{
+					for (int c = c0 - 1; c <= c1; ++c)
+					{
+						int cr = r, cc = c;
+						if (cc < 0)
+						{
+							cr = r - 1;
+							cc = columns - 1;
+						}
+						if (cr < 0)
+							continue;
+						if (m_beta[INDEX(cr, cc, m_gridSize)] != (Real)0.f)
+						{
+							solid = false;
+							break;
+						}
+					}
+				}
+
+				unsigned& activation = tileActivation[band * m_tilesPerBand + tile];
+				if (solid)
+				{
+					activation = PV_TILE_NEVER;
+					continue;
+				}
+				activation = GetStepDistance(vec2i(listenerRow, listenerColumn), vec2i(r0, c0), vec2i(r1, c1));
+			}
+		}
+	}
+
+	size_t Grid::GetCellUpdates() const
+	{
+		const size_t tilesPerListener = (size_t)m_tileBands * m_tilesPerBand;
+		size_t updates = 0;
+		for (unsigned k = 0; k < m_listenerCount; ++k)
+		{
+			for (unsigned band = 0; band < m_tileBands; ++band)
+			{
+				const size_t rows = std::min(PV_TILE_ROWS, (unsigned)m_gridSize.x - band * PV_TILE_ROWS);
+				for (unsigned tile = 0; tile < m_tilesPerBand; ++tile)
+				{
+					// tiles run from their activation step to the end of the simulation
+					const unsigned activation = m_tileActivation[k * tilesPerListener + band * m_tilesPerBand + tile];
+					if (activation < m_simulatedLength)
+					{
+						const size_t columns = std::min(PV_TILE_COLUMNS, (unsigned)m_gridSize.y - tile * PV_TILE_COLUMNS);
+						updates += rows * columns * (m_simulatedLength - activation);
+					}
+				}
+			}
+		}
+		return updates;
+	}
+
+	unsigned Grid::GetStepDistance(const vec2i& cell, const vec2i& first, const vec2i& last) const
+	{
+		const int columns = (int)m_gridSize.y;
+		const int sr = (int)cell.x;
+		const int sc = (int)cell.y;
+		const int r0 = (int)first.x;
+		const int r1 = (int)last.x;
+		const int c0 = (int)first.y;
+		const int c1 = (int)last.y;
+
+		// shortest distance from the cell to the box: direct, over the end of a row going down,
+		// or over the start of a row going up
+		const unsigned direct = GapTo(sr, r0, r1) + GapTo(sc, c0, c1);
+		const unsigned wrapDown = GapTo(sr + 1, r0, r1) + (unsigned)(columns - 1 - sc) + 1 + (unsigned)c0;
+		const unsigned wrapUp = GapTo(sr - 1, r0, r1) + (unsigned)sc + 1 + (unsigned)(columns - 1 - c1);
+		const unsigned distance = std::min(direct, std::min(wrapDown, wrapUp));
+		return (distance > PV_TILE_ACTIVATION_MARGIN) ? distance - PV_TILE_ACTIVATION_MARGIN : 0;
+	}
+
 	// process FDTD
-	void Grid::GenerateResponseCPU(const vec3 &listener)
+	bool Grid::GenerateResponseCPU(const vec3* listeners, const std::atomic<bool>* cancel)
 	{
 		// determine pressure and velocity update constants
 		const Real Courant = PV_C * m_dt / m_dx;
@@ -91,12 +526,10 @@ namespace Planeverb
 		// grid constants
 		const unsigned gridx = m_gridSize.x;
 		const unsigned gridy = m_gridSize.y;
-		const vec2i incdim = m_gridSize;
-		const unsigned listenerPosX = (unsigned)((listener.x + m_gridOffset.x) / m_dx);
-		const unsigned listenerPosY = (unsigned)((listener.z + m_gridOffset.y) / m_dx);
-		const unsigned listenerPos = listenerPosX * gridy + listenerPosY;
+		const unsigned numListeners = m_listenerCount;
+		const size_t tilesPerListener = (size_t)m_tileBands * m_tilesPerBand;
 		const unsigned responseLength = m_responseLength;
-		unsigned loopSize = incdim.x * incdim.y;
+		const unsigned responseStepLength = m_responseChannels * m_responseSliceLength;
 
 		// thread usage
 		if (m_maxThreads == 0)
@@ -104,150 +537,290 @@ namespace Planeverb
 		else
 			omp_set_num_threads(m_maxThreads);
 
-		// RESET all pressure and velocity, but not B fields (can't use memset)
+		// RESET all pressure and velocity of every listener, B field and admittance live in their own planes
+		std::memset(m_pr, 0, sizeof(Real) * m_listenerStride * numListeners);
+
+		// reset running analysis state
+		for (unsigned k = 0; k < numListeners; ++k)
 		{
-			Cell* resetPtr = m_grid;
-            const unsigned N = loopSize;
-			for (unsigned i = 0; i < N; ++i, ++resetPtr)
+			if (m_streamingAnalyzers[k])
 			{
-				resetPtr->pr = 0.f;
-				resetPtr->vx = 0.f;
-				resetPtr->vy = 0.f;
+				m_streamingAnalyzers[k]->BeginStreaming();
 			}
 		}
 
-		// Time-stepped FDTD simulation
-		for (unsigned t = 0; t < responseLength; ++t)
+		// SIMD kernels for this CPU
+		const FDTDKernels& kernels = GetFDTDKernels();
+
+		// adaptive length: stop once the field energy of every listener has decayed below the threshold, but not
+		// before the analysis windows have passed the grid corner farthest from any listener
+		const bool adaptiveLength = (m_decayThreshold > (Real)0.f);
+		unsigned minimumLength = adaptiveLength ? 0 : responseLength;
+		double peakEnergy[PV_MAX_LISTENERS] = {};
+		std::atomic<bool> stopSimulation(false);
+		std::atomic<int> checkedStep(-1);		// last energy check step that has been decided
+		std::atomic<bool> cancelled(false);		// a group saw the cancel flag, every thread leaves
+		std::atomic<unsigned> cancelledStep(responseLength);
+		m_simulatedLength = responseLength;
+
+		// the pulse of each listener is added once every row that reads its pressure has finished the step
+		const unsigned numRows = gridx;
+		const unsigned numChunks = (numRows + PV_TEMPORAL_CHUNK_ROWS - 1) / PV_TEMPORAL_CHUNK_ROWS;
+		unsigned listenerPos[PV_MAX_LISTENERS];
+		unsigned pulseRow[PV_MAX_LISTENERS];
+		for (unsigned k = 0; k < numListeners; ++k)
 		{
-			// process pressure grid
-			{
-                const unsigned N = loopSize;
-                for (unsigned i = 0; i < N; ++i)
-				{
-					Cell& thisCell = m_grid[i];
-					int B = (int)thisCell.b;
-					Real beta = (Real)B;
-					//TODO: Check outside bounds access on ends?
-					// [i + 1, j]
-					const Cell& nextCellX = m_grid[i + gridy];	
-					// [i, j + 1]
-					const Cell& nextCellY = m_grid[i + 1];
+			const unsigned listenerPosX = (unsigned)((listeners[k].x + m_gridOffset.x) / m_dx);
+			const unsigned listenerPosY = (unsigned)((listeners[k].z + m_gridOffset.y) / m_dx);
+			listenerPos[k] = listenerPosX * gridy + listenerPosY;
+			pulseRow[k] = std::min(listenerPosX + 1, gridx - 1);
 
-					const auto divergence = ((nextCellX.vx - thisCell.vx) + (nextCellY.vy - thisCell.vy));
-					thisCell.pr = beta * (thisCell.pr - Courant * divergence);
-				}
-			}
-
-			// process x component of particle velocity
+			if (adaptiveLength)
 			{
-				// eq to for(1 to sizex) for(0 to sizey)
-				for (unsigned i = gridy ; i < loopSize; ++i)
-				{
-					// [i - 1, j]
-					auto in = (i - gridy);
-					const Cell& prevCell = m_grid[in];
-					Real beta_n = (Real)prevCell.b;
-					Real Rn = m_boundaries[in].absorption; 
-					Real Yn = (1.f - Rn) / (1.f + Rn);
-
-					// [i, j]
-					Cell& thisCell = m_grid[i];											
-					int B = (int)thisCell.b;
-					Real beta = (Real)B;
-					Real R = m_boundaries[i].absorption;
-					Real Y = (1.f - R) / (1.f + R);
+				const Real farX = (Real)std::max(listenerPosX, gridx - 1 - listenerPosX) * m_dx;
+				const Real farY = (Real)std::max(listenerPosY, gridy - 1 - listenerPosY) * m_dx;
+				const Real windows = PV_DRY_GAIN_ANALYSIS_LENGTH + PV_WET_GAIN_ANALYSIS_LENGTH + PV_SCHROEDER_OFFSET_S;
+				const Real minimumSeconds = std::sqrt(farX * farX + farY * farY) / PV_C + windows;
+				minimumLength = std::max(minimumLength, std::min(responseLength, (unsigned)(minimumSeconds * (Real)m_samplingRate) + 1));
+			}
 
-					const Real gradient_x = (thisCell.pr - prevCell.pr);
-					const Real airCellUpdate = thisCell.vx - Courant * gradient_x;
+			// only tiles the wavefront can have reached are updated
+			PrepareActiveTiles(listenerPosX, listenerPosY, m_tileActivation + k * tilesPerListener);
+		}
 
-					const Real Y_boundary = beta * Yn + beta_n * Y;
-					const Real wallCellUpdate = Y_boundary * (prevCell.pr * beta_n + thisCell.pr * beta);
+		// advances one row of one listener's fields by time step t: pressure, velocities and boundaries,
+		// then stores the results. the row above (row - 1, whose pressure the velocities read) must have
+		// finished step t and the row below (row + 1, whose x velocity the pressure reads) step t - 1
+		auto stepRow = [&](unsigned k, unsigned row, unsigned t)
+		{
+			Real* const pr = m_pr + k * m_listenerStride;
+			Real* const vx = m_vx + k * m_listenerStride;
+			Real* const vy = m_vy + k * m_listenerStride;
+			Analyzer* const streamingAnalyzer = m_streamingAnalyzers[k];
+			const unsigned rowStart = row * gridy;
+			const unsigned* activation = m_tileActivation + k * tilesPerListener + (row / PV_TILE_ROWS) * m_tilesPerBand;
+			unsigned tile, begin, end;
+
+			// pressure reads [i + 1, j] and [i, j + 1] from the velocity planes, the last row reads the ghost row.
+			// x velocity pairs with [i - 1, j] (row 0 is boundary only), y velocity with [i, j - 1]
+			// (the first cell of each row after the first pairs with the last cell of the previous row,
+			// kept as is to match the original linear sweep). the cells around a span are inactive and 0,
+			// so each span can be finished before the next one
+			tile = 0;
+			while (NextActiveSpan(activation, m_tilesPerBand, gridy, t, tile, begin, end))
+			{
+				kernels.updatePressure(pr, vx, vy, m_beta, rowStart + begin, rowStart + end, gridy, Courant);
+				if (row > 0)
+					kernels.updateVelocity(vx, pr, m_beta, m_admittance, rowStart + begin, rowStart + end, gridy, Courant);
+				kernels.updateVelocity(vy, pr, m_beta, m_admittance, std::max(rowStart + begin, 1u), rowStart + end, 1, Courant);
+			}
 
-					thisCell.vx = beta*beta_n * airCellUpdate + (beta_n - beta) * wallCellUpdate;
-				}
+			// process absorption top/bottom
+			if (row == 0)
+			{
+				for (unsigned i = 0; i < gridy; ++i)
+					vx[i] = -pr[i];
+			}
+			if (row == gridx - 1)
+			{
+				for (unsigned i = 0; i < gridy; ++i)
+					vx[gridx * gridy + i] = pr[rowStart + i];
 			}
 
-			// process y component of particle velocity
+			// process absorption left/right
+			vy[rowStart] = -pr[rowStart];
+			vy[rowStart + gridy - 1] = pr[rowStart + gridy - 2];
+
+			// add results to the response cube, or feed them straight to the analyzer.
+			// inactive cells are 0, they aren't stored (GatherResponses fills them in)
+			// and have neither energy nor anything to accumulate
+			Real* const responseStep = m_response ? m_response + k * m_responseCubeLength + (size_t)t * responseStepLength : nullptr;
+			const bool checkEnergy = adaptiveLength && (t + 1) % PV_ENERGY_CHECK_INTERVAL == 0;
+			double rowEnergy = 0.0;
+			tile = 0;
+			while (NextActiveSpan(activation, m_tilesPerBand, gridy, t, tile, begin, end))
 			{
-				// eq to for(0 to sizex) for(1 to sizey)
-				for (unsigned i = 1; i < loopSize; ++i)
+				begin += rowStart;
+				end += rowStart;
+				if (checkEnergy)
 				{
-					// [i, j - 1]
-					const auto in = i - 1;
-					const Cell& prevCell = m_grid[in];
-					Real beta_n = (Real)prevCell.b;
-					Real Rn = m_boundaries[in].absorption;
-					Real Yn = (1.f - Rn) / (1.f + Rn);
-
-					// [i, j]
-					Cell& thisCell = m_grid[i];											
-					int B = thisCell.b;
-					Real beta = (Real)B;
-					Real R = m_boundaries[i].absorption;
-					Real Y = (1.f - R) / (1.f + R);
-	
-					const Real gradient_y = (thisCell.pr - prevCell.pr);
-					const Real airCellUpdate = thisCell.vy - Courant * gradient_y;
-
-					const Real Y_boundary = beta * Yn + beta_n * Y;
-					const Real wallCellUpdate = Y_boundary * (prevCell.pr * beta_n + thisCell.pr * beta);
-
-					thisCell.vy = beta * beta_n * airCellUpdate + (beta_n - beta) * wallCellUpdate;
+					rowEnergy += FieldEnergy(pr, vx, vy, begin, end);
+				}
+				if (responseStep)
+				{
+					kernels.storeResponse(responseStep, pr, begin, end);
+					if (m_responseChannels == 3)
+					{
+						kernels.storeResponse(responseStep + m_responseSliceLength, vx, begin, end);
+						kernels.storeResponse(responseStep + 2 * m_responseSliceLength, vy, begin, end);
+					}
+				}
+				if (streamingAnalyzer)
+				{
+					streamingAnalyzer->AccumulateStep(t, pr, vx, vy, begin, end);
 				}
 			}
+			if (checkEnergy)
+			{
+				m_rowEnergy[k * numRows + row] = rowEnergy;
+			}
 
-			// process absorption top/bottom
+			// add pulse to listener position pressure field
+			if (row == pulseRow[k])
 			{
-				for (int i = 0; i < gridy ; ++i)
-				{
-					unsigned index1 = i;
-					unsigned index2 = gridx * gridy  + i;
+				pr[listenerPos[k]] += m_pulse[t];
+			}
+		};
 
-					m_grid[index1].vx = -m_grid[index1].pr;
-					m_grid[index2].vx = m_grid[index2 - gridy].pr;
-				}
+		// Temporal blocking. a row at step t only depends on its neighbours at steps t and t - 1, so time steps
+		// can run as a pipeline down the rows: step t works on a row once step t - 1 has finished the row
+		// below it. each thread takes groups of consecutive steps in turn and runs its group as a skewed
+		// wavefront, a chunk of rows further behind per step, so a few rows of the grid stay in cache while
+		// they are advanced several steps. the first step of a group follows the previous group (the
+		// previous thread) through its progress counter.
+		// every cell is updated from exactly the same values as in a full sweep per step, so output is
+		// bit-identical for any thread count. groups never straddle an energy check, later groups wait until
+		// the check has decided whether the simulation stops.
+		// groups starting on a cancel check step stop the simulation if the cancel flag is set. the threads
+		// waiting on them give up their groups, the fields are left part way and the responses are useless
+		// a group runs its steps for every listener in turn. the listeners share the B field and admittance
+		// rows of the group, which are still cached from the previous listener, while the fields and streaming
+		// state of only one listener are in flight at a time
+		StageProgress progress[PV_MAX_PIPELINE_THREADS];
+		unsigned numThreads = 1;
+		unsigned groupSteps = 1;
+#pragma omp parallel
+		{
+#pragma omp single
+			{
+				numThreads = std::min((unsigned)omp_get_num_threads(), PV_MAX_PIPELINE_THREADS);
+				groupSteps = std::max(PV_TEMPORAL_BLOCK_STEPS / numThreads, 1u);
+				for (unsigned i = 0; i < numThreads; ++i)
+					progress[i].rows.store(0, std::memory_order_relaxed);
 			}
 
-			// process absorption left/right
+			// threads beyond the pipeline length have no groups
+			const unsigned thread = (unsigned)omp_get_thread_num();
+			bool abandoned = false;
+			for (unsigned group = thread; thread < numThreads && group * groupSteps < responseLength && !abandoned; group += numThreads)
 			{
-				for (unsigned i = 0; i < gridx ; ++i)
+				const unsigned first = group * groupSteps;
+				const unsigned last = std::min(first + groupSteps, responseLength);
+				const unsigned stages = last - first;
+
+				// cancel checkpoint, the earliest group to see the flag counts as the step the simulation stopped at
+				if (cancel && first % PV_CANCEL_CHECK_INTERVAL == 0 && cancel->load(std::memory_order_relaxed))
 				{
-					unsigned index1 = i * gridy ;
-					unsigned index2 = i * gridy + gridy-1;
+					unsigned step = cancelledStep.load(std::memory_order_relaxed);
+					while (first < step && !cancelledStep.compare_exchange_weak(step, first, std::memory_order_relaxed));
+					cancelled.store(true, std::memory_order_relaxed);
+				}
+				if (cancelled.load(std::memory_order_relaxed))
+					break;
 
-					m_grid[index1].vy = -m_grid[index1].pr;
-					m_grid[index2].vy = m_grid[index2 - 1].pr;
+				// wait for the energy check before this group
+				if (adaptiveLength && first >= PV_ENERGY_CHECK_INTERVAL)
+				{
+					const int check = (int)(first - first % PV_ENERGY_CHECK_INTERVAL) - 1;
+					if (!SpinUntil([&]() { return checkedStep.load(std::memory_order_acquire) >= check; }, cancelled))
+						break;
+					if (stopSimulation.load(std::memory_order_relaxed))
+						break;
 				}
-			}
 
-			// add results to the response cube
-			{
-				for (unsigned i = 0; i < loopSize; ++i)
+				// progress is counted as (group * listeners + listener) * (rows + 1) + finished rows,
+				// so it only ever grows per counter
+				StageProgress& previous = progress[(group + numThreads - 1) % numThreads];
+				StageProgress& own = progress[group % numThreads];
+				const size_t previousBase = (size_t)(group - 1) * numListeners * (numRows + 1);
+				const size_t ownBase = (size_t)group * numListeners * (numRows + 1);
+
+				for (unsigned k = 0; k < numListeners && !abandoned; ++k)
+				{
+					for (unsigned position = 0; position < numChunks + stages - 1 && !abandoned; ++position)
+					{
+						for (unsigned stage = 0; stage < stages && stage <= position; ++stage)
+						{
+							const unsigned chunk = position - stage;
+							if (chunk >= numChunks)
+								continue;
+							const unsigned rowBegin = chunk * PV_TEMPORAL_CHUNK_ROWS;
+							const unsigned rowEnd = std::min(rowBegin + PV_TEMPORAL_CHUNK_ROWS, numRows);
+
+							// the previous step has to be past the row after this chunk
+							if (stage == 0 && group > 0)
+							{
+								const size_t needed = previousBase + k * (numRows + 1) + std::min(rowEnd + 1, numRows);
+								if (!SpinUntil([&]() { return previous.rows.load(std::memory_order_acquire) >= needed; }, cancelled))
+								{
+									abandoned = true;
+									break;
+								}
+							}
+
+							for (unsigned row = rowBegin; row < rowEnd; ++row)
+							{
+								stepRow(k, row, first + stage);
+							}
+
+							if (stage == stages - 1)
+							{
+								own.rows.store(ownBase + k * (numRows + 1) + rowEnd, std::memory_order_release);
+							}
+						}
+					}
+				}
+
+				// every row has finished the check step, rows are summed in order so the stopping step
+				// doesn't depend on the thread count
+				if (!abandoned && adaptiveLength && last % PV_ENERGY_CHECK_INTERVAL == 0)
 				{
-					m_pulseResponse[i][t] = m_grid[i];
+					bool decayed = true;
+					for (unsigned k = 0; k < numListeners; ++k)
+					{
+						double energy = 0.0;
+						for (unsigned row = 0; row < numRows; ++row)
+							energy += m_rowEnergy[k * numRows + row];
+						peakEnergy[k] = std::max(peakEnergy[k], energy);
+						decayed = decayed && energy < peakEnergy[k] * (double)m_decayThreshold;
+					}
+
+					if (last >= minimumLength && decayed)
+					{
+						m_simulatedLength = last;
+						stopSimulation.store(true, std::memory_order_relaxed);
+					}
+					checkedStep.store((int)last - 1, std::memory_order_release);
 				}
 			}
 
-			// add pulse to listener position pressure field
-			m_grid[listenerPos].pr += m_pulse[t];
+			// make this thread's non-temporal response stores visible before the responses are read
+			_mm_sfence();
+		}
+
+		if (cancelled.load(std::memory_order_relaxed))
+		{
+			m_simulatedLength = std::min(cancelledStep.load(std::memory_order_relaxed), m_simulatedLength);
+			return false;
 		}
+		return true;
 	}
 
-	void Grid::GenerateResponseGPU(const vec3& listener)
+	bool Grid::GenerateResponseGPU(const vec3* /*listeners*/, const std::atomic<bool>* /*cancel*/)
 	{
 		// not currently supported
 		throw pv_InvalidConfig;
 	}
 
-	void Grid::GenerateResponse(const vec3& listener)
+	bool Grid::GenerateResponses(const vec3* listeners, const std::atomic<bool>* cancel)
 	{
 		if (m_executionType == PlaneverbExecutionType::pv_CPU)
 		{
-			GenerateResponseCPU(listener);
+			return GenerateResponseCPU(listeners, cancel);
 		}
 		else
 		{
-			GenerateResponseGPU(listener);
+			return GenerateResponseGPU(listeners, cancel);
 		}
 	}
 } // namespace Planeverb
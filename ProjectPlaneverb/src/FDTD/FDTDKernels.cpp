@@ -0,0 +1,276 @@
+#include <FDTD\FDTDKernels.h>
+#include <PvDefinitions.h>
+
+#include <cstring>
+#include <cstdint>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// MSVC allows any intrinsic in any function, other compilers need the target enabled per function
+#if defined(_MSC_VER)
+#define PV_TARGET_SSE
+#define PV_TARGET_AVX
+#else
+#define PV_TARGET_SSE __attribute__((target("sse")))
+#define PV_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+namespace Planeverb
+{
+	namespace
+	{
+		#pragma region Scalar
+		PV_FORCEINLINE void PressureCell(Real* pr, const Real* vx, const Real* vy, const Real* beta,
+			unsigned i, unsigned stride, Real courant)
+		{
+			const Real divergence = ((vx[i + stride] - vx[i]) + (vy[i + 1] - vy[i]));
+			pr[i] = beta[i] * (pr[i] - courant * divergence);
+		}
+
+		PV_FORCEINLINE void VelocityCell(Real* v, const Real* pr, const Real* beta, const Real* admittance,
+			unsigned i, unsigned stride, Real courant)
+		{
+			// neighbour cell
+			const unsigned in = i - stride;
+			const Real beta_n = beta[in];
+			const Real Yn = admittance[in];
+
+			// this cell
+			const Real b = beta[i];
+			const Real Y = admittance[i];
+
+			const Real gradient = (pr[i] - pr[in]);
+			const Real airCellUpdate = v[i] - courant * gradient;
+
+			const Real Y_boundary = b * Yn + beta_n * Y;
+			const Real wallCellUpdate = Y_boundary * (pr[in] * beta_n + pr[i] * b);
+
+			v[i] = b * beta_n * airCellUpdate + (beta_n - b) * wallCellUpdate;
+		}
+
+		void UpdatePressureScalar(Real* pr, const Real* vx, const Real* vy, const Real* beta,
+			unsigned begin, unsigned end, unsigned stride, Real courant)
+		{
+			for (unsigned i = begin; i < end; ++i)
+				PressureCell(pr, vx, vy, beta, i, stride, courant);
+		}
+
+		void UpdateVelocityScalar(Real* v, const Real* pr, const Real* beta, const Real* admittance,
+			unsigned begin, unsigned end, unsigned stride, Real courant)
+		{
+			for (unsigned i = begin; i < end; ++i)
+				VelocityCell(v, pr, beta, admittance, i, stride, courant);
+		}
+
+		void StoreResponseScalar(Real* dst, const Real* src, unsigned begin, unsigned end)
+		{
+			std::memcpy(dst + begin, src + begin, sizeof(Real) * (end - begin));
+		}
+		#pragma endregion
+
+		#pragma region SSE
+		PV_TARGET_SSE void UpdatePressureSSE(Real* pr, const Real* vx, const Real* vy, const Real* beta,
+			unsigned begin, unsigned end, unsigned stride, Real courant)
+		{
+			const __m128 c = _mm_set1_ps(courant);
+			unsigned i = begin;
+			for (; i + 4 <= end; i += 4)
+			{
+				const __m128 dvx = _mm_sub_ps(_mm_loadu_ps(vx + i + stride), _mm_loadu_ps(vx + i));
+				const __m128 dvy = _mm_sub_ps(_mm_loadu_ps(vy + i + 1), _mm_loadu_ps(vy + i));
+				const __m128 divergence = _mm_add_ps(dvx, dvy);
+				const __m128 p = _mm_sub_ps(_mm_loadu_ps(pr + i), _mm_mul_ps(c, divergence));
+				_mm_storeu_ps(pr + i, _mm_mul_ps(_mm_loadu_ps(beta + i), p));
+			}
+			for (; i < end; ++i)
+				PressureCell(pr, vx, vy, beta, i, stride, courant);
+		}
+
+		PV_TARGET_SSE void UpdateVelocitySSE(Real* v, const Real* pr, const Real* beta, const Real* admittance,
+			unsigned begin, unsigned end, unsigned stride, Real courant)
+		{
+			const __m128 c = _mm_set1_ps(courant);
+			unsigned i = begin;
+			for (; i + 4 <= end; i += 4)
+			{
+				const unsigned in = i - stride;
+				const __m128 beta_n = _mm_loadu_ps(beta + in);
+				const __m128 Yn = _mm_loadu_ps(admittance + in);
+				const __m128 prn = _mm_loadu_ps(pr + in);
+				const __m128 b = _mm_loadu_ps(beta + i);
+				const __m128 Y = _mm_loadu_ps(admittance + i);
+				const __m128 p = _mm_loadu_ps(pr + i);
+
+				const __m128 airCellUpdate = _mm_sub_ps(_mm_loadu_ps(v + i), _mm_mul_ps(c, _mm_sub_ps(p, prn)));
+				const __m128 Y_boundary = _mm_add_ps(_mm_mul_ps(b, Yn), _mm_mul_ps(beta_n, Y));
+				const __m128 wallCellUpdate = _mm_mul_ps(Y_boundary, _mm_add_ps(_mm_mul_ps(prn, beta_n), _mm_mul_ps(p, b)));
+
+				const __m128 out = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(b, beta_n), airCellUpdate),
+					_mm_mul_ps(_mm_sub_ps(beta_n, b), wallCellUpdate));
+				_mm_storeu_ps(v + i, out);
+			}
+			for (; i < end; ++i)
+				VelocityCell(v, pr, beta, admittance, i, stride, courant);
+		}
+
+		PV_TARGET_SSE void StoreResponseSSE(Real* dst, const Real* src, unsigned begin, unsigned end)
+		{
+			unsigned i = begin;
+			// scalar head up to the first 16 byte boundary
+			for (; i < end && (reinterpret_cast<std::uintptr_t>(dst + i) & 15) != 0; ++i)
+				dst[i] = src[i];
+			for (; i + 4 <= end; i += 4)
+				_mm_stream_ps(dst + i, _mm_loadu_ps(src + i));
+			for (; i < end; ++i)
+				dst[i] = src[i];
+		}
+		#pragma endregion
+
+		#pragma region AVX
+		PV_TARGET_AVX void UpdatePressureAVX(Real* pr, const Real* vx, const Real* vy, const Real* beta,
+			unsigned begin, unsigned end, unsigned stride, Real courant)
+		{
+			const __m256 c = _mm256_set1_ps(courant);
+			unsigned i = begin;
+			for (; i + 8 <= end; i += 8)
+			{
+				const __m256 dvx = _mm256_sub_ps(_mm256_loadu_ps(vx + i + stride), _mm256_loadu_ps(vx + i));
+				const __m256 dvy = _mm256_sub_ps(_mm256_loadu_ps(vy + i + 1), _mm256_loadu_ps(vy + i));
+				const __m256 divergence = _mm256_add_ps(dvx, dvy);
+				const __m256 p = _mm256_sub_ps(_mm256_loadu_ps(pr + i), _mm256_mul_ps(c, divergence));
+				_mm256_storeu_ps(pr + i, _mm256_mul_ps(_mm256_loadu_ps(beta + i), p));
+			}
+			for (; i < end; ++i)
+				PressureCell(pr, vx, vy, beta, i, stride, courant);
+		}
+
+		PV_TARGET_AVX void UpdateVelocityAVX(Real* v, const Real* pr, const Real* beta, const Real* admittance,
+			unsigned begin, unsigned end, unsigned stride, Real courant)
+		{
+			const __m256 c = _mm256_set1_ps(courant);
+			unsigned i = begin;
+			for (; i + 8 <= end; i += 8)
+			{
+				const unsigned in = i - stride;
+				const __m256 beta_n = _mm256_loadu_ps(beta + in);
+				const __m256 Yn = _mm256_loadu_ps(admittance + in);
+				const __m256 prn = _mm256_loadu_ps(pr + in);
+				const __m256 b = _mm256_loadu_ps(beta + i);
+				const __m256 Y = _mm256_loadu_ps(admittance + i);
+				const __m256 p = _mm256_loadu_ps(pr + i);
+
+				const __m256 airCellUpdate = _mm256_sub_ps(_mm256_loadu_ps(v + i), _mm256_mul_ps(c, _mm256_sub_ps(p, prn)));
+				const __m256 Y_boundary = _mm256_add_ps(_mm256_mul_ps(b, Yn), _mm256_mul_ps(beta_n, Y));
+				const __m256 wallCellUpdate = _mm256_mul_ps(Y_boundary, _mm256_add_ps(_mm256_mul_ps(prn, beta_n), _mm256_mul_ps(p, b)));
+
+				const __m256 out = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(b, beta_n), airCellUpdate),
+					_mm256_mul_ps(_mm256_sub_ps(beta_n, b), wallCellUpdate));
+				_mm256_storeu_ps(v + i, out);
+			}
+			for (; i < end; ++i)
+				VelocityCell(v, pr, beta, admittance, i, stride, courant);
+		}
+
+		PV_TARGET_AVX void StoreResponseAVX(Real* dst, const Real* src, unsigned begin, unsigned end)
+		{
+			unsigned i = begin;
+			// scalar head up to the first 32 byte boundary
+			for (; i < end && (reinterpret_cast<std::uintptr_t>(dst + i) & 31) != 0; ++i)
+				dst[i] = src[i];
+			for (; i + 8 <= end; i += 8)
+				_mm256_stream_ps(dst + i, _mm256_loadu_ps(src + i));
+			for (; i < end; ++i)
+				dst[i] = src[i];
+		}
+		#pragma endregion
+
+		#pragma region Dispatch
+		void CPUID(int leaf, int subleaf, int regs[4])
+		{
+		#if defined(_MSC_VER)
+			__cpuidex(regs, leaf, subleaf);
+		#else
+			unsigned a, b, c, d;
+			__cpuid_count(leaf, subleaf, a, b, c, d);
+			regs[0] = (int)a; regs[1] = (int)b; regs[2] = (int)c; regs[3] = (int)d;
+		#endif
+		}
+
+		// true if the OS saves the AVX register state on context switches
+		bool OSSupportsAVX()
+		{
+		#if defined(_MSC_VER)
+			const unsigned long long xcr0 = _xgetbv(0);
+		#else
+			unsigned lo, hi;
+			__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+			const unsigned long long xcr0 = ((unsigned long long)hi << 32) | lo;
+		#endif
+			return (xcr0 & 0x6) == 0x6;
+		}
+
+		// the stencils are pure float math, which AVX (not AVX2) already covers at 8 lanes
+		FDTDKernelISA DetectISA()
+		{
+			int regs[4];
+			CPUID(0, 0, regs);
+			if (regs[0] < 1)
+				return ki_Scalar;
+
+			CPUID(1, 0, regs);
+			const bool sse = (regs[3] & (1 << 25)) != 0;
+			const bool osxsave = (regs[2] & (1 << 27)) != 0;
+			const bool avx = (regs[2] & (1 << 28)) != 0;
+
+			if (avx && osxsave && OSSupportsAVX())
+				return ki_AVX;
+			if (sse)
+				return ki_SSE;
+			return ki_Scalar;
+		}
+
+		// kernel set of isa, or of the widest ISA below it the CPU supports
+		FDTDKernels MakeKernels(FDTDKernelISA isa)
+		{
+			const FDTDKernelISA detected = DetectISA();
+			FDTDKernels kernels;
+			kernels.isa = (isa < detected) ? isa : detected;
+			switch (kernels.isa)
+			{
+			case ki_AVX:
+				kernels.updatePressure = UpdatePressureAVX;
+				kernels.updateVelocity = UpdateVelocityAVX;
+				kernels.storeResponse = StoreResponseAVX;
+				break;
+			case ki_SSE:
+				kernels.updatePressure = UpdatePressureSSE;
+				kernels.updateVelocity = UpdateVelocitySSE;
+				kernels.storeResponse = StoreResponseSSE;
+				break;
+			default:
+				kernels.updatePressure = UpdatePressureScalar;
+				kernels.updateVelocity = UpdateVelocityScalar;
+				kernels.storeResponse = StoreResponseScalar;
+				break;
+			}
+			return kernels;
+		}
+		#pragma endregion
+	} // namespace <>
+
+	const FDTDKernels& GetFDTDKernels()
+	{
+		return GetFDTDKernels(ki_AVX);
+	}
+
+	const FDTDKernels& GetFDTDKernels(FDTDKernelISA isa)
+	{
+		// thread-safe static init, runs detection once
+		static const FDTDKernels s_kernels[] = { MakeKernels(ki_Scalar), MakeKernels(ki_SSE), MakeKernels(ki_AVX) };
+		return s_kernels[isa];
+	}
+} // namespace Planeverb
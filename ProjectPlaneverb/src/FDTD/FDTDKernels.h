@@ -0,0 +1,44 @@
+#pragma once
+#include <PvTypes.h>	// Real
+
+namespace Planeverb
+{
+	// Instruction set used by the FDTD update kernels
+	enum FDTDKernelISA
+	{
+		ki_Scalar,
+		ki_SSE,
+		ki_AVX,		// 8-wide float math only, so AVX2 isn't required
+	};
+
+	// Update kernels for the structure-of-arrays grid.
+	// Each kernel processes the linear cell range [begin, end), so callers can hand out rows to threads.
+	// Every ISA performs the same float operations in the same order as the scalar path,
+	// so results are bit-identical no matter which kernel gets dispatched.
+	struct FDTDKernels
+	{
+		// pr[i] = beta[i] * (pr[i] - courant * ((vx[i + stride] - vx[i]) + (vy[i + 1] - vy[i])))
+		void(*updatePressure)(Real* pr, const Real* vx, const Real* vy, const Real* beta,
+			unsigned begin, unsigned end, unsigned stride, Real courant);
+
+		// velocity component update between cell i and its neighbour i - stride
+		// (stride is the row length for vx and 1 for vy)
+		void(*updateVelocity)(Real* v, const Real* pr, const Real* beta, const Real* admittance,
+			unsigned begin, unsigned end, unsigned stride, Real courant);
+
+		// dst[i] = src[i] for i in [begin, end), bypassing the cache where the ISA allows it.
+		// the response cube is written once per step and read after the simulation,
+		// so it shouldn't evict the field planes. the stores aren't fenced, fencing every call stalls on the
+		// write combining buffers, so callers _mm_sfence once before the responses are read
+		void(*storeResponse)(Real* dst, const Real* src, unsigned begin, unsigned end);
+
+		FDTDKernelISA isa;
+	};
+
+	// Returns the fastest kernel set supported by the running CPU, detected once
+	const FDTDKernels& GetFDTDKernels();
+
+	// Returns the kernel set of isa, or of the widest ISA below it the CPU supports (check the set's isa).
+	// for comparing the ISAs, the simulation always uses the fastest set
+	const FDTDKernels& GetFDTDKernels(FDTDKernelISA isa);
+} // namespace Planeverb
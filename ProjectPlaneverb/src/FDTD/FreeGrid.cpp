@@ -1,22 +1,40 @@
 #include <FDTD\FreeGrid.h>
 #include <PvDefinitions.h>
 #include <cmath>
+#include <vector>
 
 namespace Planeverb
 { 
+	namespace
+	{
+		// the temporary grid always stores responses since only one is read back, and only its pressure is needed.
+		// it has a single listener whatever the context simulates
+		// the free field energy is the reference for every cell, so it's always simulated in full
+		PlaneverbConfig GetTemporaryGridConfig(const PlaneverbConfig* config)
+		{
+			PlaneverbConfig gridConfig = *config;
+			gridConfig.analysisMode = pv_StoredResponseAnalysis;
+			gridConfig.responseChannels = pv_ResponsePressureOnly;
+			gridConfig.simulationLength = pv_FixedSimulationLength;
+			gridConfig.listenerCount = 1;
+			return gridConfig;
+		}
+	} // namespace <>
+
 	FreeGrid::FreeGrid(const PlaneverbConfig * config, char* mem) : 
 		m_grid(nullptr),
         m_dx(0),
 		m_EFree(0.f)
 	{
 		// make a new temporary grid
-		unsigned size = Grid::GetMemoryRequirement(config);
+		PlaneverbConfig gridConfig = GetTemporaryGridConfig(config);
+		size_t size = Grid::GetMemoryRequirement(&gridConfig);
 		char* temporaryPool = new char[size];
 		if (!temporaryPool)
 		{
 			throw pv_NotEnoughMemory;
 		}
-		m_grid = new Grid(config, temporaryPool);
+		m_grid = new Grid(&gridConfig, temporaryPool);
 		if (!m_grid)
 		{
 			throw pv_NotEnoughMemory;
@@ -64,11 +82,18 @@ namespace Planeverb
         return m_EFree;
     }
 
-	unsigned FreeGrid::GetMemoryRequirement(const PlaneverbConfig * config)
+	size_t FreeGrid::GetMemoryRequirement(const PlaneverbConfig * config)
 	{
 		return 0;
 	}
 
+	// the temporary grid only lives during construction, but it counts towards peak memory
+	size_t FreeGrid::GetTemporaryMemoryRequirement(const PlaneverbConfig * config)
+	{
+		PlaneverbConfig gridConfig = GetTemporaryGridConfig(config);
+		return Grid::GetMemoryRequirement(&gridConfig);
+	}
+
 	Real FreeGrid::SimulateFreeFieldEnergy(const PlaneverbConfig* config)
 	{
 		vec2i gridScale = m_grid->GetGridSize();
@@ -83,8 +108,9 @@ namespace Planeverb
 
 		// generate a set of IRs in the grid, calculate the free energy
 		m_grid->GenerateResponse(vec3(listenerX * m_dx, 0, listenerY * m_dx));
-		const Cell* response = m_grid->GetResponse(vec2i(emitterX,emitterY));
-        Real freeFieldEnergy = CalculateEFree(response, m_grid->GetResponseSize(), (int)m_grid->GetSamplingRate());
+		std::vector<Cell> response(m_grid->GetResponseSize());
+		m_grid->GetResponse(vec2i(emitterX,emitterY), 0, response.data());
+        Real freeFieldEnergy = CalculateEFree(response.data(), m_grid->GetResponseSize(), (int)m_grid->GetSamplingRate());
 
         // discrete distance on grid
         const Real r = Real(emitterX - listenerX) * m_dx;
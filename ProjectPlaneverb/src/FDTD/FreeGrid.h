@@ -12,7 +12,8 @@ namespace Planeverb
 
 		Real GetEFreePerR(int listenerIndX, int listenerIndY, int emitterIndX, int emitterIndY);
         Real GetEnergyAtOneMeter() const;
-        static unsigned GetMemoryRequirement(const struct PlaneverbConfig* config);
+        static size_t GetMemoryRequirement(const struct PlaneverbConfig* config);
+		static size_t GetTemporaryMemoryRequirement(const struct PlaneverbConfig* config);
 
 	private:
 		Real SimulateFreeFieldEnergy(const PlaneverbConfig* config);
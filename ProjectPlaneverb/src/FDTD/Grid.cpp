@@ -2,12 +2,17 @@
 #include <PvDefinitions.h>
 #include <cmath>
 #include <cstring>
+#include <cstdint>
 #include <iostream>
+#include <algorithm>
 
 namespace Planeverb
 {
 	namespace
 	{
+		// alignment of each field plane in bytes, one cache line
+		const constexpr unsigned PV_GRID_ALIGNMENT = 64;
+
 		// Fill a given array with a precomputed Gaussian pulse
 		void GaussianPulse(const PlaneverbConfig* config, Real samplingRate, Real* out, unsigned numSamples)
 		{
@@ -25,20 +30,85 @@ namespace Planeverb
 				*out++ = val;
 			}
 		}
+
+		// number of cells per field plane: the grid plus a ghost row and cell for the extended velocity fields,
+		// rounded up so that every plane stays cache line aligned
+		unsigned GetPlaneLength(const vec2i& gridSize)
+		{
+			const unsigned realsPerLine = PV_GRID_ALIGNMENT / sizeof(Real);
+			const unsigned length = (gridSize.x + 1) * gridSize.y + 1;
+			return (length + realsPerLine - 1) / realsPerLine * realsPerLine;
+		}
+
+		// number of cells per channel slice of the response cube, rounded up to keep each slice cache line aligned
+		unsigned GetResponseSliceLength(const vec2i& gridSize)
+		{
+			const unsigned realsPerLine = PV_GRID_ALIGNMENT / sizeof(Real);
+			const unsigned length = gridSize.x * gridSize.y;
+			return (length + realsPerLine - 1) / realsPerLine * realsPerLine;
+		}
+
+		// number of fields stored per cell and sample, 0 when responses aren't stored
+		unsigned GetResponseChannelCount(const PlaneverbConfig* config)
+		{
+			if (config->analysisMode != pv_StoredResponseAnalysis)
+				return 0;
+			return (config->responseChannels == pv_ResponsePressureOnly) ? 1 : 3;
+		}
+
+		// energy ratio to the peak that ends an adaptive simulation, 0 keeps the fixed length
+		Real GetDecayThreshold(const PlaneverbConfig* config)
+		{
+			if (config->simulationLength != pv_AdaptiveSimulationLength)
+				return (Real)0.f;
+			if (config->adaptiveDecayThresholdDB == (Real)0.f)
+				return PV_AUDIBLE_THRESHOLD_GAIN * PV_AUDIBLE_THRESHOLD_GAIN;
+			return (Real)std::pow(10.0, (double)config->adaptiveDecayThresholdDB / 10.0);
+		}
+
+		// tile counts of the active region scheduler
+		vec2i GetTileCounts(const vec2i& gridSize)
+		{
+			return vec2i((gridSize.x + PV_TILE_ROWS - 1) / PV_TILE_ROWS, (gridSize.y + PV_TILE_COLUMNS - 1) / PV_TILE_COLUMNS);
+		}
+
+		// tile activation steps
+		size_t GetTileMemoryRequirement(const vec2i& gridSize)
+		{
+			const vec2i tiles = GetTileCounts(gridSize);
+			return sizeof(unsigned) * (size_t)tiles.x * tiles.y;
+		}
+
+		// wall admittance Y for an absorption parameter R
+		PV_INLINE Real GetAdmittance(Real R)
+		{
+			return (1.f - R) / (1.f + R);
+		}
 	} // namespace <>
 
 	Grid::Grid(const PlaneverbConfig* config, char* mem) :
 		m_mem(mem),
-		m_grid(nullptr),
-		m_boundaries(nullptr),
-		m_pulseResponse(nullptr),
+		m_pr(nullptr), m_vx(nullptr), m_vy(nullptr),
+		m_beta(nullptr),
+		m_admittance(nullptr),
+		m_planeLength(),
+		m_listenerCount(config->listenerCount), m_listenerStride(),
+		m_response(nullptr),
+		m_responseCubeLength(),
+		m_responseChannels(GetResponseChannelCount(config)),
+		m_responseSliceLength(),
+		m_streamingAnalyzers(),
 		m_pulse(nullptr),
 		m_dx(), m_dt(),
 		m_gridSize(), m_gridDimensions(config->gridSizeInMeters), m_gridOffset(), m_responseLength(),
+		m_simulatedLength(), m_rowEnergy(nullptr), m_decayThreshold(GetDecayThreshold(config)),
+		m_tileBands(), m_tilesPerBand(), m_tileActivation(nullptr),
+		m_hasChangedRegion(false), m_changedFirst(), m_changedLast(),
 		m_samplingRate(),
 		m_resolution(config->gridResolution),
 		m_executionType(config->threadExecutionType),
-		m_maxThreads(config->maxThreadUsage)
+		m_maxThreads(config->maxThreadUsage),
+		m_analysisMode(config->analysisMode)
 	{
 		// calculate internals
 		m_gridOffset = config->gridWorldOffset;
@@ -49,19 +119,23 @@ namespace Planeverb
 		m_gridSize.y = static_cast<unsigned>((1.f / m_dx) * m_gridDimensions.y + 1.0f);
 
 		// calculate total memory size
-		// length per grid uses gridsize + 1 for extended velocity fields
+		// planes use gridsize + 1 row for extended velocity fields
 		unsigned lengthPerGrid = m_gridSize.x * m_gridSize.y ;
-		unsigned sizePerBoundary = sizeof(BoundaryInfo) * lengthPerGrid;
-		unsigned lengthPerResponse = (unsigned)(m_samplingRate * PV_IMPULSE_RESPONSE_S); 
-		unsigned size =
-			lengthPerResponse * sizeof(Real) +	// memory for Gaussian pulse values
-			lengthPerGrid * sizeof(Cell) +		// memory for Cell grid
-			sizePerBoundary +	// memory for boundary information
-
-			/// memory for pulse response Cell[x][y][t]
-			///sizePerGrid * lengthPerResponse;
-			// memory for pulse response std::vector<Cell>[x][y]
-			lengthPerGrid * sizeof(std::vector<Cell>);
+		m_planeLength = GetPlaneLength(m_gridSize);
+		size_t sizePerPlane = sizeof(Real) * (size_t)m_planeLength;
+		unsigned lengthPerResponse = CalculateResponseLength(config, m_samplingRate);
+		const bool storeResponses = (m_responseChannels != 0);
+		m_responseSliceLength = GetResponseSliceLength(m_gridSize);
+		size_t sizePerResponseCube = sizeof(Real) * (size_t)m_responseSliceLength * m_responseChannels * lengthPerResponse;
+		size_t sizeRowEnergy = (m_decayThreshold > (Real)0.f) ? m_gridSize.x * sizeof(double) : 0;
+		size_t sizeTiles = GetTileMemoryRequirement(m_gridSize);
+		size_t size =
+			PV_GRID_ALIGNMENT +					// slack to align the planes
+			sizePerPlane * (3 * m_listenerCount + 2) +	// memory for pr, vx, vy per listener, beta and admittance planes
+			sizePerResponseCube * m_listenerCount +		// memory for pulse response cubes [t][channel][cell]
+			sizeRowEnergy * m_listenerCount +	// memory for the per row field energy
+			sizeTiles * m_listenerCount +		// memory for the active region tiles
+			lengthPerResponse * sizeof(Real);	// memory for Gaussian pulse values
 
 		// allocate memory pool, throw for operator new fails. set memory to zero
 		if (!m_mem)
@@ -70,47 +144,36 @@ namespace Planeverb
 		}
 		std::memset(m_mem, 0, size);
 
-		// set grids and arrays offset into pool
-		char* temp = m_mem;
-		m_pulse = reinterpret_cast<Real*>(temp);				temp += lengthPerResponse * sizeof(Real);
-		m_grid = reinterpret_cast<Cell*>(temp);					temp += lengthPerGrid * sizeof(Cell);
-		m_boundaries = reinterpret_cast<BoundaryInfo*>(temp);	temp += sizePerBoundary;
-		m_pulseResponse = reinterpret_cast<std::vector<Cell>*>(temp);
+		// set grids and arrays offset into pool, planes first so they all stay aligned
+		char* temp = m_mem + (PV_GRID_ALIGNMENT - reinterpret_cast<std::uintptr_t>(m_mem) % PV_GRID_ALIGNMENT) % PV_GRID_ALIGNMENT;
+		m_listenerStride = 3 * (size_t)m_planeLength;
+		m_pr = reinterpret_cast<Real*>(temp);
+		m_vx = reinterpret_cast<Real*>(temp + sizePerPlane);
+		m_vy = reinterpret_cast<Real*>(temp + 2 * sizePerPlane);		temp += 3 * sizePerPlane * m_listenerCount;
+		m_beta = reinterpret_cast<Real*>(temp);							temp += sizePerPlane;
+		m_admittance = reinterpret_cast<Real*>(temp);					temp += sizePerPlane;
+		m_responseCubeLength = sizePerResponseCube / sizeof(Real);
+		m_response = storeResponses ? reinterpret_cast<Real*>(temp) : nullptr;		temp += sizePerResponseCube * m_listenerCount;
+		m_rowEnergy = sizeRowEnergy ? reinterpret_cast<double*>(temp) : nullptr;	temp += sizeRowEnergy * m_listenerCount;
+
+		const vec2i tiles = GetTileCounts(m_gridSize);
+		m_tileBands = tiles.x;
+		m_tilesPerBand = tiles.y;
+		m_tileActivation = reinterpret_cast<unsigned*>(temp);			temp += sizeTiles * m_listenerCount;
+		m_pulse = reinterpret_cast<Real*>(temp);
 
-		vec2i incGridSize(m_gridSize.x , m_gridSize.y );
 		m_responseLength = lengthPerResponse;
+		m_simulatedLength = lengthPerResponse;
 
-		// init the boundary layer
-		for (unsigned i = 0; i < incGridSize.x; ++i)
-			for (unsigned j = 0; j < incGridSize.y; ++j)
-				m_boundaries[INDEX(i, j, incGridSize)] = BoundaryInfo{ vec2((Real)0.f, (Real)0.f), PV_ABSORPTION_FREE_SPACE };
+		// init the admittance field to free space, including the ghost row
+		const Real freeSpaceAdmittance = GetAdmittance(PV_ABSORPTION_FREE_SPACE);
+		for (unsigned i = 0; i < m_planeLength; ++i)
+			m_admittance[i] = freeSpaceAdmittance;
 
-		// init the b and by field
-		unsigned numBIterations = incGridSize.x * incGridSize.y;
-		for (unsigned i = 0; i < numBIterations; ++i)
+		// init the B field, ghost row stays 0
+		for (unsigned i = 0; i < lengthPerGrid; ++i)
 		{
-			unsigned row = i / incGridSize.y;
-			unsigned col = i % incGridSize.y;
-			if (row == m_gridSize.x || col == m_gridSize.y)
-			{
-				// TODO: delete this? this will never be entered
-				m_grid[i].b = 0;
-				m_grid[i].by = 0;
-			}
-			else if (col == 0)
-			{
-				m_grid[i].b = 1;
-				m_grid[i].by = 0;
-			}
-			else
-			{
-				m_grid[i].b = 1;
-				m_grid[i].by = 1;
-			}
-
-			// initialize pulseResponse
-			new (&m_pulseResponse[i]) std::vector<Cell>(); // placement new to call ctor
-			m_pulseResponse[i].resize(lengthPerResponse, Cell());
+			m_beta[i] = (Real)1.f;
 		}
 
 		// precompute Gaussian pulse
@@ -119,19 +182,9 @@ namespace Planeverb
 
 	Grid::~Grid()
 	{
-		if (m_mem)
-		{
-			unsigned loopSize = m_gridSize.x * m_gridSize.y;
-			// destruct each vector
-			for (unsigned i = 0; i < loopSize; ++i)
-			{
-				m_pulseResponse[i].~vector();
-			}
-
-			// delete the pool
-			//delete[] m_mem;
-			//m_mem = nullptr;
-		}
+		// everything lives in the pool, which is owned by the caller
+		//delete[] m_mem;
+		//m_mem = nullptr;
 	}
 
 	void Grid::AddAABB(const AABB * transform)
@@ -144,6 +197,9 @@ namespace Planeverb
 		
 		const vec2i newGridSize(m_gridSize.x, m_gridSize.y);
 
+		// only the touched cells need their derived coefficients rebuilt
+		const Real admittance = GetAdmittance(transform->absorption);
+
 		/*
 		// top
 		if (startY >= 0 && startY < m_gridSize.y)
@@ -236,15 +292,13 @@ namespace Planeverb
 					if (j >= 0 && j <= m_gridSize.x)
 					{
 						unsigned index = INDEX(j, i, newGridSize);
-						m_boundaries[index].normal = vec2(0, 0);
-						m_boundaries[index].absorption = transform->absorption;
-
-						m_grid[index].b = 0;
-						m_grid[index].by = 0;
+						m_admittance[index] = admittance;
+						m_beta[index] = (Real)0.f;
 					}
 				}
 			}
 		}
+		MarkChanged(startX, endX, startY, endY);
 	}
 
 	void Grid::RemoveAABB(const AABB * transform)
@@ -256,6 +310,7 @@ namespace Planeverb
 		unsigned endX   = (unsigned)((transform->position.x + transform->width  / (Real)2.f + m_gridOffset.x) * ((Real)1.f / m_dx));
 
 		vec2i newGridSize(m_gridSize.x, m_gridSize.y );
+		const Real freeSpaceAdmittance = GetAdmittance(PV_ABSORPTION_FREE_SPACE);
 
 		// reset area of the AABB
 		for (unsigned i = startY; i < endY; ++i)
@@ -267,33 +322,50 @@ namespace Planeverb
 					if (j >= 0 && j <= m_gridSize.x)
 					{
 						unsigned index = INDEX(j, i, newGridSize);
-						m_boundaries[index].normal = vec2(0, 0);
-						m_boundaries[index].absorption = PV_ABSORPTION_FREE_SPACE;
-						
-						m_grid[index].b = 1;
-						m_grid[index].by = 1;
+						m_admittance[index] = freeSpaceAdmittance;
 
-						
 						if (i == m_gridSize.x || j == m_gridSize.y)
 						{
-							m_grid[index].b = 0;
-							m_grid[index].by = 0;
-						}
-						else if (j == 0)
-						{
-							m_grid[index].b = 1;
-							m_grid[index].by = 0;
+							m_beta[index] = (Real)0.f;
 						}
 						else
 						{
-							m_grid[index].b = 1;
-							m_grid[index].by = 1;
+							m_beta[index] = (Real)1.f;
 						}
 						
 					}
 				}
 			}
 		}
+		MarkChanged(startX, endX, startY, endY);
+	}
+
+	// grows the changed region by rows [firstRow, endRow) and columns [firstColumn, endColumn), clipped to the grid
+	void Grid::MarkChanged(unsigned firstRow, unsigned endRow, unsigned firstColumn, unsigned endColumn)
+	{
+		endRow = std::min(endRow, m_gridSize.x);
+		endColumn = std::min(endColumn, m_gridSize.y);
+		if (firstRow >= endRow || firstColumn >= endColumn)
+			return;
+
+		if (!m_hasChangedRegion)
+		{
+			m_changedFirst = vec2i(firstRow, firstColumn);
+			m_changedLast = vec2i(endRow - 1, endColumn - 1);
+			m_hasChangedRegion = true;
+			return;
+		}
+		m_changedFirst = vec2i(std::min(m_changedFirst.x, firstRow), std::min(m_changedFirst.y, firstColumn));
+		m_changedLast = vec2i(std::max(m_changedLast.x, endRow - 1), std::max(m_changedLast.y, endColumn - 1));
+	}
+
+	bool Grid::GetChangedRegion(vec2i& first, vec2i& last) const
+	{
+		if (!m_hasChangedRegion)
+			return false;
+		first = m_changedFirst;
+		last = m_changedLast;
+		return true;
 	}
 
 	void Grid::UpdateAABB(const AABB * oldTransform, const AABB * newTransform)
@@ -339,8 +411,7 @@ namespace Planeverb
 					}
 				}*/
 
-				const Cell& cell = m_grid[index];
-				if (cell.b || cell.by)
+				if (m_beta[index] != (Real)0.f)
 				{
 					std::cout << " .";
 				}
@@ -357,7 +428,7 @@ namespace Planeverb
 		std::cout << std::endl;
 	}
 
-	unsigned Grid::GetMemoryRequirement(const PlaneverbConfig * config)
+	size_t Grid::GetMemoryRequirement(const PlaneverbConfig * config)
 	{
 		// calculate internals
 		vec2 m_gridOffset = config->gridWorldOffset;
@@ -371,19 +442,20 @@ namespace Planeverb
 		m_gridSize.y = (unsigned)((1.f / m_dx) * config->gridSizeInMeters.y + 1);
 
 		// calculate total memory size
-		// length per grid uses gridsize + 1 for extended velocity fields
-		unsigned lengthPerGrid = m_gridSize.x * m_gridSize.y;
-		unsigned sizePerBoundary = sizeof(BoundaryInfo) * lengthPerGrid;
-		unsigned lengthPerResponse = (unsigned)(m_samplingRate * PV_IMPULSE_RESPONSE_S);
-		unsigned size =
-			lengthPerResponse * sizeof(Real) +	// memory for Gaussian pulse values
-			lengthPerGrid * sizeof(Cell) +		// memory for Cell grid
-			sizePerBoundary +	// memory for boundary information
-
-			/// memory for pulse response Cell[x][y][t]
-			///sizePerGrid * lengthPerResponse;
-			// memory for pulse response std::vector<Cell>[x][y]
-			lengthPerGrid * sizeof(std::vector<Cell>);
+		// planes use gridsize + 1 row for extended velocity fields
+		size_t sizePerPlane = sizeof(Real) * (size_t)GetPlaneLength(m_gridSize);
+		unsigned lengthPerResponse = CalculateResponseLength(config, m_samplingRate);
+		unsigned responseChannels = GetResponseChannelCount(config);
+		size_t sizePerResponseCube = sizeof(Real) * (size_t)GetResponseSliceLength(m_gridSize) * responseChannels * lengthPerResponse;
+		size_t sizeRowEnergy = (GetDecayThreshold(config) > (Real)0.f) ? m_gridSize.x * sizeof(double) : 0;
+		const unsigned listenerCount = config->listenerCount;
+		size_t size =
+			PV_GRID_ALIGNMENT +					// slack to align the planes
+			sizePerPlane * (3 * listenerCount + 2) +	// memory for pr, vx, vy per listener, beta and admittance planes
+			sizePerResponseCube * listenerCount +		// memory for pulse response cubes [t][channel][cell]
+			sizeRowEnergy * listenerCount +		// memory for the per row field energy
+			GetTileMemoryRequirement(m_gridSize) * listenerCount +	// memory for the active region tiles
+			lengthPerResponse * sizeof(Real);	// memory for Gaussian pulse values
 
 		return size;
 	}
@@ -395,4 +467,10 @@ namespace Planeverb
 		dt = dx / (PV_C * Real(1.5));
 		samplingRate = (unsigned)(Real(1.0) / dt);
 	}
+
+	unsigned CalculateResponseLength(const PlaneverbConfig* config, unsigned samplingRate)
+	{
+		const Real seconds = (config->responseLengthInSeconds > (Real)0.f) ? config->responseLengthInSeconds : PV_IMPULSE_RESPONSE_S;
+		return (unsigned)(samplingRate * seconds);
+	}
 } // namespace Planeverb
@@ -2,24 +2,22 @@
 #include "PvTypes.h"
 #include <vector>
 #include <mutex>
+#include <atomic>
 
 namespace Planeverb
 {
-	void CalculateGridParameters(int resolution, Real& dx, Real& dt, unsigned& samplingRate);
+	class Analyzer;
 
-	// struct to represent wall information
-	// 12 bytes
-	struct BoundaryInfo
-	{
-		vec2 normal;		// wall normal, (0, 0) if no wall
-		Real absorption;	// absorption coefficient, 0 if free space
-		BoundaryInfo(const vec2& n = vec2(0, 0), Real a = Real(1.0)) :
-			normal(n),
-			absorption(a)
-		{}
-
-		BoundaryInfo& operator=(const BoundaryInfo&) = default;
-	};
+	// active region tiles, one band of rows by a run of columns. 64 columns are 4 cache lines per row
+	const constexpr unsigned PV_TILE_ROWS = 16;
+	const constexpr unsigned PV_TILE_COLUMNS = 64;
+	const constexpr unsigned PV_TILE_NEVER = (unsigned)(-1);	// activation step of tiles that never need updating
+
+	// time steps in flight in the temporal blocking pipeline of GenerateResponseCPU, split into one group per thread
+	const constexpr unsigned PV_TEMPORAL_BLOCK_STEPS = 8;
+
+	void CalculateGridParameters(int resolution, Real& dx, Real& dt, unsigned& samplingRate);
+	unsigned CalculateResponseLength(const PlaneverbConfig* config, unsigned samplingRate);
 
 	// Grid system
 	class Grid
@@ -29,11 +27,18 @@ namespace Planeverb
 		Grid(const PlaneverbConfig* config, char* mem);
 		~Grid();
 
-		void GenerateResponseCPU(const vec3& listener);
-		void GenerateResponseGPU(const vec3& listener);
-		void GenerateResponse(const vec3& listener);
-		Cell* GetResponse(const vec2i& gridPosition);
+		// simulates every listener in one pass, listeners holds GetListenerCount() positions.
+		// the simulation checks cancel every few time steps and stops if it is set, returning false. the responses
+		// and streamed analysis state are incomplete then, GetSimulatedResponseSize is the step it stopped at
+		bool GenerateResponseCPU(const vec3* listeners, const std::atomic<bool>* cancel = nullptr);
+		bool GenerateResponseGPU(const vec3* listeners, const std::atomic<bool>* cancel = nullptr);
+		bool GenerateResponses(const vec3* listeners, const std::atomic<bool>* cancel = nullptr);
+		void GenerateResponse(const vec3& listener) { GenerateResponses(&listener); }	// grids with one listener
+		bool GetResponse(const vec2i& gridPosition, unsigned listener, Cell* out) const;	// out holds GetResponseSize() cells
+		unsigned GatherResponses(unsigned listener, unsigned firstCell, unsigned count, Cell* out) const;
 		unsigned GetResponseSize() const;
+		unsigned GetSimulatedResponseSize() const { return m_simulatedLength; }
+		size_t GetCellUpdates() const;	// cells the last simulation advanced, summed over its time steps and listeners
 
 		unsigned GetSamplingRate() const { return m_samplingRate; }
 		unsigned GetMaxThreads() const { return m_maxThreads; }
@@ -41,23 +46,55 @@ namespace Planeverb
 		const vec2& GetGridOffset() const { return m_gridOffset; }
 		Real GetDX() const { return m_dx; }
 		int GetResolution() const { return m_resolution; }
+		PlaneverbAnalysisMode GetAnalysisMode() const { return m_analysisMode; }
+		unsigned GetListenerCount() const { return m_listenerCount; }
+		bool IsOpenCell(const vec2i& gridPosition) const { return m_beta[gridPosition.x * m_gridSize.y + gridPosition.y] != (Real)0.f; }	// false inside geometry
+
+		// in streaming mode each listener's analyzer is fed every time step instead of reading a stored response
+		void SetStreamingAnalyzer(Analyzer* analyzer, unsigned listener) { m_streamingAnalyzers[listener] = analyzer; }
 
 		void AddAABB(const AABB* transform);
 		void RemoveAABB(const AABB* transform);
 		void UpdateAABB(const AABB* oldTransform, const AABB* newTransform);
 
+		// box of cells (inclusive rows in x, columns in y) touched by AddAABB/RemoveAABB since the last
+		// ClearChangedRegion, false if there were none
+		bool GetChangedRegion(vec2i& first, vec2i& last) const;
+		void ClearChangedRegion() { m_hasChangedRegion = false; }
+
+		// time steps before anything in the box [first, last] can affect a cell, less a safety margin.
+		// a change in the box only alters the cell's response if the distance from the listener to the
+		// box plus the distance from the box to the cell fits in the simulated length
+		unsigned GetStepDistance(const vec2i& cell, const vec2i& first, const vec2i& last) const;
+
 		void PrintGrid();
-		static unsigned GetMemoryRequirement(const struct PlaneverbConfig* config);
+		static size_t GetMemoryRequirement(const struct PlaneverbConfig* config);
 	private:
+		void PrepareActiveTiles(unsigned listenerRow, unsigned listenerColumn, unsigned* tileActivation);
+		void MarkChanged(unsigned firstRow, unsigned endRow, unsigned firstColumn, unsigned endColumn);
+
 		char* m_mem;								// memory pool
-		Cell* m_grid;								// cell grid
-		BoundaryInfo* m_boundaries;					// wall information
 
-		// originally used a 3D array of Cells for pulse response, 
-		// but each access to it was probably a cache miss because of the length
-		// of each response anyway, so 
-		// it has been converted to being a 2D array of std::vectors
-		std::vector<Cell>* m_pulseResponse;
+		// structure-of-arrays cell grid, each plane is cache line aligned and holds
+		// the grid plus a ghost row for the extended velocity fields.
+		// every listener has its own pressure and velocity planes, m_listenerStride apart
+		Real* m_pr;									// air pressure
+		Real* m_vx;									// x component of particle velocity
+		Real* m_vy;									// y component of particle velocity
+		Real* m_beta;								// B field, 1 for air and 0 for walls
+		Real* m_admittance;							// wall admittance (1 - R) / (1 + R), kept up to date by AddAABB/RemoveAABB
+		unsigned m_planeLength;						// number of cells per plane
+		unsigned m_listenerCount;					// listeners simulated together
+		size_t m_listenerStride;					// distance between the field planes of consecutive listeners
+
+		// pulse response cube per listener, stored time-major in the pool as [t][channel][cell] so every step
+		// is written as one contiguous block. the B field is constant over time and isn't stored,
+		// GatherResponses rebuilds Cells from it. nullptr in streaming analysis mode
+		Real* m_response;
+		size_t m_responseCubeLength;				// distance between the cubes of consecutive listeners
+		unsigned m_responseChannels;				// channels per step, 1 for pressure only, 3 with velocity
+		unsigned m_responseSliceLength;				// cells per channel slice, padded to a cache line
+		Analyzer* m_streamingAnalyzers[PV_MAX_LISTENERS];	// analyzers fed during the simulation, streaming mode only
 
 		Real* m_pulse;								// precomputed Gaussian pulse
 
@@ -67,9 +104,24 @@ namespace Planeverb
 		vec2 m_gridDimensions;						// grid size (in meters)
 		vec2 m_gridOffset;							// our grid uses only first quadrant, user uses all four, not currently implemented fully
 		unsigned m_responseLength;					// number of samples for an IR
+		unsigned m_simulatedLength;					// samples produced by the last simulation, less than m_responseLength if it stopped early
+		double* m_rowEnergy;						// field energy per listener and grid row, adaptive simulation length only
+		Real m_decayThreshold;						// energy relative to the peak that ends an adaptive simulation, 0 if fixed
+
+		// active region: tiles are only updated once the wavefront can have reached them,
+		// tiles that are solid along with the cells their velocities read are never updated
+		unsigned m_tileBands;						// tile rows, PV_TILE_ROWS grid rows each
+		unsigned m_tilesPerBand;					// tiles per band, PV_TILE_COLUMNS grid columns each
+		unsigned* m_tileActivation;					// per listener, first time step each tile is updated, PV_TILE_NEVER if solid
+
+		// geometry edits not simulated yet, see GetChangedRegion
+		bool m_hasChangedRegion;
+		vec2i m_changedFirst;
+		vec2i m_changedLast;
 		unsigned m_samplingRate;					// samples per second
 		PlaneverbExecutionType m_executionType;		// use CPU or GPU (only CPU implemented so far)
 		unsigned m_maxThreads;						// thread usage
 		int m_resolution;							// grid resolution
+		PlaneverbAnalysisMode m_analysisMode;		// stored or streaming analysis
 	};
 } // namespace Planeverb
@@ -10,10 +10,14 @@ namespace Planeverb
 	PlaneObjectID AddGeometry(const AABB* transform)
 	{
 		auto* context = GetContext();
-		if (context)
+		auto* man = context ? context->GetGeometryManager() : nullptr;
+
+		// case module hasn't been created yet or runs on baked probes
+		if (man)
 		{
-			auto* man = context->GetGeometryManager();
-			return man->AddObject(transform);
+			const PlaneObjectID id = man->AddObject(transform);
+			context->RequestUpdate();
+			return id;
 		}
 		else
 		{
@@ -24,20 +28,22 @@ namespace Planeverb
 	void UpdateGeometry(PlaneObjectID id, const AABB* newTransform)
 	{
 		auto* context = GetContext();
-		if (context)
+		auto* man = context ? context->GetGeometryManager() : nullptr;
+		if (man)
 		{
-			auto* man = context->GetGeometryManager();
 			man->UpdateObject(id, newTransform);
+			context->RequestUpdate();
 		}
 	}
 
 	void RemoveGeometry(PlaneObjectID id)
 	{
 		auto* context = GetContext();
-		if (context)
+		auto* man = context ? context->GetGeometryManager() : nullptr;
+		if (man)
 		{
-			auto* man = context->GetGeometryManager();
 			man->RemoveObject(id);
+			context->RequestUpdate();
 		}
 	}
 
@@ -150,7 +156,7 @@ namespace Planeverb
 			m_gridPtr->PrintGrid();
 		#endif
 	}
-	unsigned GeometryManager::GetMemoryRequirement(const PlaneverbConfig * config)
+	size_t GeometryManager::GetMemoryRequirement(const PlaneverbConfig * config)
 	{
 		return 0;
 	}
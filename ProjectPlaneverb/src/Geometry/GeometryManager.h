@@ -21,7 +21,7 @@ namespace Planeverb
 
 		void PushGeometryChanges();
 
-		static unsigned GetMemoryRequirement(const struct PlaneverbConfig* config);
+		static size_t GetMemoryRequirement(const struct PlaneverbConfig* config);
 
 	private:
 		// Internal type for geometry changes
@@ -0,0 +1,103 @@
+#include <Util\MappedFile.h>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+namespace Planeverb
+{
+	namespace
+	{
+		// smallest page size, touching one byte per page faults in all of them
+		const constexpr size_t PAGE_STRIDE = 4096;
+	} // namespace <>
+
+	MappedFile::MappedFile() :
+		m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr), m_size(0), m_granularity(0)
+	{
+		// view offsets have to be multiples of the allocation granularity, not just the page size
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		m_granularity = info.dwAllocationGranularity;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const char* filePath)
+	{
+		Close();
+
+		// chunks are read in whatever order listeners move, read ahead wouldn't help
+		m_file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size) || size.QuadPart <= 0)
+		{
+			Close();
+			return false;
+		}
+		m_size = (uint64_t)size.QuadPart;
+
+		m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_mapping == nullptr)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_mapping != nullptr)
+		{
+			CloseHandle(m_mapping);
+			m_mapping = nullptr;
+		}
+		if (m_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(m_file);
+			m_file = INVALID_HANDLE_VALUE;
+		}
+		m_size = 0;
+	}
+
+	const char* MappedFile::Map(uint64_t offset, size_t size, void** view) const
+	{
+		*view = nullptr;
+		if (m_mapping == nullptr || size == 0 || offset > m_size || size > m_size - offset)
+			return nullptr;
+
+		// the view starts at the granularity boundary below the range
+		const uint64_t viewOffset = offset - offset % m_granularity;
+		const size_t viewSize = (size_t)(offset - viewOffset) + size;
+		void* mapped = MapViewOfFile(m_mapping, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)(viewOffset & 0xFFFFFFFFu), viewSize);
+		if (mapped == nullptr)
+			return nullptr;
+
+		*view = mapped;
+		return static_cast<const char*>(mapped) + (offset - viewOffset);
+	}
+
+	void MappedFile::Unmap(void* view)
+	{
+		if (view != nullptr)
+			UnmapViewOfFile(view);
+	}
+
+	void MappedFile::Prefetch(const char* data, size_t size)
+	{
+		volatile char sink = 0;
+		for (size_t offset = 0; offset < size; offset += PAGE_STRIDE)
+			sink += data[offset];
+		if (size > 0)
+			sink += data[size - 1];
+		(void)sink;
+	}
+} // namespace Planeverb
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace Planeverb
+{
+	// Read only file mapping. ranges of the file are mapped on their own, so only the ranges in use take
+	// address space, and the pages of a range leave the working set once it is unmapped
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// false if the file can't be opened or is empty
+		bool Open(const char* filePath);
+		void Close();
+
+		// bytes in the file, 0 if not open
+		uint64_t GetSize() const { return m_size; }
+
+		// maps bytes [offset, offset + size) of the file, nullptr on failure.
+		// view is the handle to pass to Unmap, it may start before offset
+		const char* Map(uint64_t offset, size_t size, void** view) const;
+		static void Unmap(void* view);
+
+		// faults in every page of a mapped range, so the reads happen on the calling thread
+		static void Prefetch(const char* data, size_t size);
+
+	private:
+		void* m_file;				// file handle
+		void* m_mapping;			// file mapping handle
+		uint64_t m_size;			// bytes in the file
+		uint64_t m_granularity;		// alignment of view offsets
+	};
+} // namespace Planeverb
@@ -34,6 +34,12 @@ namespace Planeverb
 		private static extern void PlaneverbDSPSetListenerTransform(float posX, float posY, float posZ,
 		float forwardX, float forwardY, float forwardZ);
 
+		[DllImport(DLLNAME)]
+		private static extern int PlaneverbDSPAddEmitter();
+
+		[DllImport(DLLNAME)]
+		private static extern void PlaneverbDSPRemoveEmitter(int emissionID);
+
 		[DllImport(DLLNAME)]
 		private static extern void PlaneverbDSPUpdateEmitter(int emissionID, float posX, float posY, float posZ,
 			float forwardX, float forwardY, float forwardZ);
@@ -99,6 +105,17 @@ namespace Planeverb
 				forward.x, forward.y, forward.z);
 		}
 
+		// returns a handle for the DSP functions below, -1 if all emitter slots are in use
+		public static int AddEmitter()
+		{
+			return PlaneverbDSPAddEmitter();
+		}
+
+		public static void RemoveEmitter(int id)
+		{
+			PlaneverbDSPRemoveEmitter(id);
+		}
+
 		public static void UpateEmitter(int id, Vector3 pos, Vector3 forward)
 		{
 			PlaneverbDSPUpdateEmitter(id, pos.x, pos.y, pos.z, forward.x, forward.y, forward.z);
@@ -26,10 +26,12 @@ namespace Planeverb
 		// assume each emitter can only emit one sound at a time for simplicity
 		// this isn't meant to be an audio engine demonstration
 		private int id = -1;
+		private int dspID = -1;
 		private PlaneverbOutput output = new PlaneverbOutput();
 		private PlaneverbAudioSource source = null;
 
 		public int GetID() { return id; }
+		public int GetDSPID() { return dspID; }
 		public PlaneverbOutput GetOutput()
 		{
 
@@ -55,7 +57,7 @@ namespace Planeverb
 				if(source)
 				{
 					PlaneverbContext.UpdateEmission(id, transform.position);
-					PlaneverbDSPContext.UpateEmitter(id, transform.position, transform.forward);
+					PlaneverbDSPContext.UpateEmitter(dspID, transform.position, transform.forward);
 					output = PlaneverbContext.GetOutput(id);
 				}
 				// case this emission has ended since the last frame: end emission and reset the id
@@ -89,8 +91,9 @@ namespace Planeverb
 		{
 			// start the emission and create the source
 			id = PlaneverbContext.Emit(transform.position);
-			PlaneverbDSPContext.UpateEmitter(id, transform.position, transform.forward);
-			PlaneverbDSPContext.SetEmitterDirectivityPattern(id, DirectivityPattern);
+			dspID = PlaneverbDSPContext.AddEmitter();
+			PlaneverbDSPContext.UpateEmitter(dspID, transform.position, transform.forward);
+			PlaneverbDSPContext.SetEmitterDirectivityPattern(dspID, DirectivityPattern);
 			output = PlaneverbContext.GetOutput(id);
 			source = PlaneverbAudioManager.pvDSPAudioManager.Play(Clip, id, this, Loop);
 			if(source == null)
@@ -103,8 +106,9 @@ namespace Planeverb
 		{
 			// start the emission and create the source
 			id = PlaneverbContext.Emit(transform.position);
-			PlaneverbDSPContext.UpateEmitter(id, transform.position, transform.forward);
-			PlaneverbDSPContext.SetEmitterDirectivityPattern(id, DirectivityPattern);
+			dspID = PlaneverbDSPContext.AddEmitter();
+			PlaneverbDSPContext.UpateEmitter(dspID, transform.position, transform.forward);
+			PlaneverbDSPContext.SetEmitterDirectivityPattern(dspID, DirectivityPattern);
 			output = PlaneverbContext.GetOutput(id);
 			source = PlaneverbAudioManager.pvDSPAudioManager.Play(clipToPlay, id, this, Loop);
 			if (source == null)
@@ -115,9 +119,11 @@ namespace Planeverb
 
 		public void OnEndEmission()
 		{
-			// end the emission in planeverb, and reset ID
+			// end the emission in planeverb and planeverb DSP, and reset IDs
 			PlaneverbContext.EndEmission(id);
+			PlaneverbDSPContext.RemoveEmitter(dspID);
 			id = -1;
+			dspID = -1;
 		}
 
 		public float GetVolumeGain()